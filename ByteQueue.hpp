@@ -0,0 +1,68 @@
+#pragma once
+
+/*
+ * ByteQueue is a FIFO of bytes used for Connection's send and receive buffers.
+ *
+ * Data is appended at the back and consumed from the front by advancing a read
+ * cursor, so pop_front() does not memmove the rest of the buffer on every
+ * message -- it never calls anything, so it is cheap to inline into a message
+ * parser. Consumed space is reclaimed by append(), which slides the unread
+ * bytes down when it would otherwise have to grow the allocation, provided the
+ * cursor is past the amount of unread data (so each byte moved frees at least
+ * one); that keeps the total copying linear in the bytes that pass through.
+ *
+ * Unread bytes are always contiguous, so data()/size() can be handed straight
+ * to memcpy, send(), or a message parser.
+ */
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+
+struct ByteQueue {
+	//unread bytes, as a contiguous span:
+	uint8_t const *data() const { return storage.data() + head; }
+	uint8_t *data() { return storage.data() + head; }
+	size_t size() const { return storage.size() - head; }
+	bool empty() const { return storage.size() == head; }
+
+	uint8_t const *begin() const { return data(); }
+	uint8_t const *end() const { return storage.data() + storage.size(); }
+
+	//index relative to the read cursor:
+	uint8_t const &operator[](size_t i) const { assert(i < size()); return storage[head + i]; }
+	uint8_t &operator[](size_t i) { assert(i < size()); return storage[head + i]; }
+
+	//add bytes to the back of the queue:
+	void append(void const *bytes, size_t count) {
+		uint8_t const *src = reinterpret_cast< uint8_t const * >(bytes);
+		//reclaim consumed space rather than growing the allocation:
+		if (head != 0 && storage.size() + count > storage.capacity() && head >= size()) compact();
+		storage.insert(storage.end(), src, src + count);
+	}
+
+	//discard bytes from the front of the queue:
+	void pop_front(size_t count) {
+		assert(count <= size());
+		head += count;
+		if (head == storage.size()) clear();
+	}
+
+	void clear() {
+		storage.clear();
+		head = 0;
+	}
+
+private:
+	void compact() {
+		size_t remaining = size();
+		std::memmove(storage.data(), storage.data() + head, remaining);
+		storage.resize(remaining);
+		head = 0;
+	}
+
+	std::vector< uint8_t > storage;
+	size_t head = 0; //read cursor into storage
+};
@@ -0,0 +1,77 @@
+#pragma once
+
+/*
+ * ByteReader reads plain-old-data and strings, in place, from the front of a
+ * span of bytes (e.g., a message payload), throwing if a read would run past
+ * the end -- so recv_*_payload functions check bounds in one spot rather than
+ * at every field, and never need to copy the payload out first.
+ *
+ * Values are copied out with memcpy (payload bytes needn't be aligned), and
+ * strings are assigned in one go, reusing the destination string's storage
+ * when it is big enough.
+ *
+ * Usage:
+ *   ByteReader reader(payload, size, "state message");
+ *   uint32_t seq = reader.read< uint32_t >();
+ *   reader.read(&position);
+ *   reader.read_string(&name, length);
+ *   reader.finish(); //(throws if bytes are left over)
+ */
+
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+struct ByteReader {
+	//'what' names the data in error messages (so must outlive the reader; e.g., a string literal):
+	ByteReader(uint8_t const *data, size_t size, char const *what_ = "message") : bytes(data, size), what(what_) { }
+
+	template< typename T >
+	void read(T *value) {
+		static_assert(std::is_trivially_copyable_v< T >, "ByteReader only reads plain-old-data");
+		std::memcpy(value, take(sizeof(T)).data(), sizeof(T));
+	}
+	template< typename T >
+	T read() {
+		T value;
+		read(&value);
+		return value;
+	}
+
+	//the next 'count' bytes (a view into the data, not a copy):
+	std::span< uint8_t const > take(size_t count) {
+		if (count > remaining()) fail("Ran out of bytes reading ");
+		std::span< uint8_t const > out = bytes.subspan(at, count);
+		at += count;
+		return out;
+	}
+
+	//the next 'length' bytes, as a string:
+	void read_string(std::string *str, size_t length) {
+		std::span< uint8_t const > chars = take(length);
+		str->assign(reinterpret_cast< char const * >(chars.data()), chars.size());
+	}
+
+	size_t remaining() const { return bytes.size() - at; }
+
+	//throw unless everything has been read:
+	void finish() const {
+		if (remaining() != 0) fail("Trailing data in ");
+	}
+
+	std::span< uint8_t const > bytes;
+	size_t at = 0; //bytes read so far
+	char const *what;
+
+private:
+	//(out of line, so reads stay small enough to inline)
+#if defined(__GNUC__)
+	__attribute__((noinline, cold))
+#endif
+	[[noreturn]] void fail(char const *problem) const {
+		throw std::runtime_error(std::string(problem) + what + ".");
+	}
+};
@@ -0,0 +1,117 @@
+#include "Capture.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+CaptureWriter::CaptureWriter(std::string const &path, uint32_t seed) : file(path, std::ios::binary | std::ios::trunc) {
+	if (!file) throw std::runtime_error("Failed to open capture file '" + path + "' for writing.");
+	file.write(Capture::Magic, sizeof(Capture::Magic));
+	uint8_t header[8];
+	for (uint32_t i = 0; i < 4; ++i) {
+		header[i] = uint8_t(Capture::Version >> (8 * i));
+		header[4 + i] = uint8_t(seed >> (8 * i));
+	}
+	file.write(reinterpret_cast< char const * >(header), sizeof(header));
+	bytes = sizeof(Capture::Magic) + sizeof(header);
+}
+
+void CaptureWriter::write(uint64_t tick, Capture::Event event, uint64_t connection, uint8_t const *data, size_t size) {
+	assert(tick >= last_tick);
+	put_varint(tick - last_tick);
+	last_tick = tick;
+	file.put(char(event));
+	bytes += 1;
+	put_varint(connection);
+	if (event == Capture::Event::Message || event == Capture::Event::Datagram) {
+		put_varint(size);
+		file.write(reinterpret_cast< char const * >(data), std::streamsize(size));
+		bytes += size;
+	} else {
+		assert(size == 0);
+	}
+	records += 1;
+}
+
+void CaptureWriter::flush() {
+	file.flush();
+}
+
+void CaptureWriter::put_varint(uint64_t value) {
+	do {
+		uint8_t byte = uint8_t(value & 0x7f);
+		value >>= 7;
+		if (value) byte |= 0x80;
+		file.put(char(byte));
+		bytes += 1;
+	} while (value);
+}
+
+//---------------------------------
+
+CaptureReader::CaptureReader(std::string const &path) : file(path, std::ios::binary) {
+	if (!file) throw std::runtime_error("Failed to open capture file '" + path + "'.");
+	char magic[sizeof(Capture::Magic)];
+	uint8_t header[8];
+	if (!file.read(magic, sizeof(magic)) || std::memcmp(magic, Capture::Magic, sizeof(magic)) != 0
+	 || !file.read(reinterpret_cast< char * >(header), sizeof(header))) {
+		throw std::runtime_error("'" + path + "' is not a capture file.");
+	}
+	uint32_t version = 0;
+	for (uint32_t i = 0; i < 4; ++i) {
+		version |= uint32_t(header[i]) << (8 * i);
+		seed |= uint32_t(header[4 + i]) << (8 * i);
+	}
+	if (version != Capture::Version) {
+		throw std::runtime_error("Capture file '" + path + "' has version " + std::to_string(version) + ", expecting " + std::to_string(Capture::Version) + ".");
+	}
+}
+
+bool CaptureReader::next(Capture::Record *record) {
+	assert(record);
+	uint64_t delta;
+	if (!get_varint(&delta)) {
+		//(the server stopped without writing End; everything before the last record's tick ran)
+		ticks = (last_tick > 0 ? last_tick - 1 : 0);
+		return false;
+	}
+	int event = file.get();
+	uint64_t connection;
+	if (event == std::char_traits< char >::eof() || !get_varint(&connection)) throw std::runtime_error("Capture file ends partway through a record.");
+
+	record->tick = last_tick = last_tick + delta;
+	record->event = Capture::Event(event);
+	record->connection = connection;
+	record->bytes.clear();
+	switch (record->event) {
+		case Capture::Event::Message:
+		case Capture::Event::Datagram: {
+			uint64_t size;
+			if (!get_varint(&size) || size > 4 + 0xffffff) throw std::runtime_error("Capture file has a bad message size.");
+			record->bytes.resize(size_t(size));
+			if (!file.read(reinterpret_cast< char * >(record->bytes.data()), std::streamsize(size))) throw std::runtime_error("Capture file ends partway through a message.");
+			return true;
+		}
+		case Capture::Event::Open:
+		case Capture::Event::Close:
+			return true;
+		case Capture::Event::End:
+			ticks = (record->tick > 0 ? record->tick - 1 : 0);
+			return false;
+	}
+	throw std::runtime_error("Capture file has a record of unknown type " + std::to_string(event) + ".");
+}
+
+bool CaptureReader::get_varint(uint64_t *value) {
+	*value = 0;
+	for (uint32_t shift = 0; shift < 64; shift += 7) {
+		int byte = file.get();
+		if (byte == std::char_traits< char >::eof()) {
+			if (shift == 0) return false; //(clean end of file)
+			throw std::runtime_error("Capture file ends partway through a number.");
+		}
+		*value |= uint64_t(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	throw std::runtime_error("Capture file has an overlong number.");
+}
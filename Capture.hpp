@@ -0,0 +1,90 @@
+#pragma once
+
+/*
+ * A capture is a log of everything that reached a Shard from its clients --
+ * connections opening and closing, messages, and controls that came as
+ * datagrams -- each marked with the tick it arrived before. Since the game only
+ * changes in message handlers and ticks, feeding the log back in the same order,
+ * around the same ticks, reproduces the session exactly (see Shard::record() and
+ * Shard::replay()), without sockets or waiting.
+ *
+ * File layout: a header ("SHARDCAP", version, and the seed of the shard's
+ * random number generator) followed by records:
+ *   [tick delta][event][connection][size][bytes]
+ * where every number is a varint (7 bits per byte, low bits first), 'tick delta'
+ * is the tick minus the previous record's, and only Message and Datagram records
+ * have [size][bytes] (a whole framed message, header included). The last record
+ * is End (unless the server was killed), marked with the tick that would have
+ * run next.
+ *
+ * Usage:
+ *   CaptureWriter writer("session.cap", seed);
+ *   writer.write(tick, Capture::Event::Message, id, message, size);
+ *   writer.flush(); //(e.g., once per tick, so a killed server leaves a usable log)
+ *
+ *   CaptureReader reader("session.cap");
+ *   Capture::Record record;
+ *   while (reader.next(&record)) { ... }
+ */
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+struct Capture {
+	enum class Event : uint8_t {
+		Open = 1, //a client connected
+		Message = 2, //a message arrived on its connection
+		Datagram = 3, //(controls) a message arrived as a datagram
+		Close = 4, //the client disconnected (or was disconnected)
+		End = 5, //recording stopped
+	};
+
+	struct Record {
+		uint64_t tick = 0; //arrived after tick-1 ran, and before tick ran
+		Event event = Event::End;
+		uint64_t connection = 0; //identifies the client (unique among connected clients)
+		std::vector< uint8_t > bytes; //(Message, Datagram) the framed message
+	};
+
+	inline static constexpr char Magic[8] = {'S','H','A','R','D','C','A','P'};
+	inline static constexpr uint32_t Version = 1;
+};
+
+struct CaptureWriter {
+	//create (or replace) a capture file; throws if it can't be opened:
+	CaptureWriter(std::string const &path, uint32_t seed);
+
+	//append a record ('tick' may not go backwards; data/size only for Message and Datagram):
+	void write(uint64_t tick, Capture::Event event, uint64_t connection, uint8_t const *data = nullptr, size_t size = 0);
+	//get buffered records into the file:
+	void flush();
+
+	uint64_t records = 0;
+	uint64_t bytes = 0; //written so far, header included
+
+private:
+	void put_varint(uint64_t value);
+	std::ofstream file;
+	uint64_t last_tick = 0;
+};
+
+struct CaptureReader {
+	//open a capture file and read its header; throws if it isn't one:
+	CaptureReader(std::string const &path);
+
+	//read the next record; returns false at End or the end of the file:
+	// (throws if the file is damaged)
+	bool next(Capture::Record *record);
+
+	uint32_t seed = 0; //the shard's random seed when recording started
+	//once next() has returned false: how many ticks the recording ran for
+	// (from End, or -- if the log stopped short -- the ticks before its last record)
+	uint64_t ticks = 0;
+
+private:
+	bool get_varint(uint64_t *value);
+	std::ifstream file;
+	uint64_t last_tick = 0;
+};
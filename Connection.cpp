@@ -20,16 +20,31 @@ typedef int ssize_t;
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <arpa/inet.h>
 #include <netinet/ip.h>
 #include <unistd.h>
 #include <netdb.h>
+#include <netinet/tcp.h>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#endif
 
 #define closesocket close
 
 #endif
 
+#ifndef MSG_NOSIGNAL
+//(windows has no SIGPIPE; macOS has no MSG_NOSIGNAL, so configure_socket() sets SO_NOSIGPIPE instead)
+#define MSG_NOSIGNAL 0
+#endif
+
 #include "Connection.hpp"
+#include "Log.hpp"
+#include "Profiler.hpp"
 
 //------------------------------------------------------
 
@@ -38,6 +53,8 @@ typedef int ssize_t;
 #include <algorithm>
 #include <cassert>
 #include <cstring>
+#include <limits>
+#include <system_error>
 
 //NOTE: much of the sockets code herein is based on http-tweak's single-header http server
 // see: https://github.com/ixchow/http-tweak
@@ -49,17 +66,209 @@ void Connection::close() {
 	if (socket != InvalidSocket) {
 		::closesocket(socket);
 		socket = InvalidSocket;
+		request_flush(); //so the epoll backend knows to reap this connection
+	}
+	offline = false;
+}
+
+//set up a connected socket:
+// - turn off Nagle's algorithm, so small messages (e.g., a tick's S2C_State or C2S_Controls) go out right away
+// - where send() can't be passed MSG_NOSIGNAL, keep writes to a peer that has gone away from raising SIGPIPE (which would kill the process)
+static void configure_socket(Socket socket) {
+	#ifdef _WIN32
+	BOOL one = TRUE;
+	int ret = setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast< const char * >(&one), sizeof(one));
+	#else
+	int one = 1;
+	int ret = setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	#endif
+	if (ret != 0) {
+		Log::warn("couldn't set TCP_NODELAY (error %d); small messages may be delayed.", errno);
 	}
+	#ifdef SO_NOSIGPIPE
+	if (setsockopt(socket, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one)) != 0) {
+		Log::warn("couldn't set SO_NOSIGPIPE (error %d).", errno);
+	}
+	#endif
 }
 
 //---------------------------------
-//Polling helper used by both server and client:
-void poll_connections(
+//Per-connection transfer helpers used by both polling backends:
+
+//read data waiting on a connection's socket into its recv_buffer:
+// 'hangup' means the peer has shut down its side (epoll's EPOLLRDHUP/EPOLLHUP), so read until recv() reports the close:
+// an edge-triggered backend gets no further event for it.
+static void recv_connection(
+	char const *where,
+	Connection &c,
+	std::function< void(Connection *, Connection::Event event) > const &on_event,
+	bool hangup = false) {
+
+	const uint32_t BufferSize = 20000;
+	static thread_local char *buffer = new char[BufferSize];
+
+	while (true) { //read until more data left to read
+		ssize_t ret = recv(c.socket, buffer, BufferSize, MSG_DONTWAIT);
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			//~no problem~ but no data
+			break;
+		} else if (ret <= 0 || ret > (ssize_t)BufferSize) {
+			//~problem~ so remove connection
+			if (ret == 0) {
+				Log::info("[%s] port closed, disconnecting.", where);
+			} else if (ret < 0) {
+				Log::warn("[%s] recv() returned error %d(%s), disconnecting.", where, errno, strerror(errno));
+			} else {
+				Log::warn("[%s] recv() returned strange number of bytes, disconnecting.", where);
+			}
+			c.close();
+			if (on_event) on_event(&c, Connection::OnClose);
+			break;
+		} else { //ret > 0
+			if (c.send_stats) {
+				c.send_stats->recv_syscalls += 1;
+				c.send_stats->bytes_received += ret;
+			}
+			if (c.netsim) {
+				//(simulated network) data is only received once it comes out of the pipe:
+				c.netsim->incoming.push(NetPipe::clock(), reinterpret_cast< uint8_t const * >(buffer), ret);
+			} else {
+				c.recv_buffer.append(buffer, ret);
+				if (on_event) on_event(&c, Connection::OnRecv);
+				//(the handler may have closed the connection -- e.g., over a malformed message -- so stop reading from it)
+				if (c.socket == InvalidSocket) break;
+			}
+			//NOTE: a short read on a stream socket means it has been drained, which also satisfies edge-triggered epoll
+			// -- unless the peer's FIN came with the data, in which case keep going to see recv() return 0
+			if (ret < BufferSize && !hangup) break; //ran out of data before buffer: no more data left to read
+		}
+	}
+}
+
+//(simulated network) move data that has come through a connection's pipes on to its recv_buffer / socket:
+static void send_connection(char const *where, Connection &c, std::function< void(Connection *, Connection::Event event) > const &on_event);
+static void update_simulated(
+	char const *where,
+	Connection &c,
+	std::function< void(Connection *, Connection::Event event) > const &on_event) {
+
+	assert(c.netsim);
+	static thread_local std::vector< uint8_t > chunk;
+	bool received = false;
+	while (c.netsim->incoming.pop(NetPipe::clock(), &chunk)) {
+		c.recv_buffer.append(chunk.data(), chunk.size());
+		received = true;
+	}
+	if (received && on_event) on_event(&c, Connection::OnRecv);
+	if (c.socket != InvalidSocket && (!c.netsim->outgoing.empty() || !c.netsim->wire.empty())) {
+		send_connection(where, c, on_event);
+	}
+}
+
+//...for every connection; returns the time (in seconds from now) when more simulated data is due:
+static double update_simulated(
+	char const *where,
+	std::list< Connection > &connections,
+	std::function< void(Connection *, Connection::Event event) > const &on_event) {
+
+	double next = std::numeric_limits< double >::infinity();
+	for (auto &c : connections) {
+		if (!c.netsim || c.socket == InvalidSocket) continue;
+		update_simulated(where, c, on_event);
+		next = std::min({next, c.netsim->incoming.next_arrival(), c.netsim->outgoing.next_arrival()});
+	}
+	return next - NetPipe::clock();
+}
+
+//write as much of a connection's send_buffer as its socket will accept:
+static void send_connection(
+	char const *where,
+	Connection &c,
+	std::function< void(Connection *, Connection::Event event) > const &on_event) {
+
+	//(simulated network) queued data goes into the pipe, and what has come out of the pipe goes to the socket:
+	if (c.netsim) {
+		double now = NetPipe::clock();
+		if (!c.send_buffer.empty()) {
+			std::vector< uint8_t > bytes = c.send_buffer.bytes();
+			c.netsim->outgoing.push(now, bytes.data(), bytes.size());
+			c.send_buffer.clear();
+		}
+		static thread_local std::vector< uint8_t > chunk;
+		while (c.netsim->outgoing.pop(now, &chunk)) {
+			c.netsim->wire.append(chunk.data(), chunk.size());
+		}
+	}
+	SendQueue &queue = (c.netsim ? c.netsim->wire : c.send_buffer);
+
+	while (!queue.empty()) {
+		#ifdef _WIN32
+		//(one segment per call)
+		SendQueue::Segment const &front = queue.segments.front();
+		size_t attempted = front.size();
+		ssize_t ret = send(c.socket, reinterpret_cast< char const * >(front.data()), int(attempted), MSG_DONTWAIT | MSG_NOSIGNAL);
+		#else
+		//hand the kernel every segment (up to MaxSpans) in one call:
+		constexpr size_t MaxSpans = 64;
+		struct iovec spans[MaxSpans];
+		size_t count = 0;
+		size_t attempted = 0;
+		for (auto const &segment : queue.segments) {
+			if (count == MaxSpans) break;
+			spans[count].iov_base = const_cast< uint8_t * >(segment.data());
+			spans[count].iov_len = segment.size();
+			attempted += segment.size();
+			++count;
+		}
+		struct msghdr message;
+		memset(&message, 0, sizeof(message));
+		message.msg_iov = spans;
+		message.msg_iovlen = count;
+		ssize_t ret = sendmsg(c.socket, &message, MSG_DONTWAIT | MSG_NOSIGNAL); //(a peer that has gone away is an error return, not SIGPIPE)
+		#endif
+		if (c.send_stats) c.send_stats->syscalls += 1;
+
+		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+			//~no problem~, but don't keep trying
+			c.write_blocked = true;
+			break;
+		} else if (ret <= 0 || ret > (ssize_t)attempted) {
+			if (ret < 0) {
+				Log::warn("[%s] send() returned error %d, disconnecting.", where, errno);
+			} else { assert(ret == 0 || ret > (ssize_t)attempted);
+				Log::warn("[%s] send() returned strange number of bytes [%lld of %zu], disconnecting.", where, (long long)ret, attempted);
+			}
+			c.close();
+			if (on_event) on_event(&c, Connection::OnClose);
+			break;
+		} else { //ret seems reasonable
+			queue.pop_front(ret);
+			if (c.send_stats) c.send_stats->bytes_sent += ret;
+			//a short write means the socket's buffer is full:
+			if (ret < (ssize_t)attempted) {
+				c.write_blocked = true;
+				break;
+			}
+		}
+	}
+}
+
+//---------------------------------
+//select()-based polling helper used by both server and client:
+void poll_connections_select(
 	char const *where,
 	std::list< Connection > &connections,
 	std::function< void(Connection *, Connection::Event event) > const &on_event,
 	double timeout,
-	Socket listen_socket = InvalidSocket) {
+	Socket listen_socket = InvalidSocket,
+	std::function< void(Socket) > const &on_accept = nullptr,
+	SendStats *send_stats = nullptr,
+	NetPath const *netsim = nullptr) {
+
+	//(simulated network) pass along data that is due, and wake up when more will be:
+	if (netsim) {
+		timeout = std::max(0.0, std::min(timeout, update_simulated(where, connections, on_event)));
+	}
 
 	fd_set read_fds, write_fds;
 	FD_ZERO(&read_fds);
@@ -74,11 +283,11 @@ void poll_connections(
 	}
 
 	//add each connection's socket to read (and possibly write) sets:
-	for (auto c : connections) {
+	for (auto const &c : connections) {
 		if (c.socket != InvalidSocket) {
 			max = std::max(max, int(c.socket));
 			FD_SET(c.socket, &read_fds);
-			if (!c.send_buffer.empty()) {
+			if (c.unsent()) {
 				FD_SET(c.socket, &write_fds);
 			}
 		}
@@ -111,80 +320,164 @@ void poll_connections(
 			#else
 			{
 			#endif
-				connections.emplace_back();
-				connections.back().socket = got;
-				std::cerr << "[" << where << "] client connected on " << connections.back().socket << "." << std::endl; //INFO
-				if (on_event) on_event(&connections.back(), Connection::OnOpen);
+				configure_socket(got);
+				if (on_accept) {
+					on_accept(got);
+				} else {
+					connections.emplace_back();
+					connections.back().socket = got;
+					connections.back().send_stats = send_stats;
+					if (netsim) connections.back().netsim = std::make_unique< Connection::Simulated >(*netsim);
+					Log::info("[%s] client connected on %lld.", where, (long long)connections.back().socket); //INFO
+					if (on_event) on_event(&connections.back(), Connection::OnOpen);
+				}
 			}
 		}
 	}
 
-	const uint32_t BufferSize = 20000;
-	static thread_local char *buffer = new char[BufferSize];
-
 	//process requests:
 	for (auto &c : connections) {
 		//only read from valid sockets marked readable:
 		if (c.socket == InvalidSocket || !FD_ISSET(c.socket, &read_fds)) continue;
-
-		while (true) { //read until more data left to read
-			ssize_t ret = recv(c.socket, buffer, BufferSize, MSG_DONTWAIT);
-			if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-				//~no problem~ but no data
-				break;
-			} else if (ret <= 0 || ret > (ssize_t)BufferSize) {
-				//~problem~ so remove connection
-				if (ret == 0) {
-					std::cerr << "[" << where << "] port closed, disconnecting." << std::endl;
-				} else if (ret < 0) {
-					std::cerr << "[" << where << "] recv() returned error " << errno << "(" << strerror(errno) << "), disconnecting." << std::endl;
-				} else {
-					std::cerr << "[" << where << "] recv() returned strange number of bytes, disconnecting." << std::endl;
-				}
-				c.close();
-				if (on_event) on_event(&c, Connection::OnClose);
-				break;
-			} else { //ret > 0
-				c.recv_buffer.insert(c.recv_buffer.end(), buffer, buffer + ret);
-				if (on_event) on_event(&c, Connection::OnRecv);
-				if (ret < BufferSize) break; //ran out of data before buffer: no more data left to read
-			}
-		}
+		recv_connection(where, c, on_event);
 	}
 
 	//process responses:
 	for (auto &c : connections) {
 		//don't bother with connections unless they are valid, have something to send, and are marked writable:
-		if (c.socket == InvalidSocket || c.send_buffer.empty() || !FD_ISSET(c.socket, &write_fds)) continue;
-		
-		#ifdef _WIN32
-		ssize_t ret = send(c.socket, reinterpret_cast< char const * >(c.send_buffer.data()), int(c.send_buffer.size()), MSG_DONTWAIT);
-		#else
-		ssize_t ret = send(c.socket, reinterpret_cast< char const * >(c.send_buffer.data()), c.send_buffer.size(), MSG_DONTWAIT);
-		#endif 
-		if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
-			//~no problem~, but don't keep trying
-			break;
-		} else if (ret <= 0 || ret > (ssize_t)c.send_buffer.size()) {
-			if (ret < 0) {
-				std::cerr << "[" << where << "] send() returned error " << errno << ", disconnecting." << std::endl;
-			} else { assert(ret == 0 || ret > (ssize_t)c.send_buffer.size());
-				std::cerr << "[" << where << "] send() returned strange number of bytes [" << ret << " of " << c.send_buffer.size() << "], disconnecting." << std::endl;
+		if (c.socket == InvalidSocket || !c.unsent() || !FD_ISSET(c.socket, &write_fds)) continue;
+		send_connection(where, c, on_event);
+	}
+}
+
+#ifdef __linux__
+//---------------------------------
+//epoll()-based polling helper used by both server and client:
+
+//register a socket with an epoll instance; 'c' is nullptr for the listen socket:
+static void epoll_add(int epoll_fd, Socket socket, Connection *c) {
+	struct epoll_event ev;
+	ev.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+	if (c) ev.events |= EPOLLOUT;
+	ev.data.ptr = c;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, socket, &ev) != 0) {
+		throw std::system_error(errno, std::system_category(), "failed to add socket to epoll");
+	}
+}
+
+//send data on (and check for closure of) connections that have requested a flush:
+// returns 'true' if any of them have been closed
+static bool flush_connections(
+	char const *where,
+	std::vector< Connection * > &flush_queue,
+	std::function< void(Connection *, Connection::Event event) > const &on_event) {
+
+	bool closed = false;
+	//NOTE: indexing (rather than iterating) because send errors can close (and thus re-queue) connections:
+	for (size_t i = 0; i < flush_queue.size(); ++i) {
+		Connection &c = *flush_queue[i];
+		c.flush_queued = false;
+		//edge-triggered EPOLLOUT only fires when a socket *becomes* writable,
+		// so newly queued data is sent right away unless the socket is known to be full:
+		if (c.socket != InvalidSocket && !c.write_blocked && c.unsent()) {
+			send_connection(where, c, on_event);
+		}
+		if (c.socket == InvalidSocket) closed = true;
+	}
+	flush_queue.clear();
+	return closed;
+}
+
+//returns 'true' if any connections were closed (and so need to be reaped):
+bool poll_connections_epoll(
+	char const *where,
+	std::list< Connection > &connections,
+	std::function< void(Connection *, Connection::Event event) > const &on_event,
+	double timeout,
+	int epoll_fd,
+	std::vector< Connection * > &flush_queue,
+	Socket listen_socket = InvalidSocket,
+	std::function< void(Socket) > const &on_accept = nullptr,
+	int wake_fd = -1,
+	SendStats *send_stats = nullptr,
+	NetPath const *netsim = nullptr) {
+
+	//(simulated network) pass along data that is due, and wake up when more will be:
+	if (netsim) {
+		timeout = std::max(0.0, std::min(timeout, update_simulated(where, connections, on_event)));
+	}
+
+	//send anything queued since the last poll:
+	bool closed = flush_connections(where, flush_queue, on_event);
+
+	constexpr int MaxEvents = 256;
+	static thread_local struct epoll_event events[MaxEvents];
+
+	//wait (until timeout) for sockets' data to become available:
+	// (rounded up so that a sub-millisecond remainder doesn't turn into a busy-wait)
+	int timeout_ms = int(std::ceil(std::max(0.0, timeout) * 1000.0));
+	int count = epoll_wait(epoll_fd, events, MaxEvents, timeout_ms);
+	if (count < 0) {
+		if (errno != EINTR) {
+			std::cerr << "[" << where << "] epoll_wait() returned error " << errno << "(" << strerror(errno) << ")." << std::endl;
+		}
+		return closed;
+	}
+
+	for (int i = 0; i < count; ++i) {
+		Connection *c = reinterpret_cast< Connection * >(events[i].data.ptr);
+
+		if (c == nullptr) {
+			//woken up (by Server::wake()); reset the eventfd's counter:
+			if (wake_fd >= 0) {
+				uint64_t count;
+				while (read(wake_fd, &count, sizeof(count)) > 0) { }
 			}
-			c.close();
-			if (on_event) on_event(&c, Connection::OnClose);
-		} else { //ret seems reasonable
-			c.send_buffer.erase(c.send_buffer.begin(), c.send_buffer.begin() + ret);
+			//listen socket is readable; add new connections until the (non-blocking) accept() runs dry:
+			while (listen_socket != InvalidSocket) {
+				Socket got = accept(listen_socket, NULL, NULL);
+				if (got == InvalidSocket) break;
+				configure_socket(got);
+				if (on_accept) {
+					on_accept(got);
+					continue;
+				}
+				connections.emplace_back();
+				connections.back().socket = got;
+				connections.back().flush_queue = &flush_queue;
+				connections.back().send_stats = send_stats;
+				if (netsim) connections.back().netsim = std::make_unique< Connection::Simulated >(*netsim);
+				epoll_add(epoll_fd, got, &connections.back());
+				Log::info("[%s] client connected on %lld.", where, (long long)connections.back().socket); //INFO
+				if (on_event) on_event(&connections.back(), Connection::OnOpen);
+			}
+			continue;
+		}
+
+		//connection may have been closed by an earlier event handler in this batch:
+		if (c->socket == InvalidSocket) continue;
+
+		if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) {
+			recv_connection(where, *c, on_event, (events[i].events & (EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0);
+		}
+
+		if (c->socket != InvalidSocket && (events[i].events & EPOLLOUT)) {
+			c->write_blocked = false;
+			if (c->unsent()) send_connection(where, *c, on_event);
 		}
 	}
 
-		
+	//send anything queued by event handlers (e.g., replies) without waiting for the next poll:
+	if (flush_connections(where, flush_queue, on_event)) closed = true;
+
+	return closed;
 }
+#endif
 
 //---------------------------------
 
 
-Server::Server(std::string const &port) {
+Server::Server(std::string const &port, PollBackend backend_) : backend(backend_) {
 
 	#ifdef _WIN32
 	{ //init winsock:
@@ -266,16 +559,108 @@ Server::Server(std::string const &port) {
 	}
 
 	{ //listen on socket
-		int ret = ::listen(listen_socket, 5);
+		int ret = ::listen(listen_socket, SOMAXCONN);
 		if (ret < 0) {
 			closesocket(listen_socket);
 			throw std::system_error(errno, std::system_category(), "failed to listen on socket");
 		}
 	}
+
+	if (backend == PollBackend::Epoll) {
+		#ifdef __linux__
+		epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (epoll_fd < 0) {
+			throw std::system_error(errno, std::system_category(), "failed to create epoll instance");
+		}
+		//edge-triggered accept loop needs accept() to report EAGAIN rather than block:
+		fcntl(listen_socket, F_SETFL, fcntl(listen_socket, F_GETFL, 0) | O_NONBLOCK);
+		epoll_add(epoll_fd, listen_socket, nullptr);
+		#else
+		throw std::runtime_error("The epoll poll backend is only available on linux.");
+		#endif
+	}
+}
+
+Server::Server(PollBackend backend_) : backend(backend_) {
+	#ifdef _WIN32
+	{ //init winsock:
+		WSADATA info;
+		if (WSAStartup((2 << 8) | 2, &info) != 0) {
+			throw std::runtime_error("WSAStartup failed.");
+		}
+	}
+	#endif
+
+	if (backend == PollBackend::Epoll) {
+		#ifdef __linux__
+		epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (epoll_fd < 0) {
+			throw std::system_error(errno, std::system_category(), "failed to create epoll instance");
+		}
+		wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (wake_fd < 0) {
+			throw std::system_error(errno, std::system_category(), "failed to create eventfd");
+		}
+		epoll_add(epoll_fd, wake_fd, nullptr);
+		#else
+		throw std::runtime_error("The epoll poll backend is only available on linux.");
+		#endif
+	}
+}
+
+Server::~Server() {
+	#ifdef __linux__
+	if (epoll_fd >= 0) ::close(epoll_fd);
+	if (wake_fd >= 0) ::close(wake_fd);
+	#endif
+}
+
+void Server::simulate(NetPath const &path) {
+	netsim = path;
+	for (auto &c : connections) {
+		c.netsim = (netsim.active() ? std::make_unique< Connection::Simulated >(netsim) : nullptr);
+	}
+}
+
+void Server::wake() {
+	#ifdef __linux__
+	if (wake_fd >= 0) {
+		uint64_t one = 1;
+		[[maybe_unused]] ssize_t ret = write(wake_fd, &one, sizeof(one)); //(can only fail if the counter would overflow, in which case it's readable anyway)
+	}
+	#endif
+}
+
+Connection *Server::adopt(Socket socket, std::function< void(Connection *, Connection::Event event) > const &on_event) {
+	connections.emplace_back();
+	Connection &c = connections.back();
+	c.socket = socket;
+	c.send_stats = &send_stats;
+	configure_socket(socket); //(sockets accepted by poll() already have it, but adopt() may be handed any connected socket)
+	if (netsim.active()) c.netsim = std::make_unique< Connection::Simulated >(netsim);
+	#ifdef __linux__
+	if (backend == PollBackend::Epoll) {
+		c.flush_queue = &flush_queue;
+		epoll_add(epoll_fd, socket, &c); //(reports data that arrived before now, too)
+	}
+	#endif
+	Log::info("[Server::adopt] client connected on %lld.", (long long)c.socket); //INFO
+	if (on_event) on_event(&c, Connection::OnOpen);
+	return &c;
 }
 
 void Server::poll(std::function< void(Connection *, Connection::Event event) > const &on_event, double timeout) {
-	poll_connections("Server::poll", connections, on_event, timeout, listen_socket);
+	#ifdef __linux__
+	if (backend == PollBackend::Epoll) {
+		//the epoll backend tracks closures, so only walk the list when there is something to reap:
+		if (poll_connections_epoll("Server::poll", connections, on_event, timeout, epoll_fd, flush_queue, listen_socket, on_accept, wake_fd, &send_stats, (netsim.active() ? &netsim : nullptr))) {
+			connections.remove_if([](Connection const &c) { return c.socket == InvalidSocket; });
+		}
+		return;
+	}
+	#endif
+
+	poll_connections_select("Server::poll", connections, on_event, timeout, listen_socket, on_accept, &send_stats, (netsim.active() ? &netsim : nullptr));
 
 	//reap closed clients:
 	for (auto connection = connections.begin(); connection != connections.end(); /*later*/) {
@@ -287,7 +672,7 @@ void Server::poll(std::function< void(Connection *, Connection::Event event) > c
 	}
 }
 
-Client::Client(std::string const &host, std::string const &port) : connections(1), connection(connections.front()) {
+Client::Client(std::string const &host, std::string const &port, PollBackend backend_) : connections(1), connection(connections.front()), backend(backend_) {
 	#ifdef _WIN32
 	{ //init winsock:
 		WSADATA info;
@@ -341,8 +726,10 @@ Client::Client(std::string const &host, std::string const &port) : connections(1
 				continue;
 			}
 			std::cout << "success!" << std::endl;
+			configure_socket(s);
 
 			connection.socket = s;
+			connection.send_stats = &send_stats;
 			break;
 		}
 
@@ -352,10 +739,40 @@ Client::Client(std::string const &host, std::string const &port) : connections(1
 			throw std::runtime_error("Failed to connect to any of the addresses tried for server.");
 		}
 	}
+
+	if (backend == PollBackend::Epoll) {
+		#ifdef __linux__
+		epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+		if (epoll_fd < 0) {
+			throw std::system_error(errno, std::system_category(), "failed to create epoll instance");
+		}
+		epoll_add(epoll_fd, connection.socket, &connection);
+		connection.flush_queue = &flush_queue;
+		#else
+		throw std::runtime_error("The epoll poll backend is only available on linux.");
+		#endif
+	}
 }
 
 
+Client::~Client() {
+	#ifdef __linux__
+	if (epoll_fd >= 0) ::close(epoll_fd);
+	#endif
+}
+
 void Client::poll(std::function< void(Connection *, Connection::Event event) > const &on_event, double timeout) {
-	poll_connections("Client::poll", connections, on_event, timeout, InvalidSocket);
+	PROFILE_ZONE("Client::poll");
+	#ifdef __linux__
+	if (backend == PollBackend::Epoll) {
+		poll_connections_epoll("Client::poll", connections, on_event, timeout, epoll_fd, flush_queue, InvalidSocket, nullptr, -1, &send_stats, (netsim.active() ? &netsim : nullptr));
+	} else
+	#endif
+	poll_connections_select("Client::poll", connections, on_event, timeout, InvalidSocket, nullptr, &send_stats, (netsim.active() ? &netsim : nullptr));
+}
+
+void Client::simulate(NetPath const &path) {
+	netsim = path;
+	connection.netsim = (netsim.active() ? std::make_unique< Connection::Simulated >(netsim) : nullptr);
 }
 
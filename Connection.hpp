@@ -14,7 +14,7 @@ int main(int argc, char **argv) {
 		server.poll([](Connection *connection, Connection::Event evt){
 			if (evt == Connection::OnRecv) {
 				//extract and erase data from the connection's recv_buffer:
-				std::vector< uint8_t > data = connection->recv_buffer;
+				std::vector< uint8_t > data(connection->recv_buffer.begin(), connection->recv_buffer.end());
 				connection->recv_buffer.clear();
 				//send to other connections:
 
@@ -60,12 +60,27 @@ int main(int argc, char **argv) {
 #endif
 //--------- ---------------------------------- ---------
 
+#include "ByteQueue.hpp"
+#include "NetSim.hpp"
+#include "SendQueue.hpp"
+
 #include <vector>
 #include <list>
+#include <memory>
 #include <string>
 #include <functional>
 #include <cstdint>
 
+//send-side counters (and a couple of receive-side ones), totalled over a Server's (or Client's) connections:
+struct SendStats {
+	uint64_t syscalls = 0; //send()/sendmsg() calls
+	uint64_t bytes_sent = 0;
+	uint64_t bytes_copied = 0; //bytes queued by copying them into a send buffer (send(), send_raw())
+	uint64_t bytes_shared = 0; //bytes queued by reference (send_shared())
+	uint64_t recv_syscalls = 0; //recv() calls that returned data
+	uint64_t bytes_received = 0;
+};
+
 //Thin wrapper around a (polling-based) TCP socket connection:
 struct Connection {
 	//Helper that will append any type to the send buffer:
@@ -75,22 +90,96 @@ struct Connection {
 	}
 	//Helper that will append raw bytes to the send buffer:
 	void send_raw(void const *data, size_t size) {
-		send_buffer.insert(send_buffer.end(), reinterpret_cast< uint8_t const * >(data), reinterpret_cast< uint8_t const * >(data) + size);
+		request_flush();
+		send_buffer.append(data, size);
+		if (send_stats) send_stats->bytes_copied += size;
+	}
+	//Helper that will queue shared bytes without copying them (e.g., a message going to many connections):
+	// (they are read when the socket is ready, so they must not change -- hence 'const')
+	void send_shared(std::shared_ptr< std::vector< uint8_t > const > const &bytes) {
+		//(referencing a few bytes costs more than copying them)
+		if (bytes->size() < MinSharedSize) {
+			send_raw(bytes->data(), bytes->size());
+			return;
+		}
+		request_flush();
+		send_buffer.append_shared(bytes);
+		if (send_stats) send_stats->bytes_shared += bytes->size();
 	}
+	inline static constexpr size_t MinSharedSize = 64;
 
 	//Call 'close' to mark a connection for discard:
 	void close();
 
 	//so you can if(connection) ... to check for validity:
-	explicit operator bool() { return socket != InvalidSocket; }
+	explicit operator bool() { return socket != InvalidSocket || offline; }
 
-	//To send data over a connection, append it to send_buffer:
-	std::vector< uint8_t > send_buffer;
+	//To send data over a connection, append it to send_buffer (via send(), send_raw(), or send_shared()):
+	SendQueue send_buffer;
 	//When the connection receives data, it is appended to recv_buffer:
-	std::vector< uint8_t > recv_buffer;
+	// (consume handled messages with recv_buffer.pop_front())
+	ByteQueue recv_buffer;
+
+	//Not used by Connection; free for the owner of the Server/Client to attach its own per-connection data:
+	// (e.g., server.cpp keeps a packed SlotHandle here)
+	uint64_t tag = 0;
 
 	//internals:
 	Socket socket = InvalidSocket;
+	bool offline = false; //counts as open without a socket, until close() (e.g., stand-ins for recorded clients in Shard::replay())
+
+	//(epoll backend) connections add themselves to their owner's flush_queue when data is queued or they are closed,
+	// so that poll() doesn't need to visit every connection to find work:
+	std::vector< Connection * > *flush_queue = nullptr;
+	bool flush_queued = false;
+	void request_flush() {
+		if (flush_queue && !flush_queued) {
+			flush_queue->emplace_back(this);
+			flush_queued = true;
+		}
+	}
+	bool write_blocked = false; //(epoll backend) last send() filled the socket buffer; wait for EPOLLOUT before sending more
+
+	SendStats *send_stats = nullptr; //(if set) counters to add this connection's sends to
+
+	//(if set) simulated network conditions between this connection and its socket (see NetSim.hpp):
+	// sent bytes go through 'outgoing' before reaching the socket; received bytes through 'incoming' before reaching recv_buffer.
+	struct Simulated {
+		Simulated(NetPath const &path) : outgoing(path.outgoing, true), incoming(path.incoming, true) { }
+		NetPipe outgoing, incoming;
+		SendQueue wire; //bytes that have come through 'outgoing', waiting for room in the socket
+	};
+	std::unique_ptr< Simulated > netsim;
+
+	//is anything waiting to be written to the socket?
+	bool unsent() const { return !send_buffer.empty() || (netsim && !netsim->wire.empty()); }
+	//how many bytes are waiting to be written to the socket (including, if simulated, those still in the pipe):
+	size_t queued() const { return send_buffer.size() + (netsim ? netsim->outgoing.queued() + netsim->wire.size() : 0); }
+
+	//backpressure: once queued() reaches high_watermark the connection is 'congested', until it drains to low_watermark.
+	// While congested, senders should skip messages that a later message supersedes (e.g., S2C_State) -- never ones that must arrive.
+	// Senders that report those messages with note_supersedable() get watermarks sized to WatermarkMessages of them, so what
+	// a congested connection has queued -- and so how stale the next one is when it arrives -- is bounded in messages, not bytes.
+	// (The kernel's socket buffer isn't counted in queued(), so a real link can add its contents to that.)
+	static constexpr uint32_t WatermarkMessages = 4;
+	size_t low_watermark = 16 * 1024;
+	size_t high_watermark = 64 * 1024;
+	float supersedable_bytes = 0.0f; //running average size of the messages passed to note_supersedable()
+	bool congested = false;
+	//a message that a later one supersedes was queued; resize the watermarks to match:
+	void note_supersedable(size_t bytes) {
+		if (supersedable_bytes == 0.0f) supersedable_bytes = float(bytes);
+		else supersedable_bytes += (float(bytes) - supersedable_bytes) / 8.0f;
+		high_watermark = size_t(WatermarkMessages * supersedable_bytes) + 1;
+		low_watermark = high_watermark / 2;
+	}
+	//update 'congested' from the current queue depth, and return it:
+	bool check_congestion() {
+		size_t bytes = queued();
+		if (bytes >= high_watermark) congested = true;
+		else if (bytes <= low_watermark) congested = false;
+		return congested;
+	}
 
 	enum Event {
 		OnOpen,
@@ -99,8 +188,42 @@ struct Connection {
 	};
 };
 
+//Which OS readiness API poll() uses to wait on sockets:
+enum class PollBackend : uint8_t {
+	Select, //portable; rebuilds fd_sets (limited to FD_SETSIZE sockets) and walks every connection on each poll
+	Epoll, //linux only; edge-triggered, and only connections with pending events are visited
+};
+
+#ifdef __linux__
+constexpr const PollBackend DefaultPollBackend = PollBackend::Epoll;
+#else
+constexpr const PollBackend DefaultPollBackend = PollBackend::Select;
+#endif
+
 struct Server {
-	Server(std::string const &port); //pass the port number to listen on, as a string (servname, really)
+	Server(std::string const &port, PollBackend backend = DefaultPollBackend); //pass the port number to listen on, as a string (servname, really)
+	Server(PollBackend backend = DefaultPollBackend); //no listen socket; connections are added with adopt() (e.g., sockets accepted by another thread)
+	//closes the epoll/wake descriptors (but not sockets; close() connections and the listen socket first):
+	~Server();
+	//connections point back into their server (flush_queue), so it stays put:
+	Server(Server const &) = delete;
+	Server &operator=(Server const &) = delete;
+
+	//take over an already-connected socket (reports OnOpen right away):
+	Connection *adopt(Socket socket, std::function< void(Connection *, Connection::Event event) > const &connection_event = nullptr);
+
+	//if set, sockets accepted by poll() are handed to this instead of becoming connections of this server:
+	// (e.g., so a listener thread can pass them on to worker threads)
+	std::function< void(Socket) > on_accept;
+
+	//run connections' traffic through simulated network conditions (see NetSim.hpp), including connections accepted or adopted later:
+	// (poll() then wakes up whenever simulated traffic is due, and visits every connection to move it along)
+	void simulate(NetPath const &path);
+	NetPath netsim;
+
+	//make a poll() that is waiting (e.g., on another thread) return early; safe to call from any thread:
+	// (needs the epoll backend on a server without a listen socket; otherwise poll() just waits out its timeout)
+	void wake();
 
 	//poll() updates the list of active connections and sends/receives data if possible:
 	// (will wait up to 'timeout' for first event)
@@ -111,11 +234,23 @@ struct Server {
 
 	std::list< Connection > connections;
 	Socket listen_socket = InvalidSocket;
+
+	PollBackend backend;
+	int epoll_fd = -1; //(epoll backend only)
+	int wake_fd = -1; //(epoll backend only) eventfd signalled by wake()
+	std::vector< Connection * > flush_queue; //(epoll backend only)
+
+	SendStats send_stats; //over all connections
 };
 
 
 struct Client {
-	Client(std::string const &host, std::string const &port);
+	Client(std::string const &host, std::string const &port, PollBackend backend = DefaultPollBackend);
+	//closes the epoll descriptor (but not the connection's socket; close() it first):
+	~Client();
+	//the connection points back into its client (flush_queue), so it stays put:
+	Client(Client const &) = delete;
+	Client &operator=(Client const &) = delete;
 
 	//poll() checks the status of the active connection and sends/receives data if possible:
 	// (will wait up to 'timeout' for first event)
@@ -124,6 +259,16 @@ struct Client {
 		double timeout = 0.0 //timeout (seconds)
 	);
 
+	//run the connection's traffic through simulated network conditions (see NetSim.hpp):
+	void simulate(NetPath const &path);
+	NetPath netsim;
+
 	std::list< Connection > connections; //will only ever contain exactly one connection
 	Connection &connection; //reference to the only connection in the connections list
+
+	PollBackend backend;
+	int epoll_fd = -1; //(epoll backend only)
+	std::vector< Connection * > flush_queue; //(epoll backend only)
+
+	SendStats send_stats;
 };
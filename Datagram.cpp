@@ -0,0 +1,283 @@
+//--------- OS-specific socket-related headers ---------
+#ifdef _WIN32
+#define _CRT_SECURE_NO_WARNINGS 1 //so we can use strerror()
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN 1
+#endif
+#undef APIENTRY
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#undef max
+#undef min
+
+#pragma comment(lib, "Ws2_32.lib") //link against the winsock2 library
+
+typedef int ssize_t;
+
+#else
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <cerrno>
+
+#define closesocket close
+
+#endif
+
+#include "Datagram.hpp"
+
+//------------------------------------------------------
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <system_error>
+
+static_assert(sizeof(DatagramAddress::bytes) >= sizeof(sockaddr_in6), "DatagramAddress must fit any address");
+
+static void set_nonblocking(Socket s) {
+	#ifdef _WIN32
+	u_long one = 1;
+	ioctlsocket(s, FIONBIO, &one);
+	#else
+	fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK);
+	#endif
+}
+
+DatagramSocket::DatagramSocket() {
+	#ifdef _WIN32
+	{ //init winsock:
+		WSADATA info;
+		if (WSAStartup((2 << 8) | 2, &info) != 0) {
+			throw std::runtime_error("WSAStartup failed.");
+		}
+	}
+	#endif
+
+	//prefer one dual-stack IPv6 socket (so clients can reach it however they reached the server), else IPv4:
+	socket = ::socket(AF_INET6, SOCK_DGRAM, IPPROTO_UDP);
+	if (socket != InvalidSocket) {
+		int zero = 0;
+		setsockopt(socket, IPPROTO_IPV6, IPV6_V6ONLY, reinterpret_cast< char const * >(&zero), sizeof(zero));
+		sockaddr_in6 any;
+		std::memset(&any, 0, sizeof(any));
+		any.sin6_family = AF_INET6;
+		any.sin6_addr = in6addr_any;
+		if (bind(socket, reinterpret_cast< sockaddr * >(&any), sizeof(any)) != 0) {
+			::closesocket(socket);
+			socket = InvalidSocket;
+		}
+	}
+	if (socket == InvalidSocket) {
+		socket = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (socket == InvalidSocket) {
+			throw std::system_error(errno, std::system_category(), "failed to create datagram socket");
+		}
+		sockaddr_in any;
+		std::memset(&any, 0, sizeof(any));
+		any.sin_family = AF_INET;
+		any.sin_addr.s_addr = htonl(INADDR_ANY);
+		if (bind(socket, reinterpret_cast< sockaddr * >(&any), sizeof(any)) != 0) {
+			::closesocket(socket);
+			socket = InvalidSocket;
+			throw std::system_error(errno, std::system_category(), "failed to bind datagram socket");
+		}
+	}
+	set_nonblocking(socket);
+}
+
+DatagramSocket::DatagramSocket(Connection const &connection, uint16_t port) {
+	assert(connection.socket != InvalidSocket);
+
+	//same host as the connection, different port:
+	sockaddr_storage peer;
+	socklen_t peer_size = sizeof(peer);
+	if (getpeername(connection.socket, reinterpret_cast< sockaddr * >(&peer), &peer_size) != 0) {
+		throw std::system_error(errno, std::system_category(), "failed to get connection's peer address");
+	}
+	if (peer.ss_family == AF_INET6) {
+		reinterpret_cast< sockaddr_in6 * >(&peer)->sin6_port = htons(port);
+	} else if (peer.ss_family == AF_INET) {
+		reinterpret_cast< sockaddr_in * >(&peer)->sin_port = htons(port);
+	} else {
+		throw std::runtime_error("Connection has an unknown address family.");
+	}
+
+	socket = ::socket(peer.ss_family, SOCK_DGRAM, IPPROTO_UDP);
+	if (socket == InvalidSocket) {
+		throw std::system_error(errno, std::system_category(), "failed to create datagram socket");
+	}
+	//'connect' just sets where send()s go (and only lets datagrams from there in):
+	if (connect(socket, reinterpret_cast< sockaddr * >(&peer), peer_size) != 0) {
+		::closesocket(socket);
+		socket = InvalidSocket;
+		throw std::system_error(errno, std::system_category(), "failed to connect datagram socket");
+	}
+	set_nonblocking(socket);
+}
+
+DatagramSocket::~DatagramSocket() {
+	if (socket != InvalidSocket) {
+		::closesocket(socket);
+		socket = InvalidSocket;
+	}
+}
+
+uint16_t DatagramSocket::port() const {
+	sockaddr_storage local;
+	socklen_t local_size = sizeof(local);
+	if (getsockname(socket, reinterpret_cast< sockaddr * >(&local), &local_size) != 0) return 0;
+	if (local.ss_family == AF_INET6) return ntohs(reinterpret_cast< sockaddr_in6 * >(&local)->sin6_port);
+	if (local.ss_family == AF_INET) return ntohs(reinterpret_cast< sockaddr_in * >(&local)->sin_port);
+	return 0;
+}
+
+void DatagramSocket::simulate(NetPath const &path) {
+	outgoing = std::make_unique< NetPipe >(path.outgoing, false);
+	incoming = std::make_unique< NetPipe >(path.incoming, false);
+}
+
+//(simulated datagrams go through the pipes as [address size][address][data]:)
+static void wrap(DatagramAddress const *address, uint8_t const *data, size_t size, std::vector< uint8_t > *out) {
+	uint8_t address_size = uint8_t(address ? address->size : 0);
+	out->clear();
+	out->emplace_back(address_size);
+	if (address) out->insert(out->end(), address->bytes.begin(), address->bytes.begin() + address_size);
+	out->insert(out->end(), data, data + size);
+}
+static uint8_t const *unwrap(std::vector< uint8_t > const &wrapped, DatagramAddress *address, size_t *size) {
+	address->size = wrapped[0];
+	std::copy(wrapped.begin() + 1, wrapped.begin() + 1 + address->size, address->bytes.begin());
+	*size = wrapped.size() - 1 - address->size;
+	return wrapped.data() + 1 + address->size;
+}
+
+void DatagramSocket::send(uint8_t const *data, size_t size, DatagramAddress const *to) {
+	if (!outgoing) {
+		send_now(data, size, to);
+		return;
+	}
+	wrap(to, data, size, &piped);
+	outgoing->push(NetPipe::clock(), piped.data(), piped.size());
+	flush();
+}
+
+void DatagramSocket::send(SendQueue const &queue, DatagramAddress const *to) {
+	//(SendQueue's bytes may be in several segments; a datagram is sent in one piece)
+	scratch.clear();
+	for (auto const &segment : queue.segments) {
+		scratch.insert(scratch.end(), segment.data(), segment.data() + segment.size());
+	}
+	send(scratch.data(), scratch.size(), to);
+}
+
+bool DatagramSocket::recv(std::vector< uint8_t > *data, DatagramAddress *from) {
+	assert(data);
+	if (!incoming) {
+		if (!recv_now(data, from)) return false;
+		stats.received += 1;
+		return true;
+	}
+
+	flush();
+	double now = NetPipe::clock();
+
+	//everything that has arrived at the socket goes into the pipe...
+	DatagramAddress source;
+	while (recv_now(&scratch, &source)) {
+		wrap(&source, scratch.data(), scratch.size(), &piped);
+		incoming->push(now, piped.data(), piped.size());
+	}
+
+	//...and is received once it comes out the other end:
+	if (!incoming->pop(now, &piped)) return false;
+	size_t size;
+	uint8_t const *bytes = unwrap(piped, &source, &size);
+	data->assign(bytes, bytes + size);
+	if (from) *from = source;
+	stats.received += 1;
+	return true;
+}
+
+void DatagramSocket::flush() {
+	if (!outgoing || outgoing->empty()) return;
+	double now = NetPipe::clock();
+	while (outgoing->pop(now, &piped)) {
+		DatagramAddress to;
+		size_t size;
+		uint8_t const *bytes = unwrap(piped, &to, &size);
+		send_now(bytes, size, (to ? &to : nullptr));
+	}
+}
+
+double DatagramSocket::next_arrival() const {
+	if (!outgoing) return std::numeric_limits< double >::infinity();
+	return std::min(outgoing->next_arrival(), incoming->next_arrival());
+}
+
+void DatagramSocket::send_now(uint8_t const *data, size_t size, DatagramAddress const *to) {
+	assert(size <= MaxSize && "datagram too large");
+	ssize_t ret;
+	if (to) {
+		ret = ::sendto(socket, reinterpret_cast< char const * >(data), int(size), 0, reinterpret_cast< sockaddr const * >(to->bytes.data()), socklen_t(to->size));
+	} else {
+		ret = ::send(socket, reinterpret_cast< char const * >(data), int(size), 0);
+	}
+	if (ret < 0) {
+		//(e.g., the socket's buffer is full -- this is a datagram, so it's just lost)
+		stats.errors += 1;
+		return;
+	}
+	stats.sent += 1;
+}
+
+bool DatagramSocket::recv_now(std::vector< uint8_t > *data, DatagramAddress *from) {
+	//room for anything the other end could reasonably send, with enough extra to notice if it sent more:
+	data->resize(MaxSize + 1);
+	while (true) {
+		sockaddr_storage source;
+		socklen_t source_size = sizeof(source);
+		ssize_t ret = ::recvfrom(socket, reinterpret_cast< char * >(data->data()), int(data->size()), 0, reinterpret_cast< sockaddr * >(&source), &source_size);
+		if (ret < 0) {
+			#ifdef _WIN32
+			int err = WSAGetLastError();
+			if (err == WSAEWOULDBLOCK) return false;
+			if (err == WSAECONNRESET || err == WSAEMSGSIZE) { stats.errors += 1; continue; } //(earlier send went nowhere / oversized datagram)
+			#else
+			if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+			if (errno == ECONNREFUSED || errno == EINTR) { stats.errors += 1; continue; } //(earlier send went nowhere)
+			#endif
+			stats.errors += 1;
+			return false;
+		}
+		data->resize(size_t(ret));
+		if (from) {
+			from->size = uint32_t(std::min< size_t >(source_size, from->bytes.size()));
+			std::memcpy(from->bytes.data(), &source, from->size);
+		}
+		return true;
+	}
+}
+
+//---------------------------------
+
+void DatagramChannel::open(Connection const &connection, uint16_t port, uint64_t token_) {
+	socket = std::make_unique< DatagramSocket >(connection, port);
+	if (netsim.active()) socket->simulate(netsim);
+	token = token_;
+	outbox.send_buffer.clear();
+	outbox.send(token);
+}
+
+void DatagramChannel::send_outbox() {
+	assert(socket);
+	socket->send(outbox.send_buffer);
+	outbox.send_buffer.clear();
+	outbox.send(token);
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+/*
+ * DatagramSocket is a thin wrapper around a non-blocking UDP socket. The game
+ * uses one (optionally) as a second channel next to each Connection, for the
+ * messages where only the newest one matters -- C2S_Controls and S2C_State --
+ * so a lost packet costs just that message, rather than holding up everything
+ * behind it on the stream while TCP retransmits. Everything else (login, role
+ * selection, instructions) stays on the reliable, ordered Connection.
+ *
+ * Setting up the channel happens over the Connection: the client sends
+ * C2S_DatagramRequest, and the server answers with S2C_DatagramHello, holding
+ * the port of its datagram socket and a random token.
+ *
+ * Each datagram carries one message, framed just as on a Connection
+ * ([type, 24-bit size, payload]); datagrams from a client start with its 8-byte
+ * token, which is how the server tells whose they are (and learns where to send
+ * that client's state).
+ *
+ * Datagrams may be lost, duplicated, or reordered, so receivers only act on
+ * messages newer (by seq) than the last one they acted on.
+ *
+ * simulate() runs datagrams through simulated network conditions on their way
+ * in and out of the socket (see NetSim.hpp), so the channel can be tried out on
+ * loopback under bad conditions.
+ */
+
+#include "Connection.hpp"
+#include "NetSim.hpp"
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+//where a datagram came from / is going to (a sockaddr_in or sockaddr_in6):
+struct DatagramAddress {
+	std::array< uint8_t, 28 > bytes{};
+	uint32_t size = 0; //(0 => no address)
+
+	bool operator==(DatagramAddress const &other) const {
+		return size == other.size && std::equal(bytes.begin(), bytes.begin() + size, other.bytes.begin());
+	}
+	explicit operator bool() const { return size != 0; }
+};
+
+struct DatagramSocket {
+	//bound to an unused port on all interfaces (e.g., for a server):
+	DatagramSocket();
+	//sending to 'port' on the host at the other end of 'connection' (e.g., for a client):
+	DatagramSocket(Connection const &connection, uint16_t port);
+	~DatagramSocket();
+	DatagramSocket(DatagramSocket const &) = delete;
+	DatagramSocket &operator=(DatagramSocket const &) = delete;
+
+	uint16_t port() const; //(local port)
+
+	//send one datagram, to 'to' or (if not given) to the port given to the constructor:
+	void send(uint8_t const *data, size_t size, DatagramAddress const *to = nullptr);
+	//send all of 'queue's bytes as one datagram:
+	// (e.g., a message written into a Connection's send_buffer with the usual send_*_message functions)
+	void send(SendQueue const &queue, DatagramAddress const *to = nullptr);
+
+	//receive one datagram, if any are waiting; returns false if not:
+	bool recv(std::vector< uint8_t > *data, DatagramAddress *from = nullptr);
+
+	//pass datagrams through simulated network conditions from now on:
+	void simulate(NetPath const &path);
+	//send simulated datagrams that have made it through; also done by send() and recv():
+	void flush();
+	//NetPipe::clock() time when the next simulated datagram comes through (infinity if none):
+	// (recv() only lets those in when called, so callers that wait on the socket should wake up by then, too)
+	double next_arrival() const;
+
+	struct Stats {
+		uint64_t sent = 0, received = 0;
+		uint64_t errors = 0; //failed sends/receives (e.g., nobody listening at the other end)
+	} stats;
+
+	//biggest datagram worth sending (bigger ones may be fragmented, and then lost whenever any fragment is):
+	inline static constexpr size_t MaxSize = 1200;
+
+	Socket socket = InvalidSocket;
+
+	//(if simulate() was called) datagrams on their way, each behind the address it is going to / came from:
+	std::unique_ptr< NetPipe > outgoing, incoming;
+
+private:
+	void send_now(uint8_t const *data, size_t size, DatagramAddress const *to);
+	bool recv_now(std::vector< uint8_t > *data, DatagramAddress *from);
+
+	std::vector< uint8_t > scratch, piped; //(reused for sends and receives)
+};
+
+//the client's end of the channel (the server's end is in Shard):
+struct DatagramChannel {
+	//on S2C_DatagramHello: start sending datagrams to the server at the other end of 'connection':
+	void open(Connection const &connection, uint16_t port, uint64_t token);
+	bool ready() const { return bool(socket); }
+
+	//write one message into 'outbox' (e.g., with send_controls_message()), then send_outbox() sends it:
+	// (open() and send_outbox() leave our token at the start of 'outbox', ready for the next message)
+	Connection outbox;
+	void send_outbox();
+
+	NetPath netsim; //(given to the socket when it is opened, if active)
+	uint64_t token = 0;
+	std::unique_ptr< DatagramSocket > socket; //(once open)
+};
@@ -2,6 +2,7 @@
 #include "PathFont.hpp"
 #include "ColorProgram.hpp"
 
+#include "GpuTimer.hpp"
 #include "gl_errors.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
@@ -134,6 +135,7 @@ void DrawLines::draw_text(std::string const &text, glm::vec3 const &anchor_in, g
 
 DrawLines::~DrawLines() {
 	if (attribs.empty()) return;
+	GPU_SCOPE("DrawLines");
 
 	//based on DrawSprites.cpp :
 
@@ -1,83 +1,168 @@
 #include "Game.hpp"
 
+#include "ByteReader.hpp"
 #include "Connection.hpp"
+#include "Log.hpp"
 
+#include <algorithm>
+#include <cmath>
 #include <stdexcept>
 #include <iostream>
 #include <cstring>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
 #define GLM_ENABLE_EXPERIMENTAL
 #include <glm/gtx/norm.hpp>
 
-void Player::Controls::send_controls_message(Connection *connection_) const
+void Player::Controls::send_controls_message(Connection *connection) const
 {
-	assert(connection_);
-	auto &connection = *connection_;
-
-	uint32_t size = 5;
-	connection.send(Message::C2S_Controls);
-	connection.send(uint8_t(size));
-	connection.send(uint8_t(size >> 8));
-	connection.send(uint8_t(size >> 16));
-
-	auto send_button = [&](Button const &b)
+	auto pack_button = [](Button const &b)
 	{
 		if (b.downs & 0x80)
 		{
 			std::cerr << "Wow, you are really good at pressing buttons!" << std::endl;
 		}
-		connection.send(uint8_t((b.pressed ? 0x80 : 0x00) | (b.downs & 0x7f)));
+		return uint8_t((b.pressed ? 0x80 : 0x00) | (b.downs & 0x7f));
 	};
 
-	send_button(left);
-	send_button(right);
-	send_button(up);
-	send_button(down);
-	send_button(jump);
+	Messages::Controls::send(connection, pack_button(left), pack_button(right), pack_button(up), pack_button(down), pack_button(jump), seq);
 }
 
-bool Player::Controls::recv_controls_message(Connection *connection_)
+bool Player::Controls::recv_controls_message(Connection *connection)
 {
-	assert(connection_);
-	auto &connection = *connection_;
-
-	auto &recv_buffer = connection.recv_buffer;
-
-	// expecting [type, size_low0, size_mid8, size_high8]:
-	if (recv_buffer.size() < 4)
-		return false;
-	if (recv_buffer[0] != uint8_t(Message::C2S_Controls))
+	uint8_t bytes[5];
+	uint32_t new_seq;
+	if (!Messages::Controls::recv(connection, &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &new_seq))
 		return false;
-	uint32_t size = (uint32_t(recv_buffer[3]) << 16) | (uint32_t(recv_buffer[2]) << 8) | uint32_t(recv_buffer[1]);
-	if (size != 5)
-		throw std::runtime_error("Controls message with size " + std::to_string(size) + " != 5!");
+	apply(bytes, new_seq);
+	return true;
+}
 
-	// expecting complete message:
-	if (recv_buffer.size() < 4 + size)
-		return false;
+void Player::Controls::recv_controls_payload(uint8_t const *payload, uint32_t size)
+{
+	uint8_t bytes[5];
+	uint32_t new_seq;
+	Messages::Controls::decode(payload, size, &bytes[0], &bytes[1], &bytes[2], &bytes[3], &bytes[4], &new_seq);
+	apply(bytes, new_seq);
+}
 
+void Player::Controls::apply(uint8_t const (&buttons)[5], uint32_t new_seq)
+{
 	auto recv_button = [](uint8_t byte, Button *button)
 	{
 		button->pressed = (byte & 0x80);
 		uint32_t d = uint32_t(button->downs) + uint32_t(byte & 0x7f);
 		if (d > 255)
 		{
-			std::cerr << "got a whole lot of downs" << std::endl;
+			Log::warn("got a whole lot of downs");
 			d = 255;
 		}
 		button->downs = uint8_t(d);
 	};
 
-	recv_button(recv_buffer[4 + 0], &left);
-	recv_button(recv_buffer[4 + 1], &right);
-	recv_button(recv_buffer[4 + 2], &up);
-	recv_button(recv_buffer[4 + 3], &down);
-	recv_button(recv_buffer[4 + 4], &jump);
+	recv_button(buttons[0], &left);
+	recv_button(buttons[1], &right);
+	recv_button(buttons[2], &up);
+	recv_button(buttons[3], &down);
+	recv_button(buttons[4], &jump);
+	seq = new_seq;
+}
 
-	// delete message from buffer:
-	recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + 4 + size);
+//-----------------------------------------
 
-	return true;
+void Game::Players::clear()
+{
+	handles.clear();
+	position_x.clear();
+	position_y.clear();
+	velocity_x.clear();
+	velocity_y.clear();
+	controls.clear();
+	id.clear();
+	color.clear();
+	name.clear();
+	role.clear();
+}
+
+uint32_t Game::Players::find_id(uint32_t player_id) const
+{
+	return uint32_t(std::find(id.begin(), id.end(), player_id) - id.begin());
+}
+
+Player Game::Players::get(uint32_t index) const
+{
+	assert(index < size());
+	Player player;
+	player.controls = controls[index];
+	player.id = id[index];
+	player.position = position(index);
+	player.velocity = velocity(index);
+	player.color = color[index];
+	player.name = name[index];
+	player.role = role[index];
+	return player;
+}
+
+void Game::Players::set(uint32_t index, Player const &player)
+{
+	assert(index < size());
+	assert(player.id == id[index]);
+	controls[index] = player.controls;
+	set_position(index, player.position);
+	set_velocity(index, player.velocity);
+	color[index] = player.color;
+	name[index] = player.name;
+	role[index] = player.role;
+}
+
+PlayerHandle Game::Players::insert(Player const &player)
+{
+	return append(handles.insert(), player);
+}
+
+PlayerHandle Game::Players::insert_at(uint32_t slot, Player const &player)
+{
+	return append(handles.insert_at(slot), player);
+}
+
+PlayerHandle Game::Players::append(PlayerHandle handle, Player const &player)
+{
+	// (the new slot refers to index size(), so the player goes on the end of each array)
+	position_x.emplace_back(player.position.x);
+	position_y.emplace_back(player.position.y);
+	velocity_x.emplace_back(player.velocity.x);
+	velocity_y.emplace_back(player.velocity.y);
+	controls.emplace_back(player.controls);
+	id.emplace_back(player.id);
+	color.emplace_back(player.color);
+	name.emplace_back(player.name);
+	role.emplace_back(player.role);
+	assert(handles.find(handle) == size() - 1);
+	return handle;
+}
+
+void Game::Players::erase(PlayerHandle handle)
+{
+	uint32_t index = handles.erase(handle);
+	// move the last player into the hole:
+	auto remove = [index](auto &array)
+	{
+		if (index + 1 != array.size())
+			array[index] = std::move(array.back());
+		array.pop_back();
+	};
+	remove(position_x);
+	remove(position_y);
+	remove(velocity_x);
+	remove(velocity_y);
+	remove(controls);
+	remove(id);
+	remove(color);
+	remove(name);
+	remove(role);
 }
 
 //-----------------------------------------
@@ -86,10 +171,9 @@ Game::Game() : mt(0x15466666)
 {
 }
 
-Player *Game::spawn_player()
+PlayerHandle Game::spawn_player()
 {
-	players.emplace_back();
-	Player &player = players.back();
+	Player player;
 
 	// random point in the middle area of the arena:
 	player.position.x = glm::mix(ArenaMin.x + 2.0f * PlayerRadius, ArenaMax.x - 2.0f * PlayerRadius, 0.4f + 0.2f * mt() / float(mt.max()));
@@ -103,192 +187,896 @@ Player *Game::spawn_player()
 	} while (player.color == glm::vec3(0.0f));
 	player.color = glm::normalize(player.color);
 
+	player.id = next_player_number;
 	player.name = "Player " + std::to_string(next_player_number++);
 
-	return &player;
+	PlayerHandle handle = players.insert(player);
+	for (auto &seat : seats)
+	{
+		if (!seat)
+		{
+			seat = handle;
+			break;
+		}
+	}
+	return handle;
+}
+
+void Game::remove_player(PlayerHandle player)
+{
+	assert(players.find(player) < players.size());
+	players.erase(player);
+	for (auto &seat : seats)
+	{
+		if (seat == player)
+			seat = PlayerHandle();
+	}
+}
+
+uint8_t Game::seat_of(PlayerHandle player) const
+{
+	if (!player)
+		return 0;
+	if (seats[0] == player)
+		return 1;
+	if (seats[1] == player)
+		return 2;
+	return 0;
+}
+
+void Game::reset_lobby()
+{
+	phase = Phase::Lobby;
+	role_1 = 0;
+	role_2 = 0;
+	selected_role_1 = 0;
+	selected_role_2 = 1;
+	instruction_text.clear();
+	corrupted_instruction.clear();
+	found_count = 0;
+	attempt_count = 25;
 }
 
-void Game::remove_player(Player *player)
+void Game::update(float elapsed)
 {
-	bool found = false;
-	for (auto pi = players.begin(); pi != players.end(); ++pi)
+	update_motion(elapsed);
+	update_collisions();
+}
+
+namespace {
+	// per-update constants for integrating player motion:
+	struct Motion {
+		float elapsed;
+		float amt; // velocity tween amount toward the control direction
+		float drift_amt; // velocity tween amount toward zero (no controls held)
+	};
+
+	// one player's motion; the SIMD versions below do exactly these operations (in this order) per lane:
+	// (mix(x, y, a) is x * (1 - a) + y * a)
+	inline void integrate(Motion const &m, float dir_x, float dir_y, float &pos_x, float &pos_y, float &vel_x, float &vel_y)
 	{
-		if (&*pi == player)
+		if (dir_x == 0.0f && dir_y == 0.0f)
 		{
-			players.erase(pi);
-			found = true;
-			break;
+			// no inputs: just drift to a stop
+			vel_x = vel_x * (1.0f - m.drift_amt) + 0.0f * m.drift_amt;
+			vel_y = vel_y * (1.0f - m.drift_amt) + 0.0f * m.drift_amt;
+		}
+		else
+		{
+			// inputs: tween velocity to target direction
+
+			// accelerate along velocity (if not fast enough):
+			float along = vel_x * dir_x + vel_y * dir_y;
+			if (along < Game::PlayerSpeed)
+			{
+				along = along * (1.0f - m.amt) + Game::PlayerSpeed * m.amt;
+			}
+
+			// damp perpendicular velocity:
+			float perp = vel_x * -dir_y + vel_y * dir_x;
+			perp = perp * (1.0f - m.amt) + 0.0f * m.amt;
+
+			vel_x = dir_x * along + -dir_y * perp;
+			vel_y = dir_y * along + dir_x * perp;
+		}
+		pos_x = pos_x + vel_x * m.elapsed;
+		pos_y = pos_y + vel_y * m.elapsed;
+	}
+
+	// keep a coordinate within [lo, hi], bouncing velocity:
+	inline void collide_arena(float lo, float hi, float &pos, float &vel)
+	{
+		if (pos < lo)
+		{
+			pos = lo;
+			vel = std::abs(vel);
+		}
+		if (pos > hi)
+		{
+			pos = hi;
+			vel = -std::abs(vel);
+		}
+	}
+
+	void integrate_scalar(Motion const &m, uint32_t begin, uint32_t end, float const *dir_x, float const *dir_y,
+		float *pos_x, float *pos_y, float *vel_x, float *vel_y)
+	{
+		for (uint32_t i = begin; i < end; ++i)
+		{
+			integrate(m, dir_x[i], dir_y[i], pos_x[i], pos_y[i], vel_x[i], vel_y[i]);
+			collide_arena(Game::ArenaMin.x + Game::PlayerRadius, Game::ArenaMax.x - Game::PlayerRadius, pos_x[i], vel_x[i]);
+			collide_arena(Game::ArenaMin.y + Game::PlayerRadius, Game::ArenaMax.y - Game::PlayerRadius, pos_y[i], vel_y[i]);
 		}
 	}
-	assert(found);
+
+#if defined(__AVX__)
+	// AVX: 8 players at a time; returns the number of players handled
+	uint32_t integrate_simd(Motion const &m, uint32_t count, float const *dir_x, float const *dir_y,
+		float *pos_x, float *pos_y, float *vel_x, float *vel_y)
+	{
+		__m256 const zero = _mm256_setzero_ps();
+		__m256 const sign = _mm256_set1_ps(-0.0f);
+		__m256 const elapsed = _mm256_set1_ps(m.elapsed);
+		__m256 const amt = _mm256_set1_ps(m.amt), keep = _mm256_set1_ps(1.0f - m.amt);
+		__m256 const drift_amt = _mm256_set1_ps(m.drift_amt), drift_keep = _mm256_set1_ps(1.0f - m.drift_amt);
+		__m256 const speed = _mm256_set1_ps(Game::PlayerSpeed);
+		__m256 const lo_x = _mm256_set1_ps(Game::ArenaMin.x + Game::PlayerRadius), hi_x = _mm256_set1_ps(Game::ArenaMax.x - Game::PlayerRadius);
+		__m256 const lo_y = _mm256_set1_ps(Game::ArenaMin.y + Game::PlayerRadius), hi_y = _mm256_set1_ps(Game::ArenaMax.y - Game::PlayerRadius);
+
+		auto collide_arena = [&](__m256 lo, __m256 hi, __m256 &pos, __m256 &vel) {
+			__m256 below = _mm256_cmp_ps(pos, lo, _CMP_LT_OQ);
+			pos = _mm256_blendv_ps(pos, lo, below);
+			vel = _mm256_blendv_ps(vel, _mm256_andnot_ps(sign, vel), below);
+			__m256 above = _mm256_cmp_ps(pos, hi, _CMP_GT_OQ);
+			pos = _mm256_blendv_ps(pos, hi, above);
+			vel = _mm256_blendv_ps(vel, _mm256_or_ps(sign, vel), above);
+		};
+
+		uint32_t i = 0;
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 dx = _mm256_loadu_ps(dir_x + i), dy = _mm256_loadu_ps(dir_y + i);
+			__m256 px = _mm256_loadu_ps(pos_x + i), py = _mm256_loadu_ps(pos_y + i);
+			__m256 vx = _mm256_loadu_ps(vel_x + i), vy = _mm256_loadu_ps(vel_y + i);
+
+			// no inputs:
+			__m256 drift_x = _mm256_add_ps(_mm256_mul_ps(vx, drift_keep), _mm256_mul_ps(zero, drift_amt));
+			__m256 drift_y = _mm256_add_ps(_mm256_mul_ps(vy, drift_keep), _mm256_mul_ps(zero, drift_amt));
+
+			// inputs:
+			__m256 ndy = _mm256_xor_ps(dy, sign);
+			__m256 along = _mm256_add_ps(_mm256_mul_ps(vx, dx), _mm256_mul_ps(vy, dy));
+			__m256 slow = _mm256_cmp_ps(along, speed, _CMP_LT_OQ);
+			along = _mm256_blendv_ps(along, _mm256_add_ps(_mm256_mul_ps(along, keep), _mm256_mul_ps(speed, amt)), slow);
+			__m256 perp = _mm256_add_ps(_mm256_mul_ps(vx, ndy), _mm256_mul_ps(vy, dx));
+			perp = _mm256_add_ps(_mm256_mul_ps(perp, keep), _mm256_mul_ps(zero, amt));
+			__m256 move_x = _mm256_add_ps(_mm256_mul_ps(dx, along), _mm256_mul_ps(ndy, perp));
+			__m256 move_y = _mm256_add_ps(_mm256_mul_ps(dy, along), _mm256_mul_ps(dx, perp));
+
+			__m256 idle = _mm256_and_ps(_mm256_cmp_ps(dx, zero, _CMP_EQ_OQ), _mm256_cmp_ps(dy, zero, _CMP_EQ_OQ));
+			vx = _mm256_blendv_ps(move_x, drift_x, idle);
+			vy = _mm256_blendv_ps(move_y, drift_y, idle);
+			px = _mm256_add_ps(px, _mm256_mul_ps(vx, elapsed));
+			py = _mm256_add_ps(py, _mm256_mul_ps(vy, elapsed));
+
+			collide_arena(lo_x, hi_x, px, vx);
+			collide_arena(lo_y, hi_y, py, vy);
+
+			_mm256_storeu_ps(pos_x + i, px);
+			_mm256_storeu_ps(pos_y + i, py);
+			_mm256_storeu_ps(vel_x + i, vx);
+			_mm256_storeu_ps(vel_y + i, vy);
+		}
+		return i;
+	}
+#elif defined(__SSE2__) || defined(_M_X64)
+	// SSE2: 4 players at a time; returns the number of players handled
+	uint32_t integrate_simd(Motion const &m, uint32_t count, float const *dir_x, float const *dir_y,
+		float *pos_x, float *pos_y, float *vel_x, float *vel_y)
+	{
+		__m128 const zero = _mm_setzero_ps();
+		__m128 const sign = _mm_set1_ps(-0.0f);
+		__m128 const elapsed = _mm_set1_ps(m.elapsed);
+		__m128 const amt = _mm_set1_ps(m.amt), keep = _mm_set1_ps(1.0f - m.amt);
+		__m128 const drift_amt = _mm_set1_ps(m.drift_amt), drift_keep = _mm_set1_ps(1.0f - m.drift_amt);
+		__m128 const speed = _mm_set1_ps(Game::PlayerSpeed);
+		__m128 const lo_x = _mm_set1_ps(Game::ArenaMin.x + Game::PlayerRadius), hi_x = _mm_set1_ps(Game::ArenaMax.x - Game::PlayerRadius);
+		__m128 const lo_y = _mm_set1_ps(Game::ArenaMin.y + Game::PlayerRadius), hi_y = _mm_set1_ps(Game::ArenaMax.y - Game::PlayerRadius);
+
+		// (SSE2 has no blendv)
+		auto select = [](__m128 mask, __m128 if_false, __m128 if_true) {
+			return _mm_or_ps(_mm_and_ps(mask, if_true), _mm_andnot_ps(mask, if_false));
+		};
+		auto collide_arena = [&](__m128 lo, __m128 hi, __m128 &pos, __m128 &vel) {
+			__m128 below = _mm_cmplt_ps(pos, lo);
+			pos = select(below, pos, lo);
+			vel = select(below, vel, _mm_andnot_ps(sign, vel));
+			__m128 above = _mm_cmpgt_ps(pos, hi);
+			pos = select(above, pos, hi);
+			vel = select(above, vel, _mm_or_ps(sign, vel));
+		};
+
+		uint32_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 dx = _mm_loadu_ps(dir_x + i), dy = _mm_loadu_ps(dir_y + i);
+			__m128 px = _mm_loadu_ps(pos_x + i), py = _mm_loadu_ps(pos_y + i);
+			__m128 vx = _mm_loadu_ps(vel_x + i), vy = _mm_loadu_ps(vel_y + i);
+
+			// no inputs:
+			__m128 drift_x = _mm_add_ps(_mm_mul_ps(vx, drift_keep), _mm_mul_ps(zero, drift_amt));
+			__m128 drift_y = _mm_add_ps(_mm_mul_ps(vy, drift_keep), _mm_mul_ps(zero, drift_amt));
+
+			// inputs:
+			__m128 ndy = _mm_xor_ps(dy, sign);
+			__m128 along = _mm_add_ps(_mm_mul_ps(vx, dx), _mm_mul_ps(vy, dy));
+			__m128 slow = _mm_cmplt_ps(along, speed);
+			along = select(slow, along, _mm_add_ps(_mm_mul_ps(along, keep), _mm_mul_ps(speed, amt)));
+			__m128 perp = _mm_add_ps(_mm_mul_ps(vx, ndy), _mm_mul_ps(vy, dx));
+			perp = _mm_add_ps(_mm_mul_ps(perp, keep), _mm_mul_ps(zero, amt));
+			__m128 move_x = _mm_add_ps(_mm_mul_ps(dx, along), _mm_mul_ps(ndy, perp));
+			__m128 move_y = _mm_add_ps(_mm_mul_ps(dy, along), _mm_mul_ps(dx, perp));
+
+			__m128 idle = _mm_and_ps(_mm_cmpeq_ps(dx, zero), _mm_cmpeq_ps(dy, zero));
+			vx = select(idle, move_x, drift_x);
+			vy = select(idle, move_y, drift_y);
+			px = _mm_add_ps(px, _mm_mul_ps(vx, elapsed));
+			py = _mm_add_ps(py, _mm_mul_ps(vy, elapsed));
+
+			collide_arena(lo_x, hi_x, px, vx);
+			collide_arena(lo_y, hi_y, py, vy);
+
+			_mm_storeu_ps(pos_x + i, px);
+			_mm_storeu_ps(pos_y + i, py);
+			_mm_storeu_ps(vel_x + i, vx);
+			_mm_storeu_ps(vel_y + i, vy);
+		}
+		return i;
+	}
+#else
+	// no SIMD version for this platform; leave everything to integrate_scalar:
+	uint32_t integrate_simd(Motion const &, uint32_t, float const *, float const *, float *, float *, float *, float *)
+	{
+		return 0;
+	}
+#endif
 }
 
-void Game::update(float elapsed)
+void Game::update_motion(float elapsed)
 {
-	// position/velocity update:
-	for (auto &p : players)
+	uint32_t count = players.size();
+
+	// control direction for each player (and reset 'downs' since controls have been handled):
+	direction_x.resize(count);
+	direction_y.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
 	{
+		Player::Controls &controls = players.controls[i];
 		glm::vec2 dir = glm::vec2(0.0f, 0.0f);
-		if (p.controls.left.pressed)
+		if (controls.left.pressed)
 			dir.x -= 1.0f;
-		if (p.controls.right.pressed)
+		if (controls.right.pressed)
 			dir.x += 1.0f;
-		if (p.controls.down.pressed)
+		if (controls.down.pressed)
 			dir.y -= 1.0f;
-		if (p.controls.up.pressed)
+		if (controls.up.pressed)
 			dir.y += 1.0f;
+		if (dir != glm::vec2(0.0f))
+			dir = glm::normalize(dir);
+		direction_x[i] = dir.x;
+		direction_y[i] = dir.y;
+
+		controls.left.downs = 0;
+		controls.right.downs = 0;
+		controls.up.downs = 0;
+		controls.down.downs = 0;
+		controls.jump.downs = 0;
+	}
+
+	// position/velocity update, then player/arena collisions:
+	Motion motion;
+	motion.elapsed = elapsed;
+	motion.amt = 1.0f - std::pow(0.5f, elapsed / PlayerAccelHalflife);
+	motion.drift_amt = 1.0f - std::pow(0.5f, elapsed / (PlayerAccelHalflife * 2.0f));
 
-		if (dir == glm::vec2(0.0f))
+	uint32_t done = 0;
+	if (integrator == Integrator::Simd)
+	{
+		done = integrate_simd(motion, count, direction_x.data(), direction_y.data(),
+			players.position_x.data(), players.position_y.data(), players.velocity_x.data(), players.velocity_y.data());
+	}
+	integrate_scalar(motion, done, count, direction_x.data(), direction_y.data(),
+		players.position_x.data(), players.position_y.data(), players.velocity_x.data(), players.velocity_y.data());
+}
+
+void Game::update_collisions()
+{
+	// player/player collisions, in player order (each with those before it):
+	auto collide = [this](uint32_t i1, uint32_t i2)
+	{
+		glm::vec2 p12 = players.position(i2) - players.position(i1);
+		float len2 = glm::length2(p12);
+		if (len2 > (2.0f * PlayerRadius) * (2.0f * PlayerRadius))
+			return;
+		if (len2 == 0.0f)
+			return;
+		glm::vec2 dir = p12 / std::sqrt(len2);
+		// mirror velocity to be in separating direction:
+		glm::vec2 v12 = players.velocity(i2) - players.velocity(i1);
+		glm::vec2 delta_v12 = dir * glm::max(0.0f, -1.75f * glm::dot(dir, v12));
+		players.set_velocity(i2, players.velocity(i2) + 0.5f * delta_v12);
+		players.set_velocity(i1, players.velocity(i1) - 0.5f * delta_v12);
+	};
+
+	uint32_t count = players.size();
+	if (broadphase == Broadphase::AllPairs || count < grid_min_players)
+	{
+		for (uint32_t i = 0; i < count; ++i)
 		{
-			// no inputs: just drift to a stop
-			float amt = 1.0f - std::pow(0.5f, elapsed / (PlayerAccelHalflife * 2.0f));
-			p.velocity = glm::mix(p.velocity, glm::vec2(0.0f, 0.0f), amt);
+			for (uint32_t j = 0; j < i; ++j)
+			{
+				collide(i, j);
+			}
 		}
-		else
+		return;
+	}
+
+	// Grid: uniform grid over the arena with cells as wide as the collision distance.
+	// Touching pairs found in nearby cells are handled in player order, so results match AllPairs exactly.
+	// (collisions only change velocities, so positions can be bucketed up front)
+	constexpr float Reach = 2.0f * PlayerRadius; //players farther apart than this don't collide
+	uint32_t cells_x = uint32_t(std::ceil((ArenaMax.x - ArenaMin.x) / Reach));
+	uint32_t cells_y = uint32_t(std::ceil((ArenaMax.y - ArenaMin.y) / Reach));
+	// (clamping before truncating gives the same cell as floor would, without the libm call)
+	auto cell_x = [&](float x)
+	{
+		return uint32_t(std::clamp((x - ArenaMin.x) / Reach, 0.0f, float(cells_x - 1)));
+	};
+	auto cell_y = [&](float y)
+	{
+		return uint32_t(std::clamp((y - ArenaMin.y) / Reach, 0.0f, float(cells_y - 1)));
+	};
+
+	CollisionGrid &grid = collision_grid;
+	grid.cells.resize(count);
+	grid.starts.assign(cells_x * cells_y + 1, 0);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t cell = cell_y(players.position_y[i]) * cells_x + cell_x(players.position_x[i]);
+		grid.cells[i] = cell;
+		grid.starts[cell + 1] += 1;
+	}
+	// counting sort (stable, so each cell lists players in ascending order):
+	for (uint32_t c = 1; c < grid.starts.size(); ++c)
+	{
+		grid.starts[c] += grid.starts[c - 1];
+	}
+	grid.order.resize(count);
+	grid.positions.resize(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint32_t k = grid.starts[grid.cells[i]]++;
+		grid.order[k] = i;
+		grid.positions[k] = players.position(i);
+	}
+	for (uint32_t c = uint32_t(grid.starts.size()) - 1; c > 0; --c)
+	{
+		grid.starts[c] = grid.starts[c - 1];
+	}
+	grid.starts[0] = 0;
+
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		glm::vec2 position = players.position(i);
+
+		// earlier players in nearby cells:
+		// (search a little past Reach so rounding can't lose a pair)
+		constexpr float Search = 1.01f * Reach;
+		uint32_t x0 = cell_x(position.x - Search), x1 = cell_x(position.x + Search);
+		uint32_t y0 = cell_y(position.y - Search), y1 = cell_y(position.y + Search);
+
+		// (positions don't change here, so pairs can be filtered by distance before putting them in order)
+		uint32_t hits = 0;
+		for (uint32_t y = y0; y <= y1; ++y)
 		{
-			// inputs: tween velocity to target direction
-			dir = glm::normalize(dir);
+			// cells x0..x1 of a row are next to each other in 'order':
+			uint32_t begin = grid.starts[y * cells_x + x0];
+			uint32_t end = grid.starts[y * cells_x + x1 + 1];
+			grid.hits.resize(hits + (end - begin));
+			for (uint32_t k = begin; k < end; ++k)
+			{
+				uint32_t j = grid.order[k];
+				float len2 = glm::length2(grid.positions[k] - position);
+				// (branch-free, since whether any one entry is a hit is hard to predict)
+				grid.hits[hits] = j;
+				hits += uint32_t((j < i) & (len2 <= Reach * Reach) & (len2 != 0.0f));
+			}
+		}
+		grid.hits.resize(hits);
+		std::sort(grid.hits.begin(), grid.hits.end());
+		for (uint32_t j : grid.hits)
+		{
+			collide(i, j);
+		}
+	}
+}
 
-			float amt = 1.0f - std::pow(0.5f, elapsed / PlayerAccelHalflife);
+//---- state message encoding ----
+// S2C_State payload:
+//   uint32 seq, uint32 baseline_seq (0 => keyframe: replaces all client state)
+//   uint8 field mask (StateField bits), followed by the flagged fields
+//   uint16 entry count, followed by one entry per player, in ascending slot order (see Game::Players::handles):
+//     uint8 mask (PlayerField bits), [uint32 id if New or Removed], [uint32 slot if New], followed by the flagged fields
+//   Entries without New/Removed update the client's player in the next occupied slot.
+//   (clients put players in the same slots as the server, so both walk their players in the same order)
+// If the field mask has StateQuantized (see Game::quantized_state), player positions/velocities are 2 x uint16 on
+//   PositionGrid/VelocityGrid, their deltas are 2 x int16 steps on those grids, and colors are 3 x uint8.
+
+namespace {
+	enum StateField : uint8_t {
+		StatePhase = 0x01,
+		StateSelfIndex = 0x02,
+		StateRoles = 0x04,
+		StateInstruction = 0x08,
+		StateCounts = 0x10,
+		StateSelfId = 0x20,
+		StateInputAck = 0x40,
+		StateAll = 0x7f,
+		StateQuantized = 0x80, // (not a field) players are encoded on fixed-point grids
+	};
+	enum PlayerField : uint8_t {
+		PlayerNew = 0x01, // player not in baseline; id and slot follow
+		PlayerPositionDelta = 0x02, // 2 x int16, in PositionQuantum steps (quantized: PositionGrid steps)
+		PlayerPosition = 0x04, // vec2 (quantized: 2 x uint16)
+		PlayerVelocityDelta = 0x08, // 2 x int16, in VelocityQuantum steps (quantized: VelocityGrid steps)
+		PlayerVelocity = 0x10, // vec2 (quantized: 2 x uint16)
+		PlayerColor = 0x20, // vec3 (quantized: 3 x uint8)
+		PlayerName = 0x40, // uint8 length + bytes
+		PlayerRemoved = 0x80, // player in baseline no longer exists; id follows
+	};
 
-			// accelerate along velocity (if not fast enough):
-			float along = glm::dot(p.velocity, dir);
-			if (along < PlayerSpeed)
+	// quantize 'to - from' into int16 steps of 'quantum'; returns false if the change doesn't fit:
+	bool quantize_delta(glm::vec2 const &from, glm::vec2 const &to, float quantum, int16_t *out)
+	{
+		float x = std::round((to.x - from.x) / quantum);
+		float y = std::round((to.y - from.y) / quantum);
+		if (!(std::abs(x) <= 32767.0f && std::abs(y) <= 32767.0f))
+			return false;
+		out[0] = int16_t(x);
+		out[1] = int16_t(y);
+		return true;
+	}
+	// NOTE: client and server both apply deltas with this, so that their reconstructions agree exactly:
+	glm::vec2 apply_delta(glm::vec2 const &from, int16_t const *delta, float quantum)
+	{
+		return from + glm::vec2(float(delta[0]), float(delta[1])) * quantum;
+	}
+
+	// 16-bit fixed point over [min, min + 65535 * step], per component, for quantized state messages:
+	// (value() is the same on client and server, and quantize(value(q)) == q, so re-encoding a decoded value is exact)
+	struct FixedGrid
+	{
+		FixedGrid(glm::vec2 const &min_, glm::vec2 const &step_) : min(min_), step(step_), per_step(1.0f / step_.x, 1.0f / step_.y)
+		{
+		}
+		glm::vec2 min, step, per_step;
+		void quantize(glm::vec2 const &v, uint16_t *out) const
+		{
+			// (values on the grid come back within a hair of a whole number, so multiplying rather than dividing is exact for them)
+			for (int c = 0; c < 2; ++c)
+			{
+				float steps = std::clamp((v[c] - min[c]) * per_step[c], 0.0f, 65535.0f);
+				out[c] = uint16_t(steps + 0.5f); // (rounds, since steps >= 0)
+			}
+		}
+		glm::vec2 value(uint16_t const *q) const
+		{
+			return min + glm::vec2(float(q[0]), float(q[1])) * step;
+		}
+		// the grid point 'delta' steps from q; returns false if off the grid:
+		static bool offset(uint16_t const *q, int16_t const *delta, uint16_t *out)
+		{
+			for (int c = 0; c < 2; ++c)
 			{
-				along = glm::mix(along, PlayerSpeed, amt);
+				int32_t moved = int32_t(q[c]) + delta[c];
+				if (moved < 0 || moved > 65535)
+					return false;
+				out[c] = uint16_t(moved);
 			}
+			return true;
+		}
+	};
+	FixedGrid const PositionGrid{Game::ArenaMin, (Game::ArenaMax - Game::ArenaMin) / 65535.0f};
+	FixedGrid const VelocityGrid{glm::vec2(-Game::VelocityLimit), glm::vec2(2.0f * Game::VelocityLimit / 65535.0f)};
 
-			// damp perpendicular velocity:
-			float perp = glm::dot(p.velocity, glm::vec2(-dir.y, dir.x));
-			perp = glm::mix(perp, 0.0f, amt);
+	// the change from grid point 'from' to 'to' in int16 steps; returns false if it doesn't fit:
+	bool grid_delta(uint16_t const *from, uint16_t const *to, int16_t *out)
+	{
+		for (int c = 0; c < 2; ++c)
+		{
+			int32_t d = int32_t(to[c]) - int32_t(from[c]);
+			if (d < -32767 || d > 32767)
+				return false;
+			out[c] = int16_t(d);
+		}
+		return true;
+	}
+
+	std::array< uint8_t, 3 > quantize_color(glm::vec3 const &color)
+	{
+		auto channel = [](float c)
+		{
+			return uint8_t(std::clamp(c * 255.0f, 0.0f, 255.0f) + 0.5f);
+		};
+		return {channel(color.r), channel(color.g), channel(color.b)};
+	}
+	glm::vec3 color_value(std::array< uint8_t, 3 > const &q)
+	{
+		return glm::vec3(float(q[0]) / 255.0f, float(q[1]) / 255.0f, float(q[2]) / 255.0f);
+	}
 
-			p.velocity = dir * along + glm::vec2(-dir.y, dir.x) * perp;
+	// move a player's position, velocity, and color onto the grids (as a client decoding quantized messages would have them):
+	void snap_to_grids(Player *player)
+	{
+		uint16_t q[2];
+		PositionGrid.quantize(player->position, q);
+		player->position = PositionGrid.value(q);
+		VelocityGrid.quantize(player->velocity, q);
+		player->velocity = VelocityGrid.value(q);
+		player->color = color_value(quantize_color(player->color));
+	}
+
+	// append plain-old-data to an encoded message (as Connection::send does):
+	template< typename T >
+	void put(std::vector< uint8_t > &out, T const &t)
+	{
+		uint8_t const *bytes = reinterpret_cast< uint8_t const * >(&t);
+		out.insert(out.end(), bytes, bytes + sizeof(T));
+	}
+
+	// a whole player (name already truncated to 255 bytes; if quantized, already snapped to the grids), as a New entry:
+	void put_new_player(std::vector< uint8_t > &out, uint32_t slot, Player const &player, bool quantized)
+	{
+		put(out, uint8_t(PlayerNew | PlayerPosition | PlayerVelocity | PlayerColor | PlayerName));
+		put(out, player.id);
+		put(out, slot);
+		if (quantized)
+		{
+			uint16_t q[2];
+			PositionGrid.quantize(player.position, q);
+			put(out, q);
+			VelocityGrid.quantize(player.velocity, q);
+			put(out, q);
+			put(out, quantize_color(player.color));
+		}
+		else
+		{
+			put(out, player.position);
+			put(out, player.velocity);
+			put(out, player.color);
 		}
-		p.position += p.velocity * elapsed;
+		put(out, uint8_t(player.name.size()));
+		out.insert(out.end(), player.name.begin(), player.name.end());
+	}
 
-		// reset 'downs' since controls have been handled:
-		p.controls.left.downs = 0;
-		p.controls.right.downs = 0;
-		p.controls.up.downs = 0;
-		p.controls.down.downs = 0;
-		p.controls.jump.downs = 0;
+	// players section of a keyframe that reproduces 'snapshot' exactly:
+	void encode_snapshot(Game::PlayersSnapshot const &snapshot, bool quantized, std::vector< uint8_t > *out_)
+	{
+		auto &out = *out_;
+		out.clear();
+		if (snapshot.players.size() > 0xffff)
+			throw std::runtime_error("Too many players to fit in a state message.");
+		put(out, uint16_t(snapshot.players.size()));
+		for (size_t i = 0; i < snapshot.players.size(); ++i)
+		{
+			put_new_player(out, snapshot.slots[i], snapshot.players[i], quantized);
+		}
 	}
+}
 
-	// collision resolution:
-	for (auto &p1 : players)
+void Game::encode_players(PlayersSnapshot const *before, std::vector< uint8_t > *out_, PlayersSnapshot *after_) const
+{
+	assert(out_);
+	assert(after_);
+	auto &out = *out_;
+	auto &next = *after_;
+	out.clear();
+	next.players.clear();
+	next.slots.clear();
+
+	// entry count will be patched in once known:
+	put(out, uint16_t(0));
+	uint32_t entries = 0;
+
+	auto send_player = [&](uint32_t slot, uint32_t index, Player const *before_player)
 	{
-		// player/player collisions:
-		for (auto &p2 : players)
+		if (!before_player)
 		{
-			if (&p1 == &p2)
-				break;
-			glm::vec2 p12 = p2.position - p1.position;
-			float len2 = glm::length2(p12);
-			if (len2 > (2.0f * PlayerRadius) * (2.0f * PlayerRadius))
-				continue;
-			if (len2 == 0.0f)
-				continue;
-			glm::vec2 dir = p12 / std::sqrt(len2);
-			// mirror velocity to be in separating direction:
-			glm::vec2 v12 = p2.velocity - p1.velocity;
-			glm::vec2 delta_v12 = dir * glm::max(0.0f, -1.75f * glm::dot(dir, v12));
-			p2.velocity += 0.5f * delta_v12;
-			p1.velocity -= 0.5f * delta_v12;
+			Player player = players.get(index);
+			// effectively: truncates player name to 255 chars
+			if (player.name.size() > 255) player.name.resize(255);
+			if (quantized_state) snap_to_grids(&player);
+			put_new_player(out, slot, player, quantized_state);
+			next.players.emplace_back(std::move(player));
+			next.slots.emplace_back(slot);
+			entries += 1;
+			return;
+		}
+
+		uint8_t mask = 0;
+		int16_t position_delta[2], velocity_delta[2];
+		uint16_t position_fixed[2], velocity_fixed[2];
+		std::array< uint8_t, 3 > color_fixed;
+
+		glm::vec2 position = players.position(index);
+		glm::vec2 velocity = players.velocity(index);
+		glm::vec3 const &color = players.color[index];
+		std::string const &name = players.name[index];
+
+		next.players.emplace_back(*before_player);
+		next.slots.emplace_back(slot);
+		Player &after = next.players.back();
+
+		// changes on the fixed-point grids: a delta in grid steps if it fits, else the grid point itself
+		auto grid_change = [](FixedGrid const &grid, glm::vec2 const &before, glm::vec2 const &now,
+			int16_t *delta, uint16_t *fixed, glm::vec2 *after, uint8_t delta_bit, uint8_t fixed_bit) -> uint8_t
+		{
+			uint16_t from[2];
+			grid.quantize(before, from);
+			grid.quantize(now, fixed);
+			if (from[0] == fixed[0] && from[1] == fixed[1]) return 0;
+			*after = grid.value(fixed);
+			return grid_delta(from, fixed, delta) ? delta_bit : fixed_bit;
+		};
+
+		if (quantized_state)
+		{
+			mask |= grid_change(PositionGrid, before_player->position, position, position_delta, position_fixed, &after.position, PlayerPositionDelta, PlayerPosition);
+			mask |= grid_change(VelocityGrid, before_player->velocity, velocity, velocity_delta, velocity_fixed, &after.velocity, PlayerVelocityDelta, PlayerVelocity);
+			color_fixed = quantize_color(color);
+			if (quantize_color(before_player->color) != color_fixed)
+			{
+				mask |= PlayerColor;
+				after.color = color_value(color_fixed);
+			}
+		}
+		else if (before_player->position != position)
+		{
+			if (quantize_delta(before_player->position, position, PositionQuantum, position_delta))
+			{
+				if (position_delta[0] != 0 || position_delta[1] != 0)
+				{
+					mask |= PlayerPositionDelta;
+					after.position = apply_delta(before_player->position, position_delta, PositionQuantum);
+				}
+			}
+			else
+			{
+				mask |= PlayerPosition;
+				after.position = position;
+			}
+		}
+		if (!quantized_state && before_player->velocity != velocity)
+		{
+			if (quantize_delta(before_player->velocity, velocity, VelocityQuantum, velocity_delta))
+			{
+				if (velocity_delta[0] != 0 || velocity_delta[1] != 0)
+				{
+					mask |= PlayerVelocityDelta;
+					after.velocity = apply_delta(before_player->velocity, velocity_delta, VelocityQuantum);
+				}
+			}
+			else
+			{
+				mask |= PlayerVelocity;
+				after.velocity = velocity;
+			}
+		}
+		if (!quantized_state && before_player->color != color)
+		{
+			mask |= PlayerColor;
+			after.color = color;
+		}
+		if (before_player->name != name.substr(0, 255))
+		{
+			mask |= PlayerName;
+			after.name = name.substr(0, 255);
+		}
+
+		put(out, mask);
+		if (mask & PlayerPositionDelta) put(out, position_delta);
+		if (mask & PlayerPosition)
+		{
+			if (quantized_state) put(out, position_fixed);
+			else put(out, position);
 		}
-		// player/arena collisions:
-		if (p1.position.x < ArenaMin.x + PlayerRadius)
+		if (mask & PlayerVelocityDelta) put(out, velocity_delta);
+		if (mask & PlayerVelocity)
 		{
-			p1.position.x = ArenaMin.x + PlayerRadius;
-			p1.velocity.x = std::abs(p1.velocity.x);
+			if (quantized_state) put(out, velocity_fixed);
+			else put(out, velocity);
 		}
-		if (p1.position.x > ArenaMax.x - PlayerRadius)
+		if (mask & PlayerColor)
 		{
-			p1.position.x = ArenaMax.x - PlayerRadius;
-			p1.velocity.x = -std::abs(p1.velocity.x);
+			if (quantized_state) put(out, color_fixed);
+			else put(out, color);
 		}
-		if (p1.position.y < ArenaMin.y + PlayerRadius)
+		if (mask & PlayerName)
 		{
-			p1.position.y = ArenaMin.y + PlayerRadius;
-			p1.velocity.y = std::abs(p1.velocity.y);
+			put(out, uint8_t(after.name.size()));
+			out.insert(out.end(), after.name.begin(), after.name.end());
 		}
-		if (p1.position.y > ArenaMax.y - PlayerRadius)
+		entries += 1;
+	};
+
+	// merge current players with the baseline's (both in slot order):
+	size_t b = 0;
+	auto send_removed = [&]()
+	{
+		// baseline player no longer exists:
+		put(out, uint8_t(PlayerRemoved));
+		put(out, before->players[b].id);
+		entries += 1;
+		++b;
+	};
+	std::vector< SlotIndex::Slot > const &slots = players.handles.slots;
+	for (uint32_t slot = 0; slot < slots.size(); ++slot)
+	{
+		uint32_t index = slots[slot].dense;
+		if (index == SlotIndex::Free)
+			continue;
+		while (before && b < before->players.size() && before->slots[b] < slot)
 		{
-			p1.position.y = ArenaMax.y - PlayerRadius;
-			p1.velocity.y = -std::abs(p1.velocity.y);
+			send_removed();
 		}
+		if (before && b < before->players.size() && before->slots[b] == slot)
+		{
+			if (before->players[b].id == players.id[index])
+			{
+				send_player(slot, index, &before->players[b]);
+				++b;
+				continue;
+			}
+			// (slot was freed and reused since the baseline)
+			send_removed();
+		}
+		send_player(slot, index, nullptr);
 	}
+	while (before && b < before->players.size())
+	{
+		send_removed();
+	}
+
+	if (entries > 0xffff)
+		throw std::runtime_error("Too many players to fit in a state message.");
+	out[0] = uint8_t(entries);
+	out[1] = uint8_t(entries >> 8);
+}
+
+void Game::StateBroadcast::prepare(Game const &game)
+{
+	previous = current;
+	auto next = std::make_shared< PlayersSnapshot >();
+	auto bytes = std::make_shared< std::vector< uint8_t > >();
+	game.encode_players(previous.get(), bytes.get(), next.get());
+	current = next;
+	// (with no previous snapshot, that was a keyframe)
+	delta = (previous ? bytes : nullptr);
+	keyframe = (previous ? nullptr : bytes);
+	encodes += 1;
 }
 
-void Game::send_state_message(Connection *connection_, Player *connection_player) const
+void Game::send_state_message(Connection *connection_, PlayerHandle connection_player, StateBaseline *baseline, StateBroadcast *broadcast) const
 {
 	assert(connection_);
 	auto &connection = *connection_;
 
-	connection.send(Message::S2C_State);
-	// will patch message size in later, for now placeholder bytes:
-	connection.send(uint8_t(0));
-	connection.send(uint8_t(0));
-	connection.send(uint8_t(0));
-	size_t mark = connection.send_buffer.size(); // keep track of this position in the buffer
+	// without a baseline the client has (or one that has never been sent, or one it may not have gotten), send everything:
+	bool keyframe = (baseline == nullptr || baseline->seq == 0 || !baseline->deltas);
+
+	// the players section -- shared with other recipients, or encoded just for this one:
+	static thread_local std::vector< uint8_t > scratch;
+	std::shared_ptr< std::vector< uint8_t > const > players_bytes;
+	std::shared_ptr< PlayersSnapshot const > players_after;
+	if (broadcast)
+	{
+		assert(broadcast->current && "call StateBroadcast::prepare() before sending");
+		if (!keyframe && broadcast->delta && baseline->players == broadcast->previous)
+		{
+			players_bytes = broadcast->delta;
+		}
+		else
+		{
+			// recipients that aren't caught up to the previous snapshot get a keyframe of the current one:
+			keyframe = true;
+			if (!broadcast->keyframe)
+			{
+				auto bytes = std::make_shared< std::vector< uint8_t > >();
+				encode_snapshot(*broadcast->current, quantized_state, bytes.get());
+				broadcast->keyframe = bytes;
+			}
+			players_bytes = broadcast->keyframe;
+		}
+		players_after = broadcast->current;
+		broadcast->sends += 1;
+	}
+	else
+	{
+		auto next = std::make_shared< PlayersSnapshot >();
+		encode_players(keyframe ? nullptr : baseline->players.get(), &scratch, next.get());
+		players_after = next;
+	}
+	std::vector< uint8_t > const &players_section = (players_bytes ? *players_bytes : scratch);
+
+	// (message size is filled in once the payload is written)
+	size_t mark = Schema::begin_message(&connection, Message::S2C_State);
 
-	connection.send(uint8_t(phase));
+	uint32_t seq = (baseline ? baseline->seq + 1 : 1);
+	if (seq == 0) seq = 1; // (0 is reserved for "no baseline")
+	connection.send(seq);
+	connection.send(uint32_t(keyframe ? 0 : baseline->seq));
 
 	// Determine which player this connection is, for self_index
-    uint8_t idx = 0;
-    if (connection_player && players.size() >= 1) {
-        if (connection_player == &players.front()) idx = 1;
-        else if (players.size() >= 2) idx = 2;
-    }
-    connection.send(idx);    
-
-	// send player info helper:
-	auto send_player = [&](Player const &player)
-	{
-		connection.send(player.position);
-		connection.send(player.velocity);
-		connection.send(player.color);
-
-		// NOTE: can't just 'send(name)' because player.name is not plain-old-data type.
-		// effectively: truncates player name to 255 chars
-		uint8_t len = uint8_t(std::min<size_t>(255, player.name.size()));
-		connection.send(len);
-		connection.send_buffer.insert(connection.send_buffer.end(), player.name.begin(), player.name.begin() + len);
-	};
+	uint32_t self = players.find(connection_player);
+	uint8_t idx = seat_of(connection_player);
 
-	// player count:
-	connection.send(uint8_t(players.size()));
-	if (connection_player)
-		send_player(*connection_player);
-	for (auto const &player : players)
-	{
-		if (&player == connection_player)
-			continue;
-		send_player(player);
-	}
+	uint32_t self_id = (self < players.size() ? players.id[self] : 0);
+	uint32_t input_ack = (self < players.size() ? players.controls[self].seq : 0);
+
+	std::array< uint8_t, 4 > roles = {role_1, role_2, selected_role_1, selected_role_2};
 
-	// Phase-specific states
-	if (phase == Phase::Lobby)
+	// game-wide fields:
+	uint8_t fields = StateAll;
+	if (!keyframe)
 	{
-		connection.send(role_1);
-		connection.send(role_2);
-		connection.send(selected_role_1);
-		connection.send(selected_role_2);
+		fields = 0;
+		if (baseline->phase != phase) fields |= StatePhase;
+		if (baseline->self_index != idx) fields |= StateSelfIndex;
+		if (baseline->roles != roles) fields |= StateRoles;
+		if (baseline->corrupted_instruction != corrupted_instruction) fields |= StateInstruction;
+		if (baseline->found_count != found_count || baseline->attempt_count != attempt_count) fields |= StateCounts;
+		if (baseline->self_id != self_id) fields |= StateSelfId;
+		if (baseline->input_ack != input_ack) fields |= StateInputAck;
 	}
-	if (phase == Phase::Operation)
+	if (quantized_state) fields |= StateQuantized;
+	connection.send(fields);
+	if (fields & StatePhase) connection.send(uint8_t(phase));
+	if (fields & StateSelfIndex) connection.send(idx);
+	if (fields & StateRoles) connection.send(roles);
+	if (fields & StateInstruction)
 	{
 		uint16_t N = (uint16_t)std::min<size_t>(65535, corrupted_instruction.size());
 		connection.send(N);
-		connection.send_buffer.insert(connection.send_buffer.end(),
-									  corrupted_instruction.begin(), corrupted_instruction.begin() + N);
+		connection.send_raw(corrupted_instruction.data(), N);
+	}
+	if (fields & StateCounts)
+	{
 		connection.send(found_count);
 		connection.send(attempt_count);
 	}
+	if (fields & StateSelfId) connection.send(self_id);
+	if (fields & StateInputAck) connection.send(input_ack);
+
+	// players (in ascending slot order):
+	if (players_bytes && !broadcast->copy) connection.send_shared(players_bytes); // (referenced, not copied)
+	else connection.send_raw(players_section.data(), players_section.size());
+
+	Schema::end_message(&connection, mark);
 
-	// compute the message size and patch into the message header:
-	uint32_t size = uint32_t(connection.send_buffer.size() - mark);
-	connection.send_buffer[mark - 3] = uint8_t(size);
-	connection.send_buffer[mark - 2] = uint8_t(size >> 8);
-	connection.send_buffer[mark - 1] = uint8_t(size >> 16);
+	// remember what the client now has:
+	if (baseline)
+	{
+		baseline->seq = seq;
+		baseline->players = players_after;
+		baseline->phase = phase;
+		baseline->self_index = idx;
+		baseline->self_id = self_id;
+		baseline->input_ack = input_ack;
+		baseline->roles = roles;
+		baseline->corrupted_instruction = corrupted_instruction.substr(0, 65535);
+		baseline->found_count = found_count;
+		baseline->attempt_count = attempt_count;
+	}
 }
 
 bool Game::recv_state_message(Connection *connection_)
@@ -297,197 +1085,353 @@ bool Game::recv_state_message(Connection *connection_)
 	auto &connection = *connection_;
 	auto &recv_buffer = connection.recv_buffer;
 
-	if (recv_buffer.size() < 4)
+	if (recv_buffer.size() < Schema::HeaderSize)
 		return false;
 	if (recv_buffer[0] != uint8_t(Message::S2C_State))
 		return false;
-	uint32_t size = (uint32_t(recv_buffer[3]) << 16) | (uint32_t(recv_buffer[2]) << 8) | uint32_t(recv_buffer[1]);
-	uint32_t at = 0;
+	uint32_t size = Schema::payload_size(recv_buffer.data());
 	// expecting complete message:
-	if (recv_buffer.size() < 4 + size)
+	if (recv_buffer.size() < Schema::HeaderSize + size)
 		return false;
 
-	// copy bytes from buffer and advance position:
+	recv_state_payload(recv_buffer.data() + Schema::HeaderSize, size);
+
+	// delete message from buffer:
+	recv_buffer.pop_front(Schema::HeaderSize + size);
+
+	return true;
+}
+
+bool Game::recv_state_datagram(uint8_t const *data, size_t size)
+{
+	// one whole message, [type, size_low0, size_mid8, size_high16] + payload:
+	if (size < Schema::HeaderSize || data[0] != uint8_t(Message::S2C_State))
+		throw std::runtime_error("Datagram doesn't hold a state message.");
+	uint32_t payload_size = Schema::payload_size(data);
+	if (Schema::HeaderSize + size_t(payload_size) != size)
+		throw std::runtime_error("State datagram of " + std::to_string(size) + " bytes holds a message of " + std::to_string(Schema::HeaderSize + payload_size) + " bytes.");
+
+	// datagrams may arrive late, twice, or out of order; only apply ones newer than the state we have:
+	uint32_t seq = ByteReader(data + Schema::HeaderSize, payload_size, "state message").read< uint32_t >();
+	if (state_seq != 0 && int32_t(seq - state_seq) <= 0)
+		return false;
+
+	recv_state_payload(data + Schema::HeaderSize, payload_size);
+	return true;
+}
+
+void Game::recv_state_payload(uint8_t const *payload, uint32_t size)
+{
+	// NOTE: decodes straight out of 'payload' into scratch copies of the game's state (kept between messages), which
+	//  replace it only once the whole message has checked out -- so a malformed message changes nothing, and once the
+	//  player list is steady (even when every message is a keyframe, as with datagrams) applying one doesn't allocate.
+	ByteReader reader(payload, size, "state message");
 	auto read = [&](auto *val)
 	{
-		if (at + sizeof(*val) > size)
-		{
-			throw std::runtime_error("Ran out of bytes reading state message.");
-		}
-		std::memcpy(val, &recv_buffer[4 + at], sizeof(*val));
-		at += sizeof(*val);
+		reader.read(val);
 	};
 
-	// Read phase
-	uint8_t ph;
-    read(&ph);
-    phase = Phase(ph);
-
-	read(&self_index);
+	uint32_t seq, baseline_seq;
+	read(&seq);
+	read(&baseline_seq);
 
-	players.clear();
-	uint8_t player_count;
-	read(&player_count);
-	for (uint8_t i = 0; i < player_count; ++i)
+	// keyframe: replaces everything (though players it lists again, in the same slots, are updated in place)
+	bool keyframe = (baseline_seq == 0);
+	if (!keyframe && baseline_seq != state_seq)
 	{
-		players.emplace_back();
-		Player &player = players.back();
-		read(&player.position);
-		read(&player.velocity);
-		read(&player.color);
-		uint8_t name_len;
-		read(&name_len);
-		// n.b. would probably be more efficient to directly copy from recv_buffer, but I think this is clearer:
-		player.name = "";
-		for (uint8_t n = 0; n < name_len; ++n)
-		{
-			char c;
-			read(&c);
-			player.name += c;
-		}
+		// changes against a state we don't have; ask for a keyframe (once) and ignore deltas until it arrives:
+		if (state_seq != 0)
+			needs_keyframe = true;
+		state_seq = 0;
+		return;
 	}
 
-	// Phase-specific states
-	if (phase == Phase::Lobby) {
-        read(&role_1);
-        read(&role_2);
-        read(&selected_role_1);
-        read(&selected_role_2);
-    }
-	if (phase == Phase::Operation)
+	uint8_t fields;
+	read(&fields);
+	bool quantized = (fields & StateQuantized);
+	uint8_t new_phase = uint8_t(phase), new_self_index = self_index;
+	std::array< uint8_t, 4 > new_roles = {role_1, role_2, selected_role_1, selected_role_2};
+	uint8_t new_found_count = found_count, new_attempt_count = attempt_count;
+	uint32_t new_self_id = self_id, new_input_ack = input_ack;
+	if (fields & StatePhase)
+		read(&new_phase);
+	if (fields & StateSelfIndex)
+		read(&new_self_index);
+	if (fields & StateRoles)
+		read(&new_roles);
+	if (fields & StateInstruction)
 	{
 		uint16_t N;
 		read(&N);
-		corrupted_instruction.resize(N);
-		if (N)
-			std::memcpy(&corrupted_instruction[0], &recv_buffer[4 + at], N);
-		at += N;
-		read(&found_count);
-		read(&attempt_count);
+		reader.read_string(&state_instruction, N);
 	}
+	if (fields & StateCounts)
+	{
+		read(&new_found_count);
+		read(&new_attempt_count);
+	}
+	if (fields & StateSelfId)
+		read(&new_self_id);
+	if (fields & StateInputAck)
+		read(&new_input_ack);
+
+	// entries apply to a copy of the players:
+	Players &decoded = state_players;
+	decoded = players;
+
+	// walk the players in slot order alongside the entries:
+	std::vector< SlotIndex::Slot > const &slots = decoded.handles.slots;
+	uint32_t cursor = 0; // slots before this have been handled
+	auto next_occupied = [&]()
+	{
+		while (cursor < slots.size() && slots[cursor].dense == SlotIndex::Free)
+			++cursor;
+		return cursor;
+	};
 
-	if (at != size)
-		throw std::runtime_error("Trailing data in state message.");
+	uint16_t entries;
+	read(&entries);
+	for (uint16_t e = 0; e < entries; ++e)
+	{
+		uint8_t mask;
+		read(&mask);
 
-	// delete message from buffer:
-	recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + 4 + size);
+		if (mask & PlayerRemoved)
+		{
+			uint32_t id;
+			read(&id);
+			uint32_t slot = next_occupied();
+			if (slot == slots.size() || decoded.id[slots[slot].dense] != id)
+				throw std::runtime_error("State message removes unknown player.");
+			decoded.erase(decoded.handle(slots[slot].dense));
+			continue;
+		}
 
-	return true;
+		uint32_t index;
+		if (mask & PlayerNew)
+		{
+			uint32_t id, slot;
+			read(&id);
+			read(&slot);
+			if (slot < cursor || slot >= MaxPlayerSlots)
+				throw std::runtime_error("State message adds player out of order.");
+			if (keyframe)
+			{
+				// players the keyframe skips over are gone:
+				for (uint32_t occupied = next_occupied(); occupied < slots.size() && occupied < slot; occupied = next_occupied())
+					decoded.erase(decoded.handle(slots[occupied].dense));
+			}
+			// (must be a free slot that doesn't skip over any of the client's players)
+			uint32_t occupied = next_occupied();
+			bool taken = (occupied < slots.size() && occupied == slot);
+			if (keyframe && taken && decoded.id[slots[slot].dense] == id)
+			{
+				// (same player as before; every field follows, so just overwrite them)
+				index = slots[slot].dense;
+			}
+			else
+			{
+				if (keyframe && taken)
+					decoded.erase(decoded.handle(slots[slot].dense));
+				else if (occupied < slots.size() && occupied <= slot)
+					throw std::runtime_error("State message adds player out of order.");
+				Player player;
+				player.id = id;
+				decoded.insert_at(slot, player);
+				index = decoded.size() - 1;
+			}
+			cursor = slot + 1;
+		}
+		else
+		{
+			uint32_t slot = next_occupied();
+			if (slot == slots.size())
+				throw std::runtime_error("State message updates unknown player.");
+			index = slots[slot].dense;
+			cursor = slot + 1;
+		}
+
+		// (quantized: values are read as grid points, and deltas step from the grid point the player is on)
+		auto read_grid_delta = [&](FixedGrid const &grid, glm::vec2 const &from)
+		{
+			int16_t delta[2];
+			read(&delta);
+			uint16_t q[2];
+			grid.quantize(from, q);
+			if (!FixedGrid::offset(q, delta, q))
+				throw std::runtime_error("State message moves player off the grid.");
+			return grid.value(q);
+		};
+		auto read_grid_point = [&](FixedGrid const &grid)
+		{
+			uint16_t q[2];
+			read(&q);
+			return grid.value(q);
+		};
+
+		if (mask & PlayerPositionDelta)
+		{
+			if (quantized)
+				decoded.set_position(index, read_grid_delta(PositionGrid, decoded.position(index)));
+			else
+			{
+				int16_t delta[2];
+				read(&delta);
+				decoded.set_position(index, apply_delta(decoded.position(index), delta, PositionQuantum));
+			}
+		}
+		if (mask & PlayerPosition)
+		{
+			if (quantized)
+				decoded.set_position(index, read_grid_point(PositionGrid));
+			else
+			{
+				glm::vec2 position;
+				read(&position);
+				decoded.set_position(index, position);
+			}
+		}
+		if (mask & PlayerVelocityDelta)
+		{
+			if (quantized)
+				decoded.set_velocity(index, read_grid_delta(VelocityGrid, decoded.velocity(index)));
+			else
+			{
+				int16_t delta[2];
+				read(&delta);
+				decoded.set_velocity(index, apply_delta(decoded.velocity(index), delta, VelocityQuantum));
+			}
+		}
+		if (mask & PlayerVelocity)
+		{
+			if (quantized)
+				decoded.set_velocity(index, read_grid_point(VelocityGrid));
+			else
+			{
+				glm::vec2 velocity;
+				read(&velocity);
+				decoded.set_velocity(index, velocity);
+			}
+		}
+		if (mask & PlayerColor)
+		{
+			if (quantized)
+			{
+				std::array< uint8_t, 3 > q;
+				read(&q);
+				decoded.color[index] = color_value(q);
+			}
+			else
+				read(&decoded.color[index]);
+		}
+		if (mask & PlayerName)
+		{
+			uint8_t name_len;
+			read(&name_len);
+			reader.read_string(&decoded.name[index], name_len);
+		}
+	}
+	if (keyframe)
+	{
+		// (and so are any after the last one it lists)
+		for (uint32_t occupied = next_occupied(); occupied < slots.size(); occupied = next_occupied())
+			decoded.erase(decoded.handle(slots[occupied].dense));
+	}
+	if (next_occupied() != slots.size())
+		throw std::runtime_error("State message is missing decoded.");
+
+	reader.finish();
+
+	// the message checks out; apply it:
+	std::swap(players, state_players);
+	phase = Phase(new_phase);
+	self_index = new_self_index;
+	role_1 = new_roles[0];
+	role_2 = new_roles[1];
+	selected_role_1 = new_roles[2];
+	selected_role_2 = new_roles[3];
+	if (fields & StateInstruction)
+		corrupted_instruction = state_instruction;
+	found_count = new_found_count;
+	attempt_count = new_attempt_count;
+	self_id = new_self_id;
+	input_ack = new_input_ack;
+	state_seq = seq;
 }
 
-// Credit: the new functions below were helped by ChatGPT
-void Game::send_selected_role_message(Connection *connection_, uint8_t selected_0_or_1)
+void Game::send_keyframe_request_message(Connection *connection)
 {
-	assert(connection_);
-	auto &connection = *connection_;
-	connection.send(uint8_t(Message::C2S_SelectedRole));
-	connection.send(uint8_t(1)); // payload size = 1
-	connection.send(uint8_t(0));
-	connection.send(uint8_t(0));
-	connection.send(uint8_t(selected_0_or_1 ? 1 : 0));
+	Messages::KeyframeRequest::send(connection);
 }
 
-bool Game::recv_selected_role_message(Connection *connection_, uint8_t *out_selected)
+void Game::send_datagram_request_message(Connection *connection)
 {
-	assert(connection_);
-	auto &connection = *connection_;
-	auto &rb = connection.recv_buffer;
-
-	if (rb.size() < 4)
-		return false;
-	if (rb[0] != uint8_t(Message::C2S_SelectedRole))
-		return false;
-
-	uint32_t size = (uint32_t(rb[3]) << 16) | (uint32_t(rb[2]) << 8) | uint32_t(rb[1]);
-	if (size != 1)
-		throw std::runtime_error("SelectedRole message must have size 1");
-	if (rb.size() < 4 + size)
-		return false;
-
-	if (out_selected)
-		*out_selected = rb[4] ? 1 : 0;
-
-	rb.erase(rb.begin(), rb.begin() + 4 + size);
-	return true;
+	Messages::DatagramRequest::send(connection);
 }
 
-void Game::send_login_message(Connection *connection_, Role role)
+void Game::send_datagram_hello_message(Connection *connection, uint16_t port, uint64_t token)
 {
-	assert(connection_);
-	auto &connection = *connection_;
+	Messages::DatagramHello::send(connection, port, token);
+}
 
-	// [type, size_low0, size_mid8, size_high16]
-	connection.send(uint8_t(Message::C2S_Login));
-	connection.send(uint8_t(1)); // payload size = 1 byte
-	connection.send(uint8_t(0));
-	connection.send(uint8_t(0));
+bool Game::recv_datagram_hello_message(Connection *connection, uint16_t *out_port, uint64_t *out_token)
+{
+	return Messages::DatagramHello::recv(connection, out_port, out_token);
+}
 
-	connection.send(uint8_t(role));
+void Game::recv_datagram_hello_payload(uint8_t const *payload, uint32_t size, uint16_t *out_port, uint64_t *out_token)
+{
+	Messages::DatagramHello::decode(payload, size, out_port, out_token);
 }
 
-bool Game::recv_login_message(Connection *connection_, Role *out_role)
+// Credit: the new functions below were helped by ChatGPT
+void Game::send_selected_role_message(Connection *connection, uint8_t selected_0_or_1)
 {
-	assert(connection_);
-	auto &connection = *connection_;
-	auto &recv_buffer = connection.recv_buffer;
+	Messages::SelectedRole::send(connection, uint8_t(selected_0_or_1 ? 1 : 0));
+}
 
-	// need at least header:
-	if (recv_buffer.size() < 4)
-		return false;
-	if (recv_buffer[0] != uint8_t(Message::C2S_Login))
+bool Game::recv_selected_role_message(Connection *connection, uint8_t *out_selected)
+{
+	uint8_t selected;
+	if (!Messages::SelectedRole::recv(connection, &selected))
 		return false;
-
-	uint32_t size = (uint32_t(recv_buffer[3]) << 16) | (uint32_t(recv_buffer[2]) << 8) | uint32_t(recv_buffer[1]);
-	if (size != 1)
-	{
-		throw std::runtime_error("Login message size must be 1, got " + std::to_string(size));
-	}
-	if (recv_buffer.size() < 4 + size)
-		return false; // wait for full message
-
-	uint8_t selected_role_index = recv_buffer[4];
-	if (out_role)
-		*out_role = Role(selected_role_index);
-
-	// pop message
-	recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + 4 + size);
+	if (out_selected)
+		*out_selected = selected ? 1 : 0;
 	return true;
 }
 
-void Game::send_instruction_message(Connection *connection_, std::string const& utf8) {
-    assert(connection_);
-    auto &connection = *connection_;
-
-    // payload = uint16 N + N bytes:
-    uint16_t N = (uint16_t)std::min<size_t>(utf8.size(), 65535);
-
-    connection.send(uint8_t(Message::C2S_Instruction));
-    uint32_t payload = 2u + uint32_t(N);
-    connection.send(uint8_t(payload));
-    connection.send(uint8_t(payload >> 8));
-    connection.send(uint8_t(payload >> 16));
+void Game::recv_selected_role_payload(uint8_t const *payload, uint32_t size, uint8_t *out_selected)
+{
+	uint8_t selected;
+	Messages::SelectedRole::decode(payload, size, &selected);
+	if (out_selected)
+		*out_selected = selected ? 1 : 0;
+}
 
-    connection.send(N);
-    connection.send_buffer.insert(connection.send_buffer.end(), utf8.begin(), utf8.begin() + N);
+void Game::send_login_message(Connection *connection, Role role)
+{
+	Messages::Login::send(connection, role);
 }
 
-bool Game::recv_instruction_message(Connection *connection_, std::string* out_utf8) {
-    assert(connection_);
-    auto &connection = *connection_;
-    auto &recv_buffer = connection.recv_buffer;
+bool Game::recv_login_message(Connection *connection, Role *out_role)
+{
+	return Messages::Login::recv(connection, out_role);
+}
 
-    if (recv_buffer.size() < 4) return false;
-    if (recv_buffer[0] != uint8_t(Message::C2S_Instruction)) return false;
+void Game::recv_login_payload(uint8_t const *payload, uint32_t size, Role *out_role)
+{
+	Messages::Login::decode(payload, size, out_role);
+}
 
-    uint32_t size = (uint32_t(recv_buffer[3]) << 16) | (uint32_t(recv_buffer[2]) << 8) | uint32_t(recv_buffer[1]);
-    if (recv_buffer.size() < 4 + size) return false;
+void Game::send_instruction_message(Connection *connection, std::string const& utf8) {
+	// (truncated to 65535 bytes)
+	Messages::Instruction::send(connection, utf8);
+}
 
-    if (size < 2) throw std::runtime_error("Instruction payload too small");
-    uint16_t N;
-    std::memcpy(&N, &recv_buffer[4], 2);
-    if (2u + N != size) throw std::runtime_error("Instruction payload size mismatch");
-    if (out_utf8) out_utf8->assign((char const*)&recv_buffer[6], (char const*)&recv_buffer[6] + N);
+bool Game::recv_instruction_message(Connection *connection, std::string* out_utf8) {
+	return Messages::Instruction::recv(connection, out_utf8);
+}
 
-    recv_buffer.erase(recv_buffer.begin(), recv_buffer.begin() + 4 + size);
-    return true;
+void Game::recv_instruction_payload(uint8_t const *payload, uint32_t size, std::string *out_utf8) {
+	Messages::Instruction::decode(payload, size, out_utf8);
 }
@@ -1,10 +1,15 @@
 #pragma once
 
+#include "MessageSchema.hpp"
+#include "SlotMap.hpp"
+
 #include <glm/glm.hpp>
 
+#include <array>
+#include <memory>
 #include <string>
-#include <list>
 #include <random>
+#include <vector>
 
 struct Connection;
 
@@ -18,7 +23,10 @@ enum class Message : uint8_t {
 	//...
 	C2S_Login = 'L',
 	C2S_Instruction = 'I',
-	C2S_SelectedRole = 'R'
+	C2S_SelectedRole = 'R',
+	C2S_KeyframeRequest = 'K', //client lost track of state deltas; next S2C_State should be a keyframe
+	C2S_DatagramRequest = 'D', //client would like controls/state to travel as datagrams (see Datagram.hpp)
+	S2C_DatagramHello = 'd', //where to send those datagrams: server's datagram port + client's token
 };
 
 //used to represent a control input:
@@ -29,11 +37,27 @@ struct Button {
 
 enum class Role : uint8_t { Unknown = 0, Communicator = 1, Operative = 2 };
 
+//payloads of the messages with a fixed layout (see MessageSchema.hpp; S2C_State is written by hand, in Game.cpp):
+namespace Messages {
+	//left, right, up, down, jump (each [pressed << 7 | downs]), seq:
+	using Controls = MessageSchema< Message::C2S_Controls, uint8_t, uint8_t, uint8_t, uint8_t, uint8_t, uint32_t >;
+	using KeyframeRequest = MessageSchema< Message::C2S_KeyframeRequest >;
+	using DatagramRequest = MessageSchema< Message::C2S_DatagramRequest >;
+	//server's datagram port, client's token:
+	using DatagramHello = MessageSchema< Message::S2C_DatagramHello, uint16_t, uint64_t >;
+	//0 = Communicator, 1 = Operative:
+	using SelectedRole = MessageSchema< Message::C2S_SelectedRole, uint8_t >;
+	using Login = MessageSchema< Message::C2S_Login, Role >;
+	//utf8 text:
+	using Instruction = MessageSchema< Message::C2S_Instruction, Schema::Text< uint16_t > >;
+}
+
 //state of one player in the game:
 struct Player {
 	//player inputs (sent from client):
 	struct Controls {
 		Button left, right, up, down, jump;
+		uint32_t seq = 0; //numbers each controls message a client sends; the server echoes the latest back as input_ack
 
 		void send_controls_message(Connection *connection) const;
 
@@ -41,9 +65,16 @@ struct Player {
 		//returns 'true' if read a controls message,
 		//throws on malformed controls message
 		bool recv_controls_message(Connection *connection);
+
+		//decode the payload of a controls message (e.g., as handed out by MessageDispatcher):
+		//throws on malformed controls message
+		void recv_controls_payload(uint8_t const *payload, uint32_t size);
+		//(the buttons, as sent, add to 'downs'; seq replaces 'seq')
+		void apply(uint8_t const (&buttons)[5], uint32_t seq);
 	} controls;
 
 	//player state (sent from server):
+	uint32_t id = 0; //unique within a game (assigned by spawn_player); used to match players across state messages
 	glm::vec2 position = glm::vec2(0.0f, 0.0f);
 	glm::vec2 velocity = glm::vec2(0.0f, 0.0f);
 
@@ -53,19 +84,90 @@ struct Player {
 	Role role = Role::Unknown;
 };
 
+//stable reference to a player in a Game (stays valid while other players come and go; goes stale when the player is removed):
+using PlayerHandle = SlotHandle;
+
 struct Game {
-	std::list< Player > players; //(using list so they can have stable addresses)
-	Player *spawn_player(); //add player the end of the players list (may also, e.g., play some spawn anim)
-	void remove_player(Player *); //remove player from game (may also, e.g., play some despawn anim)
+	//Players are stored as a structure of arrays, so update() streams through just the data it touches.
+	//All arrays are indexed alike and kept dense: removing a player moves the last player into its place,
+	//so indices change as players come and go -- hold on to a PlayerHandle rather than an index.
+	//'handles' maps handles to indices; its slot numbers also give the order players are listed in state messages.
+	struct Players {
+		SlotIndex handles;
+		//hot (read/written by update() every tick):
+		std::vector< float > position_x, position_y;
+		std::vector< float > velocity_x, velocity_y;
+		std::vector< Player::Controls > controls;
+		//cold:
+		std::vector< uint32_t > id;
+		std::vector< glm::vec3 > color;
+		std::vector< std::string > name;
+		std::vector< Role > role;
+
+		uint32_t size() const { return uint32_t(id.size()); }
+		bool empty() const { return id.empty(); }
+		void clear();
+
+		//index of the player with a given handle, or size() if there is none (constant time):
+		uint32_t find(PlayerHandle handle) const { return handles.find(handle); }
+		//index of the player with a given id, or size() if there is none (linear time; e.g., for clients looking up Game::self_id):
+		uint32_t find_id(uint32_t player_id) const;
+		PlayerHandle handle(uint32_t index) const { return handles.handle(index); }
+
+		glm::vec2 position(uint32_t index) const { return glm::vec2(position_x[index], position_y[index]); }
+		glm::vec2 velocity(uint32_t index) const { return glm::vec2(velocity_x[index], velocity_y[index]); }
+		void set_position(uint32_t index, glm::vec2 const &position) { position_x[index] = position.x; position_y[index] = position.y; }
+		void set_velocity(uint32_t index, glm::vec2 const &velocity) { velocity_x[index] = velocity.x; velocity_y[index] = velocity.y; }
+
+		//copy a whole player out of / into the arrays:
+		Player get(uint32_t index) const;
+		void set(uint32_t index, Player const &player);
+		//add a player (at index size() - 1) in a free slot, or in a particular slot (which must be free):
+		PlayerHandle insert(Player const &player);
+		PlayerHandle insert_at(uint32_t slot, Player const &player);
+		void erase(PlayerHandle handle);
+
+	private:
+		PlayerHandle append(PlayerHandle handle, Player const &player);
+	} players;
+
+	PlayerHandle spawn_player(); //add player to the game (may also, e.g., play some spawn anim)
+	void remove_player(PlayerHandle); //remove player from game (may also, e.g., play some despawn anim)
 
 	std::mt19937 mt; //used for spawning players
-	uint32_t next_player_number = 1; //used for naming players
+	uint32_t next_player_number = 1; //used for naming players (and as player ids, which -- unlike handles -- are never reused)
 
 	Game();
 
 	//state update function:
 	void update(float elapsed);
 
+	//update() in steps (for benchmarking):
+	void update_motion(float elapsed); //controls -> velocity -> position, then arena collisions
+	void update_collisions(); //player/player collisions
+
+	//how update_motion() runs (both give identical results; Scalar is kept for comparison):
+	// (Simd uses SSE2 on x86-64, AVX if the compiler is allowed to use it, and falls back to Scalar elsewhere)
+	enum class Integrator : uint8_t { Scalar, Simd };
+	Integrator integrator = Integrator::Simd;
+
+	//how update_collisions() finds colliding player pairs (both give identical results; AllPairs is kept for comparison):
+	enum class Broadphase : uint8_t { AllPairs, Grid };
+	Broadphase broadphase = Broadphase::Grid;
+	uint32_t grid_min_players = 128; //with fewer players than this, Grid just checks all pairs (building the grid costs more)
+
+	//scratch space for the Grid broadphase (kept between updates to avoid reallocating):
+	struct CollisionGrid {
+		std::vector< uint32_t > cells; //per player: grid cell
+		std::vector< uint32_t > starts; //per cell: first entry in 'order' (plus one past the end)
+		std::vector< uint32_t > order; //player indices grouped by cell
+		std::vector< glm::vec2 > positions; //per entry of 'order': that player's position
+		std::vector< uint32_t > hits; //earlier players touching the current one
+	} collision_grid;
+
+	//scratch space for update_motion():
+	std::vector< float > direction_x, direction_y; //per player: normalized control direction
+
 	//constants:
 	//the update rate on the server:
 	inline static constexpr float Tick = 1.0f / 30.0f;
@@ -89,11 +191,93 @@ struct Game {
 	//set game state from data in connection buffer
 	// (return true if data was read)
 	bool recv_state_message(Connection *connection);
+	void recv_state_payload(uint8_t const *payload, uint32_t size); //throws on malformed payload
+	//set game state from a state message that arrived as a datagram (see Datagram.hpp):
+	// (returns false, ignoring it, if it is no newer than the state already applied; throws on malformed message)
+	bool recv_state_datagram(uint8_t const *data, size_t size);
 
 	//used by server:
+	//players as a client reconstructs them from state messages (immutable once made, so baselines can share them):
+	struct PlayersSnapshot {
+		std::vector< Player > players; //in ascending slot order
+		std::vector< uint32_t > slots; //the slot each of 'players' is in
+	};
+
+	//what a client has been sent so far, so that state messages only need to carry changes:
+	// (TCP delivers in order, so everything sent is what the client will have when the next message arrives)
+	struct StateBaseline {
+		uint32_t seq = 0; //sequence number of the last state message sent (0 => nothing yet; next message is a keyframe)
+		bool deltas = true; //false => every message is a keyframe (e.g., when sent as datagrams, which may not all arrive)
+		std::shared_ptr< PlayersSnapshot const > players; //(set once anything has been sent)
+		Phase phase = Phase::Lobby;
+		uint8_t self_index = 0;
+		uint32_t self_id = 0;
+		uint32_t input_ack = 0;
+		std::array< uint8_t, 4 > roles = {0, 0, 0, 0}; //role_1, role_2, selected_role_1, selected_role_2
+		std::string corrupted_instruction;
+		uint8_t found_count = 0;
+		uint8_t attempt_count = 0;
+	};
+
+	//the players part of one tick's state messages, encoded once and shared by every recipient:
+	// Each prepare() encodes the change from the last prepare()'s snapshot to the game's current players.
+	// Recipients whose baseline is that last snapshot get those bytes; anyone else (e.g., a new client) gets
+	// a keyframe of the current snapshot -- which puts them on the same track for the next tick.
+	// Only the small per-recipient part of the message (seq, self_index, input_ack, ...) is written per recipient.
+	struct StateBroadcast {
+		//call after update() (or any other change to players), before sending that tick's state messages:
+		void prepare(Game const &game);
+
+		std::shared_ptr< PlayersSnapshot const > previous, current;
+		std::shared_ptr< std::vector< uint8_t > const > delta; //previous -> current
+		std::shared_ptr< std::vector< uint8_t > const > keyframe; //all of current (encoded when first needed)
+		bool copy = false; //copy the shared bytes into each connection's send buffer, rather than referencing them (for benchmarking)
+		uint64_t encodes = 0, sends = 0; //(for benchmarking)
+	};
+
 	//send game state.
-	//  Will move "connection_player" to the front of the front of the sent list.
-	void send_state_message(Connection *connection, Player *connection_player = nullptr) const;
+	//  If 'baseline' is given and has been sent before, only changes since then are sent (and 'baseline' is updated);
+	//  otherwise a keyframe with the full state is sent.
+	//  If 'broadcast' is given (and prepared), the players part of the message is taken from it rather than encoded.
+	//  'connection_player' is used to tell the client which player (1 or 2, and which id) it is,
+	//   and which of its controls messages have been applied.
+	void send_state_message(Connection *connection, PlayerHandle connection_player = PlayerHandle(), StateBaseline *baseline = nullptr, StateBroadcast *broadcast = nullptr) const;
+
+	//encode the players part of a state message (entry count + entries) as changes from 'before' (or everything if nullptr),
+	// and the players the client will have after applying it:
+	void encode_players(PlayersSnapshot const *before, std::vector< uint8_t > *out, PlayersSnapshot *after) const;
+
+	//quantization steps for position/velocity changes in delta state messages:
+	// (errors don't accumulate, since the server tracks the client's reconstructed values in StateBaseline)
+	inline static constexpr float PositionQuantum = 1.0f / 8192.0f;
+	inline static constexpr float VelocityQuantum = 1.0f / 1024.0f;
+
+	//(server) send quantized state messages: positions as 16-bit fixed point over ArenaMin..ArenaMax, velocities as
+	// 16-bit fixed point over +/- VelocityLimit (clamped), changes to either as differences of those fixed-point values,
+	// and colors as 8 bits per channel -- rather than as floats and float deltas in PositionQuantum/VelocityQuantum steps.
+	// Players the client has are always on that grid, so quantizing them again (e.g., for a keyframe) reproduces them exactly.
+	// (messages are marked, so clients decode either kind; set before encoding anything, e.g. before StateBroadcast::prepare())
+	bool quantized_state = true;
+	inline static constexpr float VelocityLimit = 2.0f * PlayerSpeed;
+	//clients reject state messages that put players in slots past this (slots are reused, so servers stay far below it):
+	inline static constexpr uint32_t MaxPlayerSlots = 1u << 20;
+
+	//used by client:
+	uint32_t state_seq = 0; //sequence number of last state message applied (0 => waiting for a keyframe)
+	bool needs_keyframe = false; //set when a delta arrives that doesn't match state_seq; client should send a keyframe request
+	uint32_t self_id = 0; //id of the player this client controls (0 => none)
+	uint32_t input_ack = 0; //seq of the last controls message the server applied before sending this state
+	//scratch space recv_state_payload() decodes into, so a malformed message changes nothing (kept to avoid reallocating):
+	Players state_players;
+	std::string state_instruction;
+
+	static void send_keyframe_request_message(Connection *c);
+
+	//setting up the datagram channel (see Datagram.hpp):
+	static void send_datagram_request_message(Connection *c);
+	static void send_datagram_hello_message(Connection *c, uint16_t port, uint64_t token);
+	static bool recv_datagram_hello_message(Connection *c, uint16_t *out_port, uint64_t *out_token);
+	static void recv_datagram_hello_payload(uint8_t const *payload, uint32_t size, uint16_t *out_port, uint64_t *out_token);
 
 	// Lobby Phase
 	uint8_t role_1 = 0; // Role enum: 0 Unknown, 1 Communicator, 2 Operative
@@ -104,18 +288,27 @@ struct Game {
 	// broadcast self_index in the snapshot so each client can tell if it’s P1 or P2.
 	uint8_t self_index = 0; // 0 = initial, 1 = Player 1, 2 = Player 2
 
+	// used by server: which players are P1 and P2 (spawn_player fills empty seats, remove_player empties them):
+	std::array< PlayerHandle, 2 > seats;
+	uint8_t seat_of(PlayerHandle player) const; // 1 = Player 1, 2 = Player 2, 0 = neither
+	// back to an empty Lobby (e.g., when one of a pair leaves):
+	void reset_lobby();
+
 	// update selected role
 	static void send_selected_role_message(Connection *c, uint8_t selected_0_or_1);
 	static bool recv_selected_role_message(Connection *c, uint8_t *out_selected);
+	static void recv_selected_role_payload(uint8_t const *payload, uint32_t size, uint8_t *out_selected);
 
 	static void send_login_message(Connection *c, Role role);
     static bool recv_login_message(Connection *c, Role *out_role);
+	static void recv_login_payload(uint8_t const *payload, uint32_t size, Role *out_role);
 
 	// Communication Phase
 	std::string instruction_text;
 	std::string corrupted_instruction;
 	static void send_instruction_message(Connection *c, std::string const &utf8);
 	static bool recv_instruction_message(Connection *c, std::string *out_utf8);
+	static void recv_instruction_payload(uint8_t const *payload, uint32_t size, std::string *out_utf8);
 
 	// Opreation Phase
 	uint8_t found_count = 0;
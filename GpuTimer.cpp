@@ -0,0 +1,239 @@
+#include "GpuTimer.hpp"
+
+#include "GL.hpp"
+#include "gl_errors.hpp"
+
+#include <algorithm>
+#include <array>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace GpuTimer {
+
+bool enabled = false;
+
+namespace {
+	struct Node {
+		std::string name;
+		uint32_t parent = 0;
+		uint32_t depth = 0;
+		std::vector< uint32_t > children;
+
+		//over the frames read back:
+		uint64_t total_ns = 0;
+		uint64_t max_ns = 0; //(in one frame)
+		uint64_t calls = 0;
+	};
+	//scope tree; nodes[0] is the whole frame:
+	std::vector< Node > nodes{Node{"frame"}};
+
+	//the queries issued during one frame:
+	struct Frame {
+		std::vector< GLuint > queries; //(pool; grows as needed, reused once read back)
+		std::vector< uint32_t > intervals; //node timed by queries[i]
+		std::vector< uint32_t > calls; //nodes pushed
+		bool pending = false; //queries issued, not yet read back
+	};
+	std::array< Frame, Latency > frames;
+	uint64_t frame_index = 0;
+
+	std::vector< uint32_t > stack; //open scopes (empty outside of frames)
+	uint32_t ignored = 0; //depth of scopes pushed outside of a frame
+	bool query_open = false;
+
+	uint64_t read = 0, dropped = 0;
+
+	//scratch for read_back():
+	std::vector< uint64_t > frame_ns, frame_calls;
+
+	Frame &current() { return frames[frame_index % Latency]; }
+
+	//end the running query (if any) and start one for the innermost open scope (if any):
+	void split() {
+		if (query_open) {
+			glEndQuery(GL_TIME_ELAPSED);
+			query_open = false;
+		}
+		if (stack.empty()) return;
+		Frame &frame = current();
+		if (frame.intervals.size() == frame.queries.size()) {
+			frame.queries.emplace_back(0);
+			glGenQueries(1, &frame.queries.back());
+		}
+		glBeginQuery(GL_TIME_ELAPSED, frame.queries[frame.intervals.size()]);
+		frame.intervals.emplace_back(stack.back());
+		query_open = true;
+	}
+
+	//add a finished frame's times to the statistics, if they are all available:
+	void read_back(Frame &frame) {
+		for (size_t i = 0; i < frame.intervals.size(); ++i) {
+			GLint available = GL_FALSE;
+			glGetQueryObjectiv(frame.queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) {
+				dropped += 1;
+				return;
+			}
+		}
+
+		frame_ns.assign(nodes.size(), 0);
+		frame_calls.assign(nodes.size(), 0);
+		for (size_t i = 0; i < frame.intervals.size(); ++i) {
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &ns);
+			//(counts toward the scope and everything enclosing it)
+			for (uint32_t n = frame.intervals[i]; ; n = nodes[n].parent) {
+				frame_ns[n] += ns;
+				if (n == 0) break;
+			}
+		}
+		for (uint32_t n : frame.calls) frame_calls[n] += 1;
+
+		for (uint32_t n = 0; n < nodes.size(); ++n) {
+			nodes[n].total_ns += frame_ns[n];
+			nodes[n].max_ns = std::max(nodes[n].max_ns, frame_ns[n]);
+			nodes[n].calls += frame_calls[n];
+		}
+		read += 1;
+	}
+}
+
+bool start() {
+	if (enabled) return true;
+	GLint bits = 0;
+	glGetQueryiv(GL_TIME_ELAPSED, GL_QUERY_COUNTER_BITS, &bits);
+	GL_ERRORS();
+	if (bits == 0) {
+		std::cerr << "GpuTimer: this GL has no timer for GL_TIME_ELAPSED queries; not timing." << std::endl;
+		return false;
+	}
+	enabled = true;
+	return true;
+}
+
+void stop() {
+	if (query_open) {
+		glEndQuery(GL_TIME_ELAPSED);
+		query_open = false;
+	}
+	for (auto &frame : frames) {
+		if (!frame.queries.empty()) glDeleteQueries(GLsizei(frame.queries.size()), frame.queries.data());
+		frame = Frame();
+	}
+	stack.clear();
+	ignored = 0;
+	enabled = false;
+}
+
+void begin_frame() {
+	if (!enabled) return;
+	if (!stack.empty()) end_frame(); //(missing end_frame() -- e.g., a mode returned early)
+
+	Frame &frame = current();
+	if (frame.pending) {
+		read_back(frame);
+		frame.pending = false;
+	}
+	frame.intervals.clear();
+	frame.calls.clear();
+
+	stack.emplace_back(0);
+	frame.calls.emplace_back(0);
+	split();
+}
+
+void end_frame() {
+	if (!enabled || stack.empty()) return;
+	stack.clear();
+	split();
+	current().pending = true;
+	frame_index += 1;
+}
+
+void push(std::string_view name) {
+	if (stack.empty()) {
+		ignored += 1;
+		return;
+	}
+	uint32_t parent = stack.back();
+	uint32_t found = 0;
+	for (uint32_t child : nodes[parent].children) {
+		if (nodes[child].name == name) {
+			found = child;
+			break;
+		}
+	}
+	if (found == 0) {
+		found = uint32_t(nodes.size());
+		nodes.emplace_back();
+		nodes.back().name = std::string(name);
+		nodes.back().parent = parent;
+		nodes.back().depth = nodes[parent].depth + 1;
+		nodes[parent].children.emplace_back(found);
+	}
+	stack.emplace_back(found);
+	current().calls.emplace_back(found);
+	split();
+}
+
+void pop() {
+	if (ignored) {
+		ignored -= 1;
+		return;
+	}
+	if (stack.size() <= 1) return; //(the frame itself is closed by end_frame())
+	stack.pop_back();
+	split();
+}
+
+void report(std::ostream &out) {
+	std::ios_base::fmtflags flags = out.flags();
+	std::streamsize precision = out.precision();
+
+	out << "GPU time per frame (GL_TIME_ELAPSED) over " << read << " frames";
+	if (dropped) out << " (" << dropped << " more dropped: results not ready after " << Latency << " frames)";
+	out << ":\n";
+	out << "  " << std::left << std::setw(40) << "scope" << std::right << std::setw(10) << "avg ms" << std::setw(10) << "max ms"
+		<< std::setw(12) << "calls/frame" << std::setw(10) << "% frame" << "\n";
+	if (read != 0) {
+		double frames_f = double(read);
+		double frame_total = double(std::max< uint64_t >(1, nodes[0].total_ns));
+		out << std::fixed;
+		//(depth-first, so nested scopes are listed, indented, under their parents)
+		std::vector< uint32_t > todo{0};
+		while (!todo.empty()) {
+			Node const &node = nodes[todo.back()];
+			todo.pop_back();
+			todo.insert(todo.end(), node.children.rbegin(), node.children.rend());
+			if (node.calls == 0) continue; //(seen only in frames that were dropped)
+
+			std::string label = std::string(2 * node.depth, ' ') + node.name;
+			out << "  " << std::left << std::setw(40) << label << std::right
+				<< std::setprecision(3) << std::setw(10) << node.total_ns / frames_f * 1e-6
+				<< std::setw(10) << node.max_ns * 1e-6
+				<< std::setprecision(1) << std::setw(12) << node.calls / frames_f
+				<< std::setw(10) << 100.0 * node.total_ns / frame_total << "\n";
+		}
+	}
+	out.flush();
+
+	out.flags(flags);
+	out.precision(precision);
+}
+
+void reset() {
+	for (auto &node : nodes) {
+		node.total_ns = 0;
+		node.max_ns = 0;
+		node.calls = 0;
+	}
+	read = 0;
+	dropped = 0;
+}
+
+uint64_t frames_read() { return read; }
+uint64_t frames_dropped() { return dropped; }
+
+}
@@ -0,0 +1,88 @@
+#pragma once
+
+/*
+ * GpuTimer measures how long the GPU spends on named scopes of drawing
+ * ("passes", like Scene::draw or the text overlay, and anything nested in
+ * them, like a Scene's drawable groups) with GL_TIME_ELAPSED queries, and
+ * keeps per-scope statistics for a timing report.
+ *
+ * GL only allows one GL_TIME_ELAPSED query at a time, so scopes don't get a
+ * query each: instead, the query running when a scope opens or closes is
+ * ended and another started, and each query's time is added to the innermost
+ * scope open during it and to every scope enclosing that one.
+ *
+ * Results are read back Latency frames later -- by then the GPU has long
+ * finished them -- and only if they are available, so timing never waits on
+ * the GPU (frames whose results aren't ready yet are counted as dropped).
+ * Everything here is GL 3.3 core, so it works on software GL (e.g., llvmpipe).
+ *
+ * Call from the GL thread only.
+ *
+ * Usage:
+ *   GpuTimer::start(); //(after init_GL(); returns false if the GL can't time queries)
+ *   while (...) {
+ *     GpuTimer::begin_frame();
+ *     {
+ *       GpuTimer::Scope pass("Scene::draw"); //(or GPU_SCOPE("Scene::draw"))
+ *       ...draw...
+ *     }
+ *     GpuTimer::end_frame();
+ *   }
+ *   GpuTimer::report(std::cout);
+ *   GpuTimer::stop(); //(before the GL context goes away)
+ */
+
+#include <cstdint>
+#include <iosfwd>
+#include <string_view>
+
+namespace GpuTimer {
+
+//time scopes? (set by start(), cleared by stop())
+extern bool enabled;
+
+//frames between issuing queries and reading them back (so this many sets of queries are in flight):
+inline constexpr uint32_t Latency = 3;
+
+//make queries and start timing; returns false (and stays disabled) if the GL has no timer:
+bool start();
+//delete queries and stop timing:
+void stop();
+
+//mark frame boundaries; begin_frame() also reads back the results of the frame Latency frames ago:
+void begin_frame();
+void end_frame();
+
+//open a scope (nested in the innermost one open), or close the innermost one:
+// (scopes are identified by name within their parent; names are copied)
+void push(std::string_view name);
+void pop();
+
+//per-scope average/max GPU milliseconds per frame, calls per frame, and share of the frame's GPU time:
+void report(std::ostream &out);
+//forget the statistics gathered so far (but not the scopes):
+void reset();
+
+//frames whose results have been read back, or had to be skipped because they weren't ready:
+uint64_t frames_read();
+uint64_t frames_dropped();
+
+//times the scope it lives in:
+struct Scope {
+	Scope(std::string_view name) : active(enabled) {
+		if (active) push(name);
+	}
+	~Scope() {
+		if (active) pop();
+	}
+	Scope(Scope const &) = delete;
+	Scope &operator=(Scope const &) = delete;
+
+	bool active;
+};
+
+}
+
+#define GPU_TIMER_CONCAT2(A, B) A##B
+#define GPU_TIMER_CONCAT(A, B) GPU_TIMER_CONCAT2(A, B)
+#define GPU_SCOPE(NAME) GpuTimer::Scope GPU_TIMER_CONCAT(gpu_scope_, __LINE__)(NAME)
@@ -0,0 +1,162 @@
+#include "Log.hpp"
+
+#include <atomic>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <cstdarg>
+#include <cstdio>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+namespace Log {
+
+enum class Level : uint8_t { Info, Warning };
+
+namespace {
+	static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+	struct Slot {
+		std::atomic< uint64_t > sequence{0}; //== position: free for the producer claiming 'position'; == position + 1: full
+		Level level = Level::Info;
+		uint32_t length = 0;
+		char text[LineSize];
+	};
+
+	struct Ring {
+		Ring() {
+			for (uint32_t i = 0; i < Capacity; ++i) slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+		std::array< Slot, Capacity > slots;
+		alignas(64) std::atomic< uint64_t > tail{0}; //next position to claim (producers)
+		alignas(64) uint64_t head = 0; //next position to write out (writer thread only)
+		std::atomic< uint64_t > dropped{0};
+
+		std::atomic< bool > running{false};
+		std::thread writer;
+		std::mutex mutex; //(only for sleeping / waking the writer)
+		std::condition_variable wake;
+		bool stopping = false;
+	};
+	Ring &ring() {
+		static Ring ring;
+		return ring;
+	}
+
+	void write_out(Level level, char const *text, uint32_t length) {
+		std::ostream &out = (level == Level::Warning ? std::cerr : std::cout);
+		out.write(text, length);
+		out.put('\n');
+	}
+
+	//format into 'text' (truncating), returning the length kept:
+	uint32_t format_into(char *text, char const *format, va_list args) {
+		int ret = std::vsnprintf(text, LineSize, format, args);
+		if (ret < 0) return 0;
+		return (uint32_t(ret) < LineSize ? uint32_t(ret) : LineSize - 1);
+	}
+
+	void log(Level level, char const *format, va_list args) {
+		Ring &r = ring();
+		if (!r.running.load(std::memory_order_acquire)) {
+			char text[LineSize];
+			uint32_t length = format_into(text, format, args);
+			write_out(level, text, length);
+			if (level == Level::Warning) std::cerr.flush();
+			else std::cout.flush();
+			return;
+		}
+
+		//claim a slot:
+		uint64_t position = r.tail.load(std::memory_order_relaxed);
+		Slot *slot;
+		while (true) {
+			slot = &r.slots[position & (Capacity - 1)];
+			int64_t diff = int64_t(slot->sequence.load(std::memory_order_acquire)) - int64_t(position);
+			if (diff == 0) {
+				if (r.tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) break;
+			} else if (diff < 0) {
+				//(the writer hasn't emptied this slot since the last time around)
+				r.dropped.fetch_add(1, std::memory_order_relaxed);
+				return;
+			} else {
+				position = r.tail.load(std::memory_order_relaxed);
+			}
+		}
+
+		//fill it, and hand it to the writer:
+		slot->level = level;
+		slot->length = format_into(slot->text, format, args);
+		slot->sequence.store(position + 1, std::memory_order_release);
+	}
+
+	//write out every full slot, in order; returns false if there were none:
+	bool drain(Ring &r) {
+		bool any = false;
+		while (true) {
+			Slot &slot = r.slots[r.head & (Capacity - 1)];
+			if (slot.sequence.load(std::memory_order_acquire) != r.head + 1) break;
+			write_out(slot.level, slot.text, slot.length);
+			slot.sequence.store(r.head + Capacity, std::memory_order_release);
+			r.head += 1;
+			any = true;
+		}
+		if (any) {
+			std::cout.flush();
+			std::cerr.flush();
+		}
+		return any;
+	}
+}
+
+void info(char const *format, ...) {
+	va_list args;
+	va_start(args, format);
+	log(Level::Info, format, args);
+	va_end(args);
+}
+
+void warn(char const *format, ...) {
+	va_list args;
+	va_start(args, format);
+	log(Level::Warning, format, args);
+	va_end(args);
+}
+
+void start() {
+	Ring &r = ring();
+	if (r.running) return;
+	r.stopping = false;
+	r.running.store(true, std::memory_order_release);
+	r.writer = std::thread([&r]() {
+		std::unique_lock< std::mutex > lock(r.mutex);
+		while (!r.stopping) {
+			lock.unlock();
+			bool wrote = drain(r);
+			lock.lock();
+			//(producers never wait on or signal the writer; it just checks back often enough to keep lines timely)
+			if (!wrote) r.wake.wait_for(lock, std::chrono::milliseconds(10));
+		}
+	});
+}
+
+void stop() {
+	Ring &r = ring();
+	if (!r.running) return;
+	{
+		std::lock_guard< std::mutex > lock(r.mutex);
+		r.stopping = true;
+	}
+	r.wake.notify_one();
+	r.writer.join();
+	r.running.store(false, std::memory_order_release);
+	//(lines claimed by threads still logging land after this; they're written on the next start(), if any)
+	drain(r);
+}
+
+uint64_t dropped() {
+	return ring().dropped.load(std::memory_order_relaxed);
+}
+
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+/*
+ * Log hands lines of text to a background thread to write out, so a thread
+ * that logs (e.g., a shard partway through a tick) only formats the line into
+ * a ring buffer, rather than waiting on the console.
+ *
+ * The ring has a fixed number of fixed-size slots. Any number of threads may
+ * log at once: each claims a slot with one atomic compare-and-swap, formats
+ * into it, and marks it full (the bounded queue from Dmitry Vyukov's
+ * "Bounded MPMC queue", with the writer thread as the only consumer). If the
+ * writer falls a whole ring behind, new lines are dropped and counted rather
+ * than waited on; lines longer than a slot are truncated.
+ *
+ * Until start() is called (and after stop()), lines are written right away,
+ * on the calling thread -- so programs that don't care (e.g., the client)
+ * needn't do anything.
+ *
+ * Usage:
+ *   Log::start(); //(early in main)
+ *   Log::info("Shard %u accepting datagrams on port %u.", index, port); //(to std::cout)
+ *   Log::warn("[%s] send() returned error %d, disconnecting.", where, errno); //(to std::cerr)
+ *   Log::stop(); //(writes whatever is still queued)
+ */
+
+#include <cstdint>
+
+#if defined(__GNUC__)
+#define LOG_PRINTF_FORMAT __attribute__((format(printf, 1, 2)))
+#else
+#define LOG_PRINTF_FORMAT
+#endif
+
+namespace Log {
+
+//printf-style:
+void info(char const *format, ...) LOG_PRINTF_FORMAT;
+void warn(char const *format, ...) LOG_PRINTF_FORMAT;
+
+//start / stop the writer thread (call from one thread, e.g. main's):
+void start();
+void stop();
+
+//lines dropped because the ring was full:
+uint64_t dropped();
+
+inline constexpr uint32_t Capacity = 1024; //slots in the ring (a power of two)
+inline constexpr uint32_t LineSize = 240; //longest line kept, in bytes
+
+}
@@ -173,6 +173,7 @@ const common_names = [
 	maek.CPP('DrawLines.cpp'),
 	maek.CPP('ColorProgram.cpp'),
 	maek.CPP('Scene.cpp'),
+	maek.CPP('GpuTimer.cpp'),
 	maek.CPP('Mesh.cpp'),
 	maek.CPP('load_save_png.cpp'),
 	maek.CPP('gl_compile_program.cpp'),
@@ -180,9 +181,28 @@ const common_names = [
 	maek.CPP('GL.cpp'),
 	maek.CPP('Load.cpp'),
 	maek.CPP('Connection.cpp'),
+	maek.CPP('Log.cpp'),
+	maek.CPP('Metrics.cpp'),
+	maek.CPP('Profiler.cpp'),
+	maek.CPP('Capture.cpp'),
+	maek.CPP('Datagram.cpp'),
+	maek.CPP('NetSim.cpp'),
+	maek.CPP('MessageDispatcher.cpp'),
+	maek.CPP('Smoothing.cpp'),
+	maek.CPP('Rooms.cpp'),
+	maek.CPP('Shard.cpp'),
+	maek.CPP('TickScheduler.cpp'),
 	maek.CPP('hex_dump.cpp')
 ];
 
+const bench_names = [
+	maek.CPP('bench.cpp')
+];
+
+const loadgen_names = [
+	maek.CPP('loadgen.cpp')
+];
+
 const show_meshes_names = [
 	maek.CPP('show-meshes.cpp'),
 	maek.CPP('ShowMeshesProgram.cpp'),
@@ -201,11 +221,13 @@ const show_scene_names = [
 //returns exeFile: exeFileBase + a platform-dependant suffix (e.g., '.exe' on windows)
 const client_exe = maek.LINK([...client_names, ...common_names], 'dist/client');
 const server_exe = maek.LINK([...server_names, ...common_names], 'dist/server');
+const bench_exe = maek.LINK([...bench_names, ...common_names], 'dist/bench');
+const loadgen_exe = maek.LINK([...loadgen_names, ...common_names], 'dist/loadgen');
 const show_meshes_exe = maek.LINK([...show_meshes_names, ...common_names], 'scenes/show-meshes');
 const show_scene_exe = maek.LINK([...show_scene_names, ...common_names], 'scenes/show-scene');
 
 //set the default target to the game (and copy the readme files):
-maek.TARGETS = [client_exe, server_exe, show_meshes_exe, show_scene_exe, ...copies];
+maek.TARGETS = [client_exe, server_exe, bench_exe, loadgen_exe, show_meshes_exe, show_scene_exe, ...copies];
 
 //Note that tasks that produce ':abstract targets' are never cached.
 // This is similar to how .PHONY targets behave in make.
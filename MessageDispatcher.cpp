@@ -0,0 +1,73 @@
+#include "MessageDispatcher.hpp"
+
+#include "Connection.hpp"
+
+#include <cassert>
+#include <iomanip>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+void MessageDispatcher::on(Message type, uint32_t min_size, uint32_t max_size, Handler const &handler) {
+	assert(min_size <= max_size);
+	assert(max_size <= 0xffffff); //size must fit in the 24-bit header field
+	Entry &entry = entries[uint8_t(type)];
+	entry.handler = handler;
+	entry.min_size = min_size;
+	entry.max_size = max_size;
+}
+
+uint32_t MessageDispatcher::dispatch(Connection *connection_) {
+	assert(connection_);
+	auto &connection = *connection_;
+	auto &recv_buffer = connection.recv_buffer;
+
+	uint32_t handled = 0;
+	//NOTE: a handler may close the connection, in which case any remaining data is left alone:
+	while (connection && recv_buffer.size() >= HeaderSize) {
+		uint8_t const *header = recv_buffer.data();
+		uint8_t type = header[0];
+		uint32_t size = Schema::payload_size(header);
+
+		Entry const &entry = entries[type];
+		if (!entry.handler) {
+			throw std::runtime_error("Unexpected message of type " + Schema::type_name(type) + ".");
+		}
+		if (size < entry.min_size || size > entry.max_size) {
+			throw std::runtime_error("Message of type " + Schema::type_name(type) + " has size " + std::to_string(size)
+				+ " outside of [" + std::to_string(entry.min_size) + ", " + std::to_string(entry.max_size) + "].");
+		}
+
+		//wait for the complete message:
+		if (recv_buffer.size() < HeaderSize + size) break;
+
+		if (on_message) on_message(&connection, header, HeaderSize + size);
+
+		auto before = std::chrono::steady_clock::now();
+		entry.handler(&connection, header + HeaderSize, size);
+		Stats &stat = stats[type];
+		stat.time += std::chrono::steady_clock::now() - before;
+		stat.count += 1;
+		stat.bytes += HeaderSize + size;
+
+		recv_buffer.pop_front(HeaderSize + size);
+		++handled;
+	}
+	return handled;
+}
+
+void MessageDispatcher::dump_stats(std::ostream &out) const {
+	out << std::setw(6) << "type" << std::setw(12) << "count" << std::setw(14) << "bytes"
+		<< std::setw(14) << "total (ms)" << std::setw(12) << "avg (us)" << '\n';
+	for (uint32_t type = 0; type < 256; ++type) {
+		if (!entries[type].handler) continue;
+		Stats const &stat = stats[type];
+		double total_ms = std::chrono::duration< double, std::milli >(stat.time).count();
+		double avg_us = (stat.count ? 1000.0 * total_ms / double(stat.count) : 0.0);
+
+		out << std::setw(6) << Schema::type_name(uint8_t(type)) << std::setw(12) << stat.count << std::setw(14) << stat.bytes
+			<< std::setw(14) << std::fixed << std::setprecision(3) << total_ms
+			<< std::setw(12) << std::fixed << std::setprecision(3) << avg_us << '\n';
+	}
+	out.flush();
+}
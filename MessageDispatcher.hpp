@@ -0,0 +1,62 @@
+#pragma once
+
+/*
+ * MessageDispatcher routes complete messages in a connection's recv_buffer to
+ * handlers registered by Message type.
+ *
+ * Each message is framed as [type, size_low8, size_mid8, size_high8] followed by
+ * 'size' payload bytes. The header is parsed once, the size is checked against
+ * the limits given when the handler was registered, and the handler gets a
+ * pointer straight into recv_buffer (valid only for the duration of the call).
+ *
+ * Per-type counters (messages, bytes, time spent in handlers) are kept so they
+ * can be dumped on demand.
+ */
+
+#include "Game.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <iosfwd>
+
+struct Connection;
+
+struct MessageDispatcher {
+	//handler is passed the connection the message arrived on and a view of its payload:
+	using Handler = std::function< void(Connection *, uint8_t const *payload, uint32_t size) >;
+
+	//handle messages of type 'type' with 'handler'; payloads outside [min_size, max_size] are rejected:
+	void on(Message type, uint32_t min_size, uint32_t max_size, Handler const &handler);
+
+	//handle every complete message at the front of connection->recv_buffer:
+	// returns the number of messages handled
+	// throws on unregistered message types, out-of-range sizes, or (rethrown) handler errors
+	uint32_t dispatch(Connection *connection);
+
+	//(if set) sees each message (header included) that passed the checks above, just before its handler does:
+	// (e.g., to record it -- see Shard::record())
+	std::function< void(Connection *, uint8_t const *message, uint32_t size) > on_message;
+
+	struct Stats {
+		uint64_t count = 0; //messages handled
+		uint64_t bytes = 0; //header + payload bytes consumed
+		std::chrono::steady_clock::duration time = std::chrono::steady_clock::duration(0); //total time spent in handler
+	};
+	std::array< Stats, 256 > stats; //indexed by Message type byte
+
+	//write a table of stats for every registered message type:
+	void dump_stats(std::ostream &out) const;
+
+	//every message starts with a header of this many bytes:
+	static constexpr uint32_t HeaderSize = Schema::HeaderSize;
+
+private:
+	struct Entry {
+		Handler handler;
+		uint32_t min_size = 0;
+		uint32_t max_size = 0;
+	};
+	std::array< Entry, 256 > entries; //indexed by Message type byte
+};
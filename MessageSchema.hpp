@@ -0,0 +1,206 @@
+#pragma once
+
+/*
+ * MessageSchema describes a message's payload as a list of fields, and from
+ * that generates the code to send it, to receive it from a connection's
+ * recv_buffer, and to decode a payload (e.g., one handed out by
+ * MessageDispatcher) -- so the field order is written down once, and the
+ * [type, size_low8, size_mid8, size_high8] header is written and checked the
+ * same way for every message.
+ *
+ * Fields are either plain-old-data (written as their bytes, like
+ * Connection::send does) or Schema::Text< Length > (a Length-sized byte count,
+ * then that many bytes; sent from / received into a std::string, truncated to
+ * fit). When every field is plain-old-data the payload size is a compile-time
+ * constant: send() writes the whole message with one append, and receiving
+ * rejects any other size before reading a byte of the payload.
+ *
+ * Usage:
+ *   using Hello = MessageSchema< Message::S2C_DatagramHello, uint16_t, uint64_t >; //port, token
+ *   Hello::send(connection, port, token);
+ *   if (Hello::recv(connection, &port, &token)) { ... } //(false if no complete Hello at the front of recv_buffer)
+ *   Hello::decode(payload, size, &port, &token); //(throws if malformed)
+ *   dispatcher.on(Message::S2C_DatagramHello, Hello::MinSize, Hello::MaxSize, ...);
+ *
+ * (any output pointer may be nullptr to skip that field)
+ *
+ * Messages laid out according to their contents (e.g., S2C_State) are written
+ * between Schema::begin_message() and Schema::end_message(), which take care
+ * of the header.
+ */
+
+#include "ByteReader.hpp"
+#include "Connection.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+enum class Message : uint8_t; //(see Game.hpp)
+
+namespace Schema {
+	//every message starts with [type, size_low8, size_mid8, size_high8]:
+	inline constexpr uint32_t HeaderSize = 4;
+	inline constexpr uint32_t MaxPayloadSize = 0xffffff;
+
+	inline void put_header(uint8_t *header, Message type, uint32_t size) {
+		assert(size <= MaxPayloadSize);
+		header[0] = uint8_t(type);
+		header[1] = uint8_t(size);
+		header[2] = uint8_t(size >> 8);
+		header[3] = uint8_t(size >> 16);
+	}
+	inline uint32_t payload_size(uint8_t const *header) {
+		return (uint32_t(header[3]) << 16) | (uint32_t(header[2]) << 8) | uint32_t(header[1]);
+	}
+	//(e.g., "'L'" for C2S_Login, "1" for C2S_Controls)
+	inline std::string type_name(uint8_t type) {
+		return (type >= 0x20 && type < 0x7f ? std::string("'") + char(type) + "'" : std::to_string(type));
+	}
+
+	//for messages written by hand: write the header (size to be filled in later), and return where the payload starts:
+	inline size_t begin_message(Connection *connection, Message type) {
+		uint8_t header[HeaderSize];
+		put_header(header, type, 0);
+		connection->send_raw(header, HeaderSize);
+		return connection->send_buffer.size();
+	}
+	//...then, once the payload has been written, fill in its size:
+	inline void end_message(Connection *connection, size_t mark) {
+		size_t size = connection->send_buffer.size() - mark;
+		if (size > MaxPayloadSize) throw std::runtime_error("Message payload of " + std::to_string(size) + " bytes is too large to send.");
+		connection->send_buffer[mark - 3] = uint8_t(size);
+		connection->send_buffer[mark - 2] = uint8_t(size >> 8);
+		connection->send_buffer[mark - 1] = uint8_t(size >> 16);
+	}
+
+	//field type: a Length-sized byte count, then that many bytes:
+	template< typename Length >
+	struct Text {
+		static_assert(std::is_unsigned_v< Length >, "Text length must be an unsigned integer");
+	};
+
+	//how each kind of field is sized, written, and read:
+	template< typename T >
+	struct Field {
+		static_assert(std::is_trivially_copyable_v< T >, "Plain fields must be plain-old-data");
+		using Value = T;
+		static constexpr bool Fixed = true;
+		static constexpr uint32_t MinSize = sizeof(T), MaxSize = sizeof(T);
+
+		static constexpr uint32_t size(T const &) { return sizeof(T); }
+		static void put(uint8_t **at, T const &value) {
+			std::memcpy(*at, &value, sizeof(T));
+			*at += sizeof(T);
+		}
+		static void send(Connection *connection, T const &value) { connection->send(value); }
+		//(payload size already checked:)
+		static void get(uint8_t const **at, T *value) {
+			if (value) std::memcpy(value, *at, sizeof(T));
+			*at += sizeof(T);
+		}
+		static void read(ByteReader *reader, T *value) {
+			std::span< uint8_t const > bytes = reader->take(sizeof(T));
+			if (value) std::memcpy(value, bytes.data(), sizeof(T));
+		}
+	};
+
+	template< typename Length >
+	struct Field< Text< Length > > {
+		using Value = std::string;
+		static constexpr bool Fixed = false;
+		static constexpr uint32_t MinSize = sizeof(Length);
+		static constexpr uint32_t MaxSize = uint32_t(sizeof(Length) + std::numeric_limits< Length >::max());
+
+		static Length length(std::string const &value) {
+			return Length(std::min< size_t >(value.size(), std::numeric_limits< Length >::max()));
+		}
+		static uint32_t size(std::string const &value) { return sizeof(Length) + length(value); }
+		static void send(Connection *connection, std::string const &value) {
+			Length count = length(value);
+			connection->send(count);
+			connection->send_raw(value.data(), count);
+		}
+		static void read(ByteReader *reader, std::string *value) {
+			Length count = reader->read< Length >();
+			if (value) reader->read_string(value, count);
+			else reader->take(count);
+		}
+	};
+}
+
+template< Message Type, typename... Fields >
+struct MessageSchema {
+	//(an empty payload is fixed-size, too)
+	static constexpr bool Fixed = (true && ... && Schema::Field< Fields >::Fixed);
+	static constexpr uint32_t MinSize = (0 + ... + Schema::Field< Fields >::MinSize);
+	static constexpr uint32_t MaxSize = (0 + ... + Schema::Field< Fields >::MaxSize);
+	static_assert(MaxSize <= Schema::MaxPayloadSize, "Message payload can't fit in the size header");
+
+	//append the message to connection->send_buffer:
+	static void send(Connection *connection, typename Schema::Field< Fields >::Value const &... values) {
+		assert(connection);
+		if constexpr (Fixed) {
+			std::array< uint8_t, Schema::HeaderSize + MinSize > bytes;
+			Schema::put_header(bytes.data(), Type, MinSize);
+			[[maybe_unused]] uint8_t *at = bytes.data() + Schema::HeaderSize;
+			(Schema::Field< Fields >::put(&at, values), ...);
+			connection->send_raw(bytes.data(), bytes.size());
+		} else {
+			uint8_t header[Schema::HeaderSize];
+			Schema::put_header(header, Type, (0 + ... + Schema::Field< Fields >::size(values)));
+			connection->send_raw(header, Schema::HeaderSize);
+			(Schema::Field< Fields >::send(connection, values), ...);
+		}
+	}
+
+	//if a complete message of this type is at the front of connection->recv_buffer, decode it, remove it, and return true:
+	// (throws if it can't be a valid message of this type)
+	static bool recv(Connection *connection, typename Schema::Field< Fields >::Value *... out) {
+		assert(connection);
+		auto &recv_buffer = connection->recv_buffer;
+		if (recv_buffer.size() < Schema::HeaderSize || recv_buffer[0] != uint8_t(Type)) return false;
+		uint32_t size = Schema::payload_size(recv_buffer.data());
+		check_size(size);
+		if (recv_buffer.size() < Schema::HeaderSize + size) return false;
+		decode(recv_buffer.data() + Schema::HeaderSize, size, out...);
+		recv_buffer.pop_front(Schema::HeaderSize + size);
+		return true;
+	}
+
+	//decode a payload (without its header) into the given fields; throws if malformed:
+	static void decode(uint8_t const *payload, uint32_t size, typename Schema::Field< Fields >::Value *... out) {
+		check_size(size);
+		if constexpr (Fixed) {
+			[[maybe_unused]] uint8_t const *at = payload;
+			(Schema::Field< Fields >::get(&at, out), ...);
+		} else {
+			ByteReader reader(payload, size, "message payload");
+			(Schema::Field< Fields >::read(&reader, out), ...);
+			reader.finish();
+		}
+	}
+
+	static void check_size(uint32_t size) {
+		if (size < MinSize || size > MaxSize) size_error(size);
+	}
+
+private:
+	//(kept out of line, so the checks above stay small enough to inline)
+#if defined(__GNUC__)
+	__attribute__((noinline, cold))
+#endif
+	[[noreturn]] static void size_error(uint32_t size);
+};
+
+template< Message Type, typename... Fields >
+void MessageSchema< Type, Fields... >::size_error(uint32_t size) {
+	throw std::runtime_error("Message of type " + Schema::type_name(uint8_t(Type)) + " has size " + std::to_string(size)
+		+ (Fixed ? ", expecting " + std::to_string(MinSize) : " outside of [" + std::to_string(MinSize) + ", " + std::to_string(MaxSize) + "]") + ".");
+}
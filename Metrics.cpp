@@ -0,0 +1,129 @@
+#include "Metrics.hpp"
+
+#include <cmath>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace Metrics {
+
+uint64_t Histogram::lower(uint32_t bucket) {
+	if (bucket < 2 * SubBuckets) return bucket;
+	uint32_t shift = (bucket >> SubBits) - 1;
+	if (shift + SubBits >= 64) return std::numeric_limits< uint64_t >::max(); //(past the last bucket)
+	return uint64_t(SubBuckets | (bucket & (SubBuckets - 1))) << shift;
+}
+
+uint64_t Histogram::quantile(double q) const {
+	//(counts are read one at a time, so this is a snapshot only if nothing is being recorded)
+	uint64_t total = 0;
+	for (auto const &c : counts) total += c.load(std::memory_order_relaxed);
+	if (total == 0) return 0;
+	uint64_t rank = std::max< uint64_t >(1, uint64_t(std::ceil(q * double(total))));
+	uint64_t seen = 0;
+	for (uint32_t b = 0; b < BucketCount; ++b) {
+		seen += counts[b].load(std::memory_order_relaxed);
+		if (seen >= rank) {
+			//(the largest value that lands in the bucket)
+			uint64_t next = (b + 1 < BucketCount ? lower(b + 1) : std::numeric_limits< uint64_t >::max());
+			return (next == std::numeric_limits< uint64_t >::max() ? next : next - 1);
+		}
+	}
+	return std::numeric_limits< uint64_t >::max();
+}
+
+//---------------------------------
+
+Registry::Series &Registry::find(std::string const &name, std::string const &help, std::string const &labels, Kind kind, double scale) {
+	std::lock_guard< std::mutex > lock(mutex);
+	Family *family = nullptr;
+	for (auto &f : families) {
+		if (f->name == name) {
+			family = f.get();
+			break;
+		}
+	}
+	if (!family) {
+		families.emplace_back(std::make_unique< Family >());
+		family = families.back().get();
+		family->name = name;
+		family->help = help;
+		family->kind = kind;
+		family->scale = scale;
+	} else if (family->kind != kind) {
+		throw std::runtime_error("Metric '" + name + "' was already registered as a different kind of metric.");
+	}
+
+	for (auto &s : family->series) {
+		if (s->labels == labels) return *s;
+	}
+	family->series.emplace_back(std::make_unique< Series >());
+	Series &series = *family->series.back();
+	series.labels = labels;
+	if (kind == Kind::Counter) series.counter = std::make_unique< Counter >();
+	if (kind == Kind::Gauge) series.gauge = std::make_unique< Gauge >();
+	if (kind == Kind::Histogram) series.histogram = std::make_unique< Histogram >();
+	return series;
+}
+
+Counter &Registry::counter(std::string const &name, std::string const &help, std::string const &labels) {
+	return *find(name, help, labels, Kind::Counter, 1.0).counter;
+}
+
+Gauge &Registry::gauge(std::string const &name, std::string const &help, std::string const &labels) {
+	return *find(name, help, labels, Kind::Gauge, 1.0).gauge;
+}
+
+Histogram &Registry::histogram(std::string const &name, std::string const &help, std::string const &labels, double scale) {
+	return *find(name, help, labels, Kind::Histogram, scale).histogram;
+}
+
+void Registry::write(std::ostream &out) const {
+	std::lock_guard< std::mutex > lock(mutex);
+
+	//(name{labels} or name{labels,extra}, leaving out empty braces)
+	auto series_name = [](std::string const &name, std::string const &labels, std::string const &extra = "") {
+		std::string all = labels + (!labels.empty() && !extra.empty() ? "," : "") + extra;
+		return (all.empty() ? name : name + "{" + all + "}");
+	};
+
+	std::ostringstream text;
+	text << std::setprecision(12); //(enough for byte counts and nanoseconds, without float noise from scaling)
+	for (auto const &family : families) {
+		static char const *types[] = {"counter", "gauge", "summary"};
+		text << "# HELP " << family->name << " " << family->help << "\n";
+		text << "# TYPE " << family->name << " " << types[uint32_t(family->kind)] << "\n";
+		for (auto const &series : family->series) {
+			if (series->counter) {
+				text << series_name(family->name, series->labels) << " " << series->counter->value() << "\n";
+			} else if (series->gauge) {
+				text << series_name(family->name, series->labels) << " " << series->gauge->value() << "\n";
+			} else {
+				Histogram const &histogram = *series->histogram;
+				for (double q : Quantiles) {
+					std::ostringstream quantile;
+					quantile << "quantile=\"" << q << "\"";
+					text << series_name(family->name, series->labels, quantile.str()) << " " << double(histogram.quantile(q)) * family->scale << "\n";
+				}
+				text << series_name(family->name + "_sum", series->labels) << " " << double(histogram.sum.load(std::memory_order_relaxed)) * family->scale << "\n";
+				text << series_name(family->name + "_count", series->labels) << " " << histogram.count.load(std::memory_order_relaxed) << "\n";
+			}
+		}
+	}
+	out << text.str();
+}
+
+std::string Registry::text() const {
+	std::ostringstream out;
+	write(out);
+	return out.str();
+}
+
+Registry &registry() {
+	static Registry registry;
+	return registry;
+}
+
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+/*
+ * Metrics is a process-wide registry of named counters, gauges, and latency
+ * histograms, written out in the Prometheus text format (e.g., for a scraper
+ * polling the server's --metrics port, or a file read by node_exporter).
+ *
+ * Updating a metric is a relaxed atomic operation, so any thread may update
+ * any metric without locks; registering one (and writing them all out) takes
+ * the registry's mutex, so do that outside of hot paths and keep the returned
+ * reference. Metrics live as long as the process.
+ *
+ * Histograms count values (e.g., nanoseconds) in log-linear buckets -- 8 per
+ * power of two, as HdrHistogram does -- so recording is a couple of bit
+ * operations and an increment, and any quantile is known to within 1/8 of its
+ * value. They are written out as Prometheus summaries (a few quantiles, the
+ * sum, and the count).
+ *
+ * Usage:
+ *   Metrics::Counter &accepted = Metrics::registry().counter("server_connections_accepted_total", "Connections accepted.");
+ *   Metrics::Histogram &tick = Metrics::registry().histogram("game_tick_seconds", "Time to run a tick.", "shard=\"0\"", 1e-9);
+ *   accepted.add();
+ *   tick.record(nanoseconds);
+ *   Metrics::registry().write(std::cout);
+ */
+
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Metrics {
+
+//a count that only goes up:
+struct Counter {
+	void add(uint64_t amount = 1) { total.fetch_add(amount, std::memory_order_relaxed); }
+	//(for mirroring a count kept elsewhere, e.g. in a single thread's stats struct)
+	void set(uint64_t value) { total.store(value, std::memory_order_relaxed); }
+	uint64_t value() const { return total.load(std::memory_order_relaxed); }
+
+	std::atomic< uint64_t > total{0};
+};
+
+//a value that goes up and down:
+struct Gauge {
+	void set(double value_) { current.store(value_, std::memory_order_relaxed); }
+	double value() const { return current.load(std::memory_order_relaxed); }
+
+	std::atomic< double > current{0.0};
+};
+
+//counts of values, in buckets whose width is 1/SubBuckets of their lower bound:
+struct Histogram {
+	static constexpr uint32_t SubBits = 3;
+	static constexpr uint32_t SubBuckets = 1u << SubBits;
+	//(values under 2 * SubBuckets get a bucket each; after that, SubBuckets per power of two up to 2^64)
+	static constexpr uint32_t BucketCount = (64 - SubBits + 1) * SubBuckets;
+
+	void record(uint64_t value) {
+		counts[bucket(value)].fetch_add(1, std::memory_order_relaxed);
+		count.fetch_add(1, std::memory_order_relaxed);
+		sum.fetch_add(value, std::memory_order_relaxed);
+	}
+
+	//smallest value v such that a fraction 'q' of recorded values are <= v (to within a bucket; 0 if nothing recorded):
+	uint64_t quantile(double q) const;
+
+	static uint32_t bucket(uint64_t value) {
+		if (value < 2 * SubBuckets) return uint32_t(value);
+		uint32_t shift = 63 - uint32_t(std::countl_zero(value)) - SubBits; //(top bit, less the sub-bucket bits)
+		return ((shift + 1) << SubBits) | uint32_t((value >> shift) & (SubBuckets - 1));
+	}
+	//values in [lower(b), lower(b + 1)) land in bucket b:
+	static uint64_t lower(uint32_t bucket);
+
+	std::array< std::atomic< uint64_t >, BucketCount > counts{};
+	std::atomic< uint64_t > count{0};
+	std::atomic< uint64_t > sum{0};
+};
+
+struct Registry {
+	//find or add the metric with this name and labels (e.g. 'shard="0",type="C"', or "" for none):
+	// 'help' is only used the first time a name is seen; throws if the name is already a different kind of metric.
+	Counter &counter(std::string const &name, std::string const &help, std::string const &labels = "");
+	Gauge &gauge(std::string const &name, std::string const &help, std::string const &labels = "");
+	//(written out multiplied by 'scale'; e.g., 1e-9 to record nanoseconds and report seconds)
+	Histogram &histogram(std::string const &name, std::string const &help, std::string const &labels = "", double scale = 1.0);
+
+	//everything, in the Prometheus text exposition format (version 0.0.4):
+	void write(std::ostream &out) const;
+	std::string text() const;
+
+	//quantiles written out for histograms:
+	inline static constexpr std::array< double, 5 > Quantiles = {0.5, 0.9, 0.99, 0.999, 1.0};
+
+private:
+	enum class Kind : uint8_t { Counter, Gauge, Histogram };
+	struct Series {
+		std::string labels;
+		std::unique_ptr< Counter > counter;
+		std::unique_ptr< Gauge > gauge;
+		std::unique_ptr< Histogram > histogram;
+	};
+	struct Family {
+		std::string name, help;
+		Kind kind;
+		double scale = 1.0;
+		std::vector< std::unique_ptr< Series > > series; //(in the order added)
+	};
+	Series &find(std::string const &name, std::string const &help, std::string const &labels, Kind kind, double scale);
+
+	mutable std::mutex mutex;
+	std::vector< std::unique_ptr< Family > > families; //(in the order added)
+};
+
+//the process-wide registry:
+Registry &registry();
+
+}
@@ -0,0 +1,169 @@
+#include "NetSim.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+NetConditions NetConditions::parse(std::string const &spec) {
+	NetConditions conditions;
+
+	//a number with one of the given suffixes (each with its scale):
+	auto number = [&](std::string const &name, std::string const &value, std::vector< std::pair< std::string, float > > const &units) {
+		size_t used = 0;
+		float x;
+		try {
+			x = std::stof(value, &used);
+		} catch (std::exception const &) {
+			throw std::runtime_error("Expecting a number for '" + name + "', got '" + value + "'.");
+		}
+		std::string unit = value.substr(used);
+		for (auto const &[suffix, scale] : units) {
+			if (unit == suffix) {
+				if (x < 0.0f) throw std::runtime_error("'" + name + "' can't be negative.");
+				return x * scale;
+			}
+		}
+		std::string expected;
+		for (auto const &[suffix, scale] : units) expected += (expected.empty() ? "" : ", ") + (suffix.empty() ? std::string("(nothing)") : suffix);
+		throw std::runtime_error("Unknown unit '" + unit + "' for '" + name + "' (expecting " + expected + ").");
+	};
+	std::vector< std::pair< std::string, float > > const time_units{{"s", 1.0f}, {"ms", 0.001f}};
+	std::vector< std::pair< std::string, float > > const probability_units{{"%", 0.01f}, {"", 1.0f}};
+	std::vector< std::pair< std::string, float > > const rate_units{{"", 1.0f}, {"bit", 1.0f / 8.0f}, {"kbit", 1000.0f / 8.0f}, {"mbit", 1000000.0f / 8.0f}};
+
+	std::istringstream in(spec);
+	std::string item;
+	while (std::getline(in, item, ',')) {
+		if (item.empty()) continue;
+		size_t eq = item.find('=');
+		if (eq == std::string::npos) throw std::runtime_error("Expecting name=value, got '" + item + "'.");
+		std::string name = item.substr(0, eq);
+		std::string value = item.substr(eq + 1);
+		if (name == "latency") conditions.latency = number(name, value, time_units);
+		else if (name == "jitter") conditions.jitter = number(name, value, time_units);
+		else if (name == "loss") conditions.loss = number(name, value, probability_units);
+		else if (name == "reorder") conditions.reorder = number(name, value, probability_units);
+		else if (name == "bandwidth") conditions.bandwidth = number(name, value, rate_units);
+		else if (name == "retransmit") conditions.retransmit = number(name, value, time_units);
+		else if (name == "dist") {
+			if (value == "uniform") conditions.distribution = Distribution::Uniform;
+			else if (value == "normal") conditions.distribution = Distribution::Normal;
+			else if (value == "pareto") conditions.distribution = Distribution::Pareto;
+			else throw std::runtime_error("Unknown distribution '" + value + "' (expecting uniform, normal, or pareto).");
+		} else {
+			throw std::runtime_error("Unknown network condition '" + name + "'.");
+		}
+	}
+	if (conditions.loss > 1.0f || conditions.reorder > 1.0f) throw std::runtime_error("Probabilities can't be over 100%.");
+	return conditions;
+}
+
+std::string NetConditions::to_string() const {
+	std::ostringstream out;
+	char const *sep = "";
+	if (latency > 0.0f) { out << sep << "latency=" << latency * 1000.0f << "ms"; sep = ","; }
+	if (jitter > 0.0f) {
+		out << sep << "jitter=" << jitter * 1000.0f << "ms"; sep = ",";
+		if (distribution == Distribution::Normal) out << ",dist=normal";
+		if (distribution == Distribution::Pareto) out << ",dist=pareto";
+	}
+	if (loss > 0.0f) { out << sep << "loss=" << loss * 100.0f << "%"; sep = ","; }
+	if (reorder > 0.0f) { out << sep << "reorder=" << reorder * 100.0f << "%"; sep = ","; }
+	if (bandwidth > 0.0f) { out << sep << "bandwidth=" << bandwidth * 8.0f / 1000.0f << "kbit"; sep = ","; }
+	if (retransmit != NetConditions().retransmit) { out << sep << "retransmit=" << retransmit * 1000.0f << "ms"; sep = ","; }
+	if (*sep == '\0') out << "none";
+	return out.str();
+}
+
+//---------------------------------
+
+NetPipe::NetPipe(NetConditions const &conditions_, bool stream_, uint32_t seed) : conditions(conditions_), stream(stream_), mt(seed) {
+}
+
+void NetPipe::push(double now, uint8_t const *data, size_t size) {
+	stats.packets += 1;
+	stats.bytes += size;
+
+	//waits for the link to finish sending earlier packets, then takes its own time to go out:
+	double sent = now;
+	if (conditions.bandwidth > 0.0f) {
+		sent = std::max(now, link_free) + size / double(conditions.bandwidth);
+		link_free = sent;
+	}
+
+	double arrival = sent + conditions.latency + extra_delay();
+
+	if (stream) {
+		//each 1448-byte segment may be lost; if any is, the chunk waits for its retransmission:
+		if (conditions.loss > 0.0f) {
+			double segments = std::ceil(size / 1448.0);
+			if (uniform() < 1.0 - std::pow(1.0 - conditions.loss, segments)) {
+				stats.lost += 1;
+				arrival += conditions.retransmit;
+			}
+		}
+		//...and nothing overtakes anything:
+		arrival = std::max(arrival, last_arrival);
+		last_arrival = arrival;
+	} else {
+		if (conditions.loss > 0.0f && uniform() < conditions.loss) {
+			stats.lost += 1;
+			return;
+		}
+		if (conditions.reorder > 0.0f && uniform() < conditions.reorder) {
+			stats.reordered += 1;
+			arrival -= conditions.latency;
+		}
+	}
+
+	stats.delay += arrival - now;
+	stats.max_delay = std::max(stats.max_delay, arrival - now);
+	packets.emplace_back(Packet{arrival, std::vector< uint8_t >(data, data + size)});
+	queued_bytes += size;
+}
+
+bool NetPipe::pop(double now, std::vector< uint8_t > *data) {
+	auto next = packets.end();
+	for (auto p = packets.begin(); p != packets.end(); ++p) {
+		if (p->arrival <= now && (next == packets.end() || p->arrival < next->arrival)) next = p;
+		if (stream) break; //(streams arrive in the order pushed)
+	}
+	if (next == packets.end()) return false;
+	queued_bytes -= next->data.size();
+	data->swap(next->data);
+	packets.erase(next);
+	return true;
+}
+
+double NetPipe::next_arrival() const {
+	double next = std::numeric_limits< double >::infinity();
+	for (auto const &p : packets) next = std::min(next, p.arrival);
+	return next;
+}
+
+double NetPipe::clock() {
+	return std::chrono::duration< double >(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+float NetPipe::uniform() {
+	return std::uniform_real_distribution< float >(0.0f, 1.0f)(mt);
+}
+
+float NetPipe::extra_delay() {
+	if (conditions.jitter <= 0.0f) return 0.0f;
+	switch (conditions.distribution) {
+		case NetConditions::Distribution::Uniform:
+			return conditions.jitter * uniform();
+		case NetConditions::Distribution::Normal:
+			return std::abs(std::normal_distribution< float >(0.0f, conditions.jitter)(mt));
+		case NetConditions::Distribution::Pareto: {
+			//Lomax (Pareto type II) with shape 3, scaled so the mean is 'jitter':
+			constexpr float Shape = 3.0f;
+			float scale = conditions.jitter * (Shape - 1.0f);
+			return scale * (std::pow(1.0f - uniform(), -1.0f / Shape) - 1.0f);
+		}
+	}
+	return 0.0f;
+}
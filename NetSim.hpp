@@ -0,0 +1,99 @@
+#pragma once
+
+/*
+ * NetSim models a network path, so latency, jitter, loss, reordering, and
+ * limited bandwidth can be tried out on loopback (or in a benchmark, with no
+ * sockets at all).
+ *
+ * A NetPipe is one direction of a path: packets go in with push() and come
+ * back out of pop() once they have "arrived". Time is in seconds on whatever
+ * clock the caller likes -- NetPipe::clock() for real sockets, or a simulated
+ * clock in a benchmark -- so runs with a fixed seed are repeatable.
+ *
+ * Datagram pipes lose and reorder packets outright. Stream pipes (TCP) can't:
+ * a chunk that "loses" a segment instead arrives 'retransmit' seconds late,
+ * holding up everything behind it, as TCP's in-order delivery would.
+ *
+ * Connection and DatagramSocket run their traffic through a pair of pipes
+ * when given a NetPath (see Connection::netsim, DatagramSocket::simulate()).
+ *
+ * Conditions are usually written as a spec string, e.g.:
+ *   NetConditions::parse("latency=40ms,jitter=10ms,dist=pareto,loss=1%,bandwidth=2mbit")
+ */
+
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+//conditions for one direction of a path:
+struct NetConditions {
+	float latency = 0.0f; //seconds every packet takes
+	float jitter = 0.0f; //seconds; size of the random extra delay (see Distribution)
+	enum class Distribution : uint8_t {
+		Uniform, //extra delay uniform in [0, jitter)
+		Normal, //extra delay |normal| with standard deviation 'jitter'
+		Pareto, //heavy-tailed extra delay with mean 'jitter' (mostly small, now and then very large)
+	} distribution = Distribution::Uniform;
+	float loss = 0.0f; //probability that a packet is lost (streams: per 1448-byte segment)
+	float reorder = 0.0f; //(datagrams) probability that a packet skips 'latency', overtaking those sent before it
+	float bandwidth = 0.0f; //bytes per second; packets queue up behind each other (0 => unlimited)
+	float retransmit = 0.2f; //(streams) extra delay of a chunk that lost a segment (~TCP's minimum retransmission timeout)
+
+	bool active() const { return latency > 0.0f || jitter > 0.0f || loss > 0.0f || reorder > 0.0f || bandwidth > 0.0f; }
+
+	//comma-separated name=value pairs (as printed by to_string()); times take 's' or 'ms', probabilities '%',
+	// and bandwidth 'bit', 'kbit', 'mbit' (per second) or plain bytes per second; throws on anything else:
+	static NetConditions parse(std::string const &spec);
+	std::string to_string() const;
+};
+
+//conditions for both directions of a path, as seen from one end:
+struct NetPath {
+	NetConditions outgoing, incoming;
+	bool active() const { return outgoing.active() || incoming.active(); }
+};
+
+//one direction of a path:
+struct NetPipe {
+	NetPipe(NetConditions const &conditions = NetConditions(), bool stream = false, uint32_t seed = std::random_device{}());
+
+	NetConditions conditions;
+	bool stream; //bytes arrive in order, and nothing is lost outright
+
+	//a packet (or, for streams, a chunk of bytes) enters the pipe at time 'now':
+	void push(double now, uint8_t const *data, size_t size);
+	//the next packet that has arrived by 'now' (earliest first), if any:
+	bool pop(double now, std::vector< uint8_t > *data);
+
+	bool empty() const { return packets.empty(); }
+	size_t queued() const { return queued_bytes; } //bytes in flight (pushed, not yet popped or lost)
+	double next_arrival() const; //(infinity if empty)
+
+	//a clock for pipes carrying real traffic (seconds, steady):
+	static double clock();
+
+	struct Stats {
+		uint64_t packets = 0, bytes = 0; //pushed
+		uint64_t lost = 0; //dropped (datagrams) or retransmitted (streams)
+		uint64_t reordered = 0; //(datagrams) skipped the queue
+		double delay = 0.0; //total seconds between push and arrival, over packets not dropped
+		double max_delay = 0.0;
+	} stats;
+
+private:
+	struct Packet {
+		double arrival;
+		std::vector< uint8_t > data;
+	};
+	std::vector< Packet > packets; //in flight, in the order pushed
+	size_t queued_bytes = 0; //over 'packets'
+
+	double link_free = -std::numeric_limits< double >::infinity(); //(bandwidth) when the last packet finishes going out
+	double last_arrival = -std::numeric_limits< double >::infinity(); //(streams) nothing may arrive before this
+
+	std::mt19937 mt;
+	float uniform(); //[0,1)
+	float extra_delay();
+};
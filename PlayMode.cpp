@@ -5,9 +5,11 @@
 #include "LitColorTextureProgram.hpp"
 
 #include "DrawLines.hpp"
+#include "GpuTimer.hpp"
 #include "gl_errors.hpp"
 #include "data_path.hpp"
 #include "hex_dump.hpp"
+#include "Profiler.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
 #define GLM_ENABLE_EXPERIMENTAL
@@ -112,6 +114,7 @@ Load<Scene> room_scene(LoadTagDefault, []() -> Scene const *
         dr.pipeline.type  = mesh.type;
         dr.pipeline.start = mesh.start;
         dr.pipeline.count = mesh.count;
+        dr.group = mesh_name.substr(0, mesh_name.find('.')); //(e.g., "Chair.001" is timed with the other chairs)
 
 	 g_bounds_by_transform_name[transform->name] = { mesh.min, mesh.max };
 	 printf("g_bounds_by_transform_name[%s] = (%.2f,%.2f,%.2f) to (%.2f,%.2f,%.2f)\n",
@@ -130,9 +133,11 @@ static void utf8_pop_back(std::string &s)
 	s.erase(i);
 }
 
-PlayMode::PlayMode(Client &client_, SDL_Window *window_) : client(client_), scene(*room_scene)
+PlayMode::PlayMode(Client &client_, SDL_Window *window_, DatagramChannel *datagrams_) : client(client_), datagrams(datagrams_), scene(*room_scene)
 {
 	sdl_window = window_;
+	if (datagrams)
+		Game::send_datagram_request_message(&client.connection);
 	if (scene.cameras.size() != 1)
 	{
 		throw std::runtime_error("Expecting 1 camera in room.scene, found " + std::to_string(scene.cameras.size()));
@@ -206,8 +211,10 @@ void PlayMode::draw_shaped_text(
 	glm::u8vec4 const &color,
 	glm::mat4 const &world_to_clip)
 {
+	PROFILE_ZONE("PlayMode::draw_shaped_text");
 	if (!hb || !ft || s.empty())
 		return;
+	GPU_SCOPE("text");
 
 	auto run = hb->shape(s);
 	if (run.infos.empty())
@@ -456,8 +463,20 @@ void PlayMode::ensure_text_input_state()
 
 void PlayMode::update(float elapsed)
 {
+	PROFILE_ZONE("PlayMode::update");
+	smoothing.advance(elapsed);
+
 	// queue data for sending to server:
-	controls.send_controls_message(&client.connection);
+	smoothing.record_controls(&controls);
+	if (datagrams && datagrams->ready())
+	{
+		controls.send_controls_message(&datagrams->outbox);
+		datagrams->send_outbox();
+	}
+	else
+	{
+		controls.send_controls_message(&client.connection);
+	}
 
 	// reset button press counters:
 	controls.left.downs = 0;
@@ -475,12 +494,20 @@ void PlayMode::update(float elapsed)
 			std::cout << "[" << c->socket << "] closed (!)" << std::endl;
 			throw std::runtime_error("Lost connection to server!");
 		} else { assert(event == Connection::OnRecv);
-			//std::cout << "[" << c->socket << "] recv'd data. Current buffer:\n" << hex_dump(c->recv_buffer); std::cout.flush(); //DEBUG
+			//std::cout << "[" << c->socket << "] recv'd data. Current buffer:\n" << hex_dump(c->recv_buffer.data(), c->recv_buffer.size()); std::cout.flush(); //DEBUG
 			bool handled_message;
 			try {
 				do {
 					handled_message = false;
-					if (game.recv_state_message(c)) handled_message = true;
+					uint16_t port;
+					uint64_t token;
+					if (game.recv_state_message(c)) {
+						if (game.state_seq != 0) smoothing.record_state(game); //(not if the message was skipped while waiting for a keyframe)
+						handled_message = true;
+					} else if (datagrams && Game::recv_datagram_hello_message(c, &port, &token)) {
+						datagrams->open(*c, port, token);
+						handled_message = true;
+					}
 				} while (handled_message);
 			} catch (std::exception const &e) {
 				std::cerr << "[" << c->socket << "] malformed message from server: " << e.what() << std::endl;
@@ -489,6 +516,33 @@ void PlayMode::update(float elapsed)
 			}
 		} }, 0.0);
 
+	// state that came as datagrams:
+	if (datagrams && datagrams->ready())
+	{
+		while (datagrams->socket->recv(&datagram_buffer))
+		{
+			try
+			{
+				if (game.recv_state_datagram(datagram_buffer.data(), datagram_buffer.size()))
+					smoothing.record_state(game);
+			}
+			catch (std::exception const &e)
+			{
+				// (unlike the connection, a bad datagram doesn't spoil the ones after it)
+				std::cerr << "ignoring malformed datagram from server: " << e.what() << std::endl;
+			}
+		}
+	}
+
+	// if state deltas stopped matching what we have, ask the server to start over with a keyframe:
+	if (game.needs_keyframe)
+	{
+		Game::send_keyframe_request_message(&client.connection);
+		game.needs_keyframe = false;
+	}
+
+	smoothing.update(game);
+
 	if (game.phase == Game::Phase::Communication)
 	{
 		caret_time += elapsed;
@@ -498,6 +552,8 @@ void PlayMode::update(float elapsed)
 
 void PlayMode::draw(glm::uvec2 const &drawable_size)
 {
+	PROFILE_ZONE("PlayMode::draw");
+	GPU_SCOPE("PlayMode::draw");
 	glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT);
 	glDisable(GL_DEPTH_TEST);
@@ -2,7 +2,9 @@
 #include "Scene.hpp"
 
 #include "Connection.hpp"
+#include "Datagram.hpp"
 #include "Game.hpp"
+#include "Smoothing.hpp"
 
 #include "FontFT.hpp"
 #include "TextHB.hpp"
@@ -14,7 +16,7 @@
 
 struct PlayMode : Mode
 {
-	PlayMode(Client &client, SDL_Window *window);
+	PlayMode(Client &client, SDL_Window *window, DatagramChannel *datagrams = nullptr);
 	virtual ~PlayMode();
 
 	// functions called by main loop:
@@ -30,11 +32,17 @@ struct PlayMode : Mode
 	// latest game state (from server):
 	Game game;
 
+	// players as they should be drawn (smoothing.players): others interpolated, local player predicted:
+	Smoothing smoothing;
+
 	// last message from server:
 	std::string server_message;
 
 	// connection to server:
 	Client &client;
+	// (if given) controls and state go through here once the server has set it up:
+	DatagramChannel *datagrams = nullptr;
+	std::vector< uint8_t > datagram_buffer;
 
 	Role my_role = Role::Unknown;
 
@@ -0,0 +1,140 @@
+#include "Profiler.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace Profiler {
+
+std::atomic< bool > enabled{false};
+
+namespace {
+	//(zone fields are atomics, written relaxed, so write() may read a ring while its thread is recording into it)
+	struct Slot {
+		std::atomic< char const * > name{nullptr};
+		std::atomic< uint64_t > begin{0}, end{0};
+	};
+
+	struct Ring {
+		std::array< Slot, Capacity > slots;
+		std::atomic< uint64_t > count{0}; //zones recorded (slots[i % Capacity] holds zone i)
+		std::atomic< uint64_t > cleared{0}; //zones before this were discarded by clear()
+		std::atomic< char const * > thread_name{nullptr};
+		uint32_t thread_id = 0;
+	};
+
+	//every thread's ring (kept after its thread exits, so its zones can still be written):
+	std::mutex rings_mutex;
+	std::vector< std::unique_ptr< Ring > > rings;
+
+	thread_local Ring *ring = nullptr;
+	thread_local char const *thread_name = nullptr; //(set before the ring exists)
+
+	Ring &thread_ring() {
+		if (!ring) {
+			std::lock_guard< std::mutex > lock(rings_mutex);
+			rings.emplace_back(std::make_unique< Ring >());
+			ring = rings.back().get();
+			ring->thread_id = uint32_t(rings.size());
+			ring->thread_name = thread_name;
+		}
+		return *ring;
+	}
+
+	std::chrono::steady_clock::time_point const start = std::chrono::steady_clock::now();
+
+	//JSON string contents:
+	std::string escape(char const *text) {
+		std::string out;
+		for (char const *c = text; *c; ++c) {
+			if (*c == '"' || *c == '\\') out += '\\';
+			if (uint8_t(*c) < 0x20) continue;
+			out += *c;
+		}
+		return out;
+	}
+}
+
+uint64_t now() {
+	//(+1 so that no zone starts at 0, which Zone uses to mean "not recording")
+	return uint64_t(std::chrono::duration_cast< std::chrono::nanoseconds >(std::chrono::steady_clock::now() - start).count()) + 1;
+}
+
+void record(char const *name, uint64_t begin, uint64_t end) {
+	Ring &r = thread_ring();
+	uint64_t index = r.count.load(std::memory_order_relaxed);
+	Slot &slot = r.slots[index % Capacity];
+	slot.name.store(name, std::memory_order_relaxed);
+	slot.begin.store(begin, std::memory_order_relaxed);
+	slot.end.store(end, std::memory_order_relaxed);
+	r.count.store(index + 1, std::memory_order_release);
+}
+
+void set_thread_name(char const *name) {
+	thread_name = name;
+	if (ring) ring->thread_name = name;
+}
+
+uint64_t write(std::string const &path) {
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	if (!out) throw std::runtime_error("Failed to open '" + path + "' to write a trace.");
+	out << std::fixed << std::setprecision(3);
+
+	struct Event {
+		char const *name;
+		uint64_t begin, end;
+	};
+	std::vector< Event > events;
+	uint64_t written = 0;
+
+	out << "{\"traceEvents\":[\n";
+	out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"client\"}}";
+
+	std::lock_guard< std::mutex > lock(rings_mutex);
+	for (auto const &r : rings) {
+		char const *name = r->thread_name.load(std::memory_order_relaxed);
+		out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << r->thread_id
+			<< ",\"args\":{\"name\":\"" << (name ? escape(name) : "thread " + std::to_string(r->thread_id)) << "\"}}";
+
+		//copy out the zones still in the ring...
+		uint64_t count = r->count.load(std::memory_order_acquire);
+		uint64_t first = std::max({count > Capacity ? count - Capacity : 0, r->cleared.load(std::memory_order_relaxed)});
+		events.clear();
+		for (uint64_t i = first; i < count; ++i) {
+			Slot const &slot = r->slots[i % Capacity];
+			events.emplace_back(Event{slot.name.load(std::memory_order_relaxed), slot.begin.load(std::memory_order_relaxed), slot.end.load(std::memory_order_relaxed)});
+		}
+		//...less any its thread may have overwritten while they were being copied:
+		// (zone i's slot is reused by zone i + Capacity, which may be partway written once 'count' reaches i + Capacity)
+		uint64_t after = r->count.load(std::memory_order_acquire);
+		if (after + 1 > first + Capacity) {
+			events.erase(events.begin(), events.begin() + size_t(std::min< uint64_t >(events.size(), after + 1 - Capacity - first)));
+		}
+
+		for (auto const &e : events) {
+			if (!e.name) continue;
+			//(complete events; times in microseconds)
+			out << ",\n{\"name\":\"" << escape(e.name) << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << r->thread_id
+				<< ",\"ts\":" << e.begin / 1000.0 << ",\"dur\":" << (e.end - e.begin) / 1000.0 << "}";
+			written += 1;
+		}
+	}
+	out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+	if (!out) throw std::runtime_error("Failed to write trace to '" + path + "'.");
+	return written;
+}
+
+void clear() {
+	std::lock_guard< std::mutex > lock(rings_mutex);
+	for (auto const &r : rings) {
+		r->cleared.store(r->count.load(std::memory_order_acquire), std::memory_order_relaxed);
+	}
+}
+
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+/*
+ * Profiler times named "zones" (scopes marked with PROFILE_ZONE) on every
+ * thread, and writes them out as a Chrome trace -- JSON that chrome://tracing
+ * or https://ui.perfetto.dev show as a timeline, one row per thread, with
+ * nested zones stacked -- so, e.g., a slow frame can be pinned on networking,
+ * text shaping, or drawing.
+ *
+ * Each thread records into its own fixed-size ring of zones (once it is full,
+ * the oldest are overwritten), so recording a zone takes two clock reads and
+ * a few stores, with no locks. write() gathers every thread's ring.
+ *
+ * Zones are only recorded while Profiler::enabled is set; otherwise a zone
+ * costs a relaxed load and a branch. (Define PROFILER_DISABLED to compile
+ * zones out entirely.)
+ *
+ * Usage:
+ *   void PlayMode::draw(glm::uvec2 const &drawable_size) {
+ *     PROFILE_ZONE("PlayMode::draw"); //(the name must outlive the profiler; e.g., a string literal)
+ *     ...
+ *   }
+ *   Profiler::set_thread_name("audio"); //(optional; labels the calling thread's row)
+ *   Profiler::enabled = true;
+ *   ...
+ *   Profiler::write("profile.json");
+ */
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace Profiler {
+
+//record zones?
+extern std::atomic< bool > enabled;
+
+//zones kept per thread:
+inline constexpr uint32_t Capacity = 1u << 16;
+
+//nanoseconds since the profiler's clock started (steady):
+uint64_t now();
+
+//add a finished zone to the calling thread's ring:
+void record(char const *name, uint64_t begin, uint64_t end);
+
+//label the calling thread in traces (the name must outlive the profiler):
+void set_thread_name(char const *name);
+
+//write every thread's zones to a Chrome trace file (returns the number of zones written; throws if the file can't be written):
+// (zones being recorded while this runs may be left out)
+uint64_t write(std::string const &path);
+
+//forget every zone recorded so far:
+void clear();
+
+//times the scope it lives in:
+struct Zone {
+	Zone(char const *name_) : name(name_), begin(enabled.load(std::memory_order_relaxed) ? now() : 0) { }
+	~Zone() {
+		if (begin) record(name, begin, now());
+	}
+	Zone(Zone const &) = delete;
+	Zone &operator=(Zone const &) = delete;
+
+	char const *name;
+	uint64_t begin; //(0 => profiler was disabled)
+};
+
+}
+
+#define PROFILER_CONCAT2(A, B) A##B
+#define PROFILER_CONCAT(A, B) PROFILER_CONCAT2(A, B)
+
+#ifdef PROFILER_DISABLED
+#define PROFILE_ZONE(NAME) do { } while (false)
+#else
+#define PROFILE_ZONE(NAME) Profiler::Zone PROFILER_CONCAT(profile_zone_, __LINE__)(NAME)
+#endif
@@ -0,0 +1,58 @@
+#include "Rooms.hpp"
+
+#include <cassert>
+
+Rooms::Place Rooms::join() {
+	Place place;
+
+	//seat the player with whoever has been waiting longest:
+	while (!waiting.empty()) {
+		Room *room = rooms.get(waiting.front());
+		if (room && room->game.players.size() < Seats) {
+			place.room = waiting.front();
+			place.player = room->game.spawn_player();
+			if (room->game.players.size() >= Seats) waiting.pop_front();
+			return place;
+		}
+		waiting.pop_front(); //(closed or already full)
+	}
+
+	//nobody waiting; open a new room:
+	Room room;
+	room.id = next_room_id++;
+	place.room = rooms.insert(std::move(room));
+	place.player = rooms.get(place.room)->game.spawn_player();
+	if (Seats > 1) waiting.emplace_back(place.room);
+	return place;
+}
+
+void Rooms::leave(Place const &place) {
+	Room *room = rooms.get(place.room);
+	assert(room);
+	bool was_full = (room->game.players.size() >= Seats);
+	room->game.remove_player(place.player);
+
+	if (room->game.players.empty()) {
+		rooms.erase(place.room);
+		return;
+	}
+
+	//the match can't go on without them; start over and wait for someone new:
+	room->game.reset_lobby();
+	if (was_full) waiting.emplace_back(place.room);
+}
+
+void Rooms::update(float elapsed) {
+	for (auto &room : rooms.values) {
+		room.game.update(elapsed);
+	}
+}
+
+uint32_t Rooms::open_seats() const {
+	uint32_t seats = 0;
+	for (RoomHandle handle : waiting) {
+		Room const *room = rooms.get(handle);
+		if (room && room->game.players.size() < Seats) seats += Seats - room->game.players.size();
+	}
+	return seats;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+/*
+ * Rooms runs many independent Games in one server, one per Communicator/Operative
+ * pair, each with its own phase and role state.
+ *
+ * Matchmaking is first-come, first-served: join() seats a new player in the room
+ * that has been waiting longest for a partner, or opens a new room if none is.
+ * When one of a pair leaves, their room goes back to an empty lobby and waits for
+ * a new partner; when a room's last player leaves, the room is closed.
+ *
+ * Usage (server):
+ *   Rooms::Place place = rooms.join(); //on connect
+ *   rooms.get(place.room)->game ...    //handle that player's messages
+ *   rooms.update(Game::Tick);          //once per tick: update every room
+ *   rooms.leave(place);                //on disconnect
+ */
+
+#include "Game.hpp"
+#include "SlotMap.hpp"
+
+#include <deque>
+#include <cstdint>
+
+using RoomHandle = SlotHandle;
+
+struct Room {
+	Game game;
+	Game::StateBroadcast broadcast; //this tick's state, encoded once for all of the room's players
+	uint32_t id = 0; //unique within a server (for log messages)
+};
+
+struct Rooms {
+	//players per room:
+	inline static constexpr uint32_t Seats = 2;
+
+	//where a joined player is:
+	struct Place {
+		RoomHandle room;
+		PlayerHandle player;
+	};
+
+	Place join();
+	void leave(Place const &place);
+
+	//nullptr if the room has been closed:
+	Room *get(RoomHandle room) { return rooms.get(room); }
+	Room const *get(RoomHandle room) const { return rooms.get(room); }
+
+	//update every room's game:
+	void update(float elapsed);
+
+	//empty seats in rooms waiting for a partner:
+	uint32_t open_seats() const;
+
+	SlotMap< Room > rooms; //open rooms (dense, so update() walks them in order)
+	std::deque< RoomHandle > waiting; //rooms with an empty seat, longest-waiting first (may hold handles of rooms since filled or closed)
+	uint32_t next_room_id = 1;
+};
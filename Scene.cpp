@@ -1,6 +1,8 @@
 #include "Scene.hpp"
 
+#include "GpuTimer.hpp"
 #include "gl_errors.hpp"
+#include "Profiler.hpp"
 #include "read_write_chunk.hpp"
 
 #include <glm/gtc/type_ptr.hpp>
@@ -56,19 +58,61 @@ glm::mat4x3 Scene::Transform::make_local_from_parent() const {
 	);
 }
 
-glm::mat4x3 Scene::Transform::make_world_from_local() const {
-	if (!parent) {
-		return make_parent_from_local();
-	} else {
-		return parent->make_world_from_local() * glm::mat4(make_parent_from_local()); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+void Scene::Transform::update_cache() const {
+	if (resolve_pass != 0 && cache.checked == resolve_pass) return; //(already checked in this Resolve pass)
+
+	//recompute the local matrix only if position/rotation/scale changed:
+	bool local_changed = (cache.version == 0 || position != cache.position || rotation != cache.rotation || scale != cache.scale);
+	if (local_changed) {
+		cache.position = position;
+		cache.rotation = rotation;
+		cache.scale = scale;
+		cache.parent_from_local = make_parent_from_local();
 	}
+
+	//...and the world matrix only if that or the parent's world matrix changed:
+	uint64_t parent_version = 0;
+	if (parent) {
+		parent->update_cache();
+		parent_version = parent->cache.version;
+	}
+	if (local_changed || parent != cache.parent || parent_version != cache.parent_version) {
+		if (!parent) {
+			cache.world_from_local = cache.parent_from_local;
+		} else {
+			cache.world_from_local = parent->cache.world_from_local * glm::mat4(cache.parent_from_local); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+		}
+		cache.parent = parent;
+		cache.parent_version = parent_version;
+		cache.version = ++versions;
+	}
+
+	cache.checked = resolve_pass;
+}
+
+glm::mat4x3 Scene::Transform::make_world_from_local() const {
+	update_cache();
+	return cache.world_from_local;
 }
 glm::mat4x3 Scene::Transform::make_local_from_world() const {
-	if (!parent) {
-		return make_local_from_parent();
-	} else {
-		return make_local_from_parent() * glm::mat4(parent->make_local_from_world()); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+	update_cache();
+	if (cache.local_from_world_version != cache.version) {
+		if (!parent) {
+			cache.local_from_world = make_local_from_parent();
+		} else {
+			cache.local_from_world = make_local_from_parent() * glm::mat4(parent->make_local_from_world()); //note: glm::mat4(glm::mat4x3) pads with a (0,0,0,1) row
+		}
+		cache.local_from_world_version = cache.version;
 	}
+	return cache.local_from_world;
+}
+
+Scene::Transform::Resolve::Resolve() : outer(resolve_pass) {
+	//(nested Resolves share the outer pass)
+	if (!outer) resolve_pass = ++resolve_passes;
+}
+Scene::Transform::Resolve::~Resolve() {
+	resolve_pass = outer;
 }
 
 //-------------------------
@@ -88,6 +132,10 @@ void Scene::draw(Camera const &camera) const {
 }
 
 void Scene::draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from_world) const {
+	PROFILE_ZONE("Scene::draw");
+	Transform::Resolve resolve; //(each transform's world matrix is checked once, however many drawables share it as an ancestor)
+	GPU_SCOPE("Scene::draw");
+	std::string const *gpu_group = nullptr; //drawable group being timed, if any
 
 	//Iterate through all drawables, sending each one to OpenGL:
 	for (auto const &drawable : drawables) {
@@ -101,6 +149,12 @@ void Scene::draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from
 		//skip any drawables that don't contain any vertices:
 		if (pipeline.count == 0) continue;
 
+		//time each run of drawables in a group as its own scope:
+		if (GpuTimer::enabled && (gpu_group ? *gpu_group != drawable.group : !drawable.group.empty())) {
+			if (gpu_group) GpuTimer::pop();
+			gpu_group = (drawable.group.empty() ? nullptr : &drawable.group);
+			if (gpu_group) GpuTimer::push(*gpu_group);
+		}
 
 		//Set shader program:
 		glUseProgram(pipeline.program);
@@ -158,6 +212,7 @@ void Scene::draw(glm::mat4 const &clip_from_world, glm::mat4x3 const &light_from
 		glActiveTexture(GL_TEXTURE0);
 
 	}
+	if (gpu_group) GpuTimer::pop();
 
 	glUseProgram(0);
 	glBindVertexArray(0);
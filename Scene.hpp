@@ -15,6 +15,7 @@
 #include <glm/glm.hpp>
 #include <glm/gtc/quaternion.hpp>
 
+#include <cstdint>
 #include <list>
 #include <memory>
 #include <functional>
@@ -40,9 +41,47 @@ struct Scene {
 		glm::mat4x3 make_parent_from_local() const;
 		glm::mat4x3 make_local_from_parent() const;
 		// ..relative to the world:
+		// (cached; only recomputed once this transform or one of its ancestors has changed)
 		glm::mat4x3 make_world_from_local() const;
 		glm::mat4x3 make_local_from_world() const;
 
+		//The world matrices above, and what they were computed from:
+		// (position/rotation/scale/parent are compared with the values they were computed from,
+		//  so code can keep assigning them directly; a change shows up on the next make_*_from_*() call)
+		struct Cache {
+			glm::vec3 position = glm::vec3(0.0f);
+			glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+			glm::vec3 scale = glm::vec3(1.0f);
+			Transform const *parent = nullptr;
+			uint64_t parent_version = 0; //parent's 'version' when world_from_local was computed
+
+			glm::mat4x3 parent_from_local = glm::mat4x3(1.0f);
+			glm::mat4x3 world_from_local = glm::mat4x3(1.0f);
+			uint64_t version = 0; //changes whenever world_from_local does (0 => nothing computed yet)
+			uint64_t checked = 0; //Resolve pass in which the above was last brought up to date
+
+			glm::mat4x3 local_from_world = glm::mat4x3(1.0f);
+			uint64_t local_from_world_version = 0; //'version' that local_from_world was computed for
+		};
+		mutable Cache cache;
+		//bring cache.world_from_local up to date (after its parent's):
+		void update_cache() const;
+
+		//While a Resolve is alive, each transform is only checked for changes once, so
+		// finding the matrices of every transform in a deep hierarchy visits each ancestor once
+		// (in parent-before-child order), rather than once per descendant. (e.g., Scene::draw)
+		//Don't change transforms while one is alive -- changes won't be noticed until it ends.
+		struct Resolve {
+			Resolve();
+			~Resolve();
+			Resolve(Resolve const &) = delete;
+			Resolve &operator=(Resolve const &) = delete;
+			uint64_t outer; //(pass of the enclosing Resolve, if nested)
+		};
+		inline static uint64_t resolve_pass = 0; //current Resolve pass (0 => none alive)
+		inline static uint64_t resolve_passes = 0;
+		inline static uint64_t versions = 0; //(so cache versions are unique across transforms)
+
 		//since hierarchy is tracked through pointers, copy-constructing a transform  is not advised:
 		Transform(Transform const &) = delete;
 		//if we delete some constructors, we need to let the compiler know that the default constructor is still okay:
@@ -79,6 +118,10 @@ struct Scene {
 				GLenum target = GL_TEXTURE_2D;
 			} textures[TextureCount];
 		} pipeline;
+
+		//(optional) name to count this drawable's GPU time under in Scene::draw's GpuTimer report (e.g., "Chair"):
+		// (consecutive drawables in the same group share one scope, so keep groups together in 'drawables')
+		std::string group;
 	};
 
 	struct Camera {
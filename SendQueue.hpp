@@ -0,0 +1,119 @@
+#pragma once
+
+/*
+ * SendQueue is a FIFO of bytes waiting to be sent, used for Connection's send
+ * buffer.
+ *
+ * It is a list of segments: bytes appended with append() are copied into a
+ * segment the queue owns (consecutive appends share one), while append_shared()
+ * just keeps a reference to an immutable, reference-counted buffer -- so, e.g.,
+ * one encoded broadcast can sit in many connections' queues without being
+ * copied into each. The segments are handed to the OS all at once (see
+ * send_connection() in Connection.cpp, which uses sendmsg()).
+ *
+ * Unlike ByteQueue, the unsent bytes are not contiguous; use bytes() to get a
+ * copy of them in one piece (e.g., to feed a parser in a benchmark).
+ */
+
+#include <algorithm>
+#include <deque>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+
+struct SendQueue {
+	struct Segment {
+		std::shared_ptr< std::vector< uint8_t > const > shared; //if set, the bytes are here (and aren't ours to change)
+		std::vector< uint8_t > owned; //otherwise, they're here
+		size_t sent = 0; //bytes at the start of the segment already sent
+
+		uint8_t const *data() const { return (shared ? shared->data() : owned.data()) + sent; }
+		size_t size() const { return (shared ? shared->size() : owned.size()) - sent; }
+	};
+	std::deque< Segment > segments; //unsent bytes, front first
+
+	size_t size() const { return total; }
+	bool empty() const { return total == 0; }
+
+	//copy bytes onto the back of the queue:
+	void append(void const *bytes, size_t count) {
+		if (count == 0) return;
+		if (segments.empty() || segments.back().shared) {
+			segments.emplace_back();
+			segments.back().owned.swap(spare); //(reuse an old segment's allocation)
+		}
+		uint8_t const *src = reinterpret_cast< uint8_t const * >(bytes);
+		segments.back().owned.insert(segments.back().owned.end(), src, src + count);
+		total += count;
+	}
+
+	//reference bytes from the back of the queue, without copying them:
+	// (they must not change until sent, hence 'const')
+	void append_shared(std::shared_ptr< std::vector< uint8_t > const > const &bytes) {
+		if (!bytes || bytes->empty()) return;
+		segments.emplace_back();
+		segments.back().shared = bytes;
+		total += bytes->size();
+	}
+
+	//byte 'i' from the front; only bytes added with append() may be changed:
+	// (searches from the back, since this is generally used to patch a message that is being written)
+	uint8_t const &operator[](size_t i) const { return const_cast< SendQueue & >(*this).at(i, false); }
+	uint8_t &operator[](size_t i) { return at(i, true); }
+
+	//discard (sent) bytes from the front of the queue:
+	void pop_front(size_t count) {
+		assert(count <= total);
+		total -= count;
+		while (count > 0) {
+			Segment &front = segments.front();
+			size_t n = std::min(count, front.size());
+			front.sent += n;
+			count -= n;
+			if (front.size() == 0) pop_segment();
+		}
+	}
+
+	void clear() {
+		while (!segments.empty()) pop_segment();
+		total = 0;
+	}
+
+	//all unsent bytes, copied into one contiguous buffer:
+	std::vector< uint8_t > bytes() const {
+		std::vector< uint8_t > out;
+		out.reserve(total);
+		for (auto const &segment : segments) out.insert(out.end(), segment.data(), segment.data() + segment.size());
+		return out;
+	}
+
+private:
+	uint8_t &at(size_t i, bool writing) {
+		assert(i < total);
+		size_t start = total;
+		for (auto segment = segments.rbegin(); segment != segments.rend(); ++segment) {
+			start -= segment->size();
+			if (i >= start) {
+				assert(!(writing && segment->shared) && "shared bytes can't be changed");
+				(void)writing;
+				return const_cast< uint8_t & >(segment->data()[i - start]);
+			}
+		}
+		assert(false && "index out of range");
+		return const_cast< uint8_t & >(segments.front().data()[0]);
+	}
+
+	void pop_segment() {
+		Segment &front = segments.front();
+		if (!front.shared && front.owned.capacity() > spare.capacity()) {
+			front.owned.clear();
+			spare.swap(front.owned);
+		}
+		segments.pop_front();
+	}
+
+	size_t total = 0; //unsent bytes, over all segments
+	std::vector< uint8_t > spare; //an emptied owned segment, kept for its allocation
+};
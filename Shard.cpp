@@ -0,0 +1,719 @@
+#include "Shard.hpp"
+
+#include "hex_dump.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+// a controls message as it arrives in a datagram (after the token) or is kept in a capture:
+static constexpr size_t ControlsDatagramSize = Schema::HeaderSize + Messages::Controls::MinSize;
+
+Shard::Shard(uint32_t index_, PollBackend backend, TickScheduler::Mode mode) : index(index_), server(backend), scheduler(Game::Tick, mode)
+{
+	//------------ connection events ------------
+
+	on_event = [this](Connection *c, Connection::Event evt)
+	{
+		if (evt == Connection::OnOpen)
+		{
+			// client connected:
+
+			// find them a room and create some player info for them:
+			Client client;
+			client.connection = c;
+			client.place = rooms.join();
+			c->tag = clients.insert(std::move(client)).pack();
+			if (capture)
+				capture->write(scheduler.tick + 1, Capture::Event::Open, c->tag);
+			publish_counts();
+		}
+		else if (evt == Connection::OnClose)
+		{
+			// client disconnected:
+			remove_connection(c);
+		}
+		else
+		{
+			assert(evt == Connection::OnRecv);
+			// got data from client:
+			//std::cout << "current buffer:\n" << hex_dump(c->recv_buffer.data(), c->recv_buffer.size()); std::cout.flush(); //DEBUG
+
+			// handle messages from client:
+			try
+			{
+				dispatcher.dispatch(c);
+			}
+			catch (std::exception const &e)
+			{
+				Log::info("Disconnecting client: %s", e.what());
+				c->close();
+				remove_connection(c);
+			}
+		}
+	};
+
+	//------------ message handlers ------------
+
+	dispatcher.on(Message::C2S_Controls, Messages::Controls::MinSize, Messages::Controls::MaxSize, [this](Connection *c, uint8_t const *payload, uint32_t size)
+				  {
+		Client &client = client_for(c);
+		game_for(client).players.controls[player_for(client)].recv_controls_payload(payload, size); });
+
+	dispatcher.on(Message::C2S_KeyframeRequest, Messages::KeyframeRequest::MinSize, Messages::KeyframeRequest::MaxSize, [this](Connection *c, uint8_t const *, uint32_t)
+				  {
+		Client &client = client_for(c);
+		if (client.datagram_address)
+			return; // (its state comes as datagrams, which are all keyframes)
+		// client lost track of deltas; forget its baseline so the next state is a keyframe:
+		client.baseline = Game::StateBaseline();
+	});
+
+	dispatcher.on(Message::C2S_DatagramRequest, Messages::DatagramRequest::MinSize, Messages::DatagramRequest::MaxSize, [this](Connection *c, uint8_t const *, uint32_t)
+				  {
+		Client &client = client_for(c);
+		if (!datagrams || client.datagram_token != 0)
+			return; // (no datagrams here -- it will keep using the connection -- or it asked already)
+		uint64_t token;
+		do
+		{
+			token = token_mt();
+		} while (token == 0 || datagram_clients.count(token));
+		client.datagram_token = token;
+		datagram_clients.emplace(token, SlotHandle::unpack(c->tag));
+		Game::send_datagram_hello_message(c, datagrams->port(), token);
+	});
+
+	dispatcher.on(Message::C2S_SelectedRole, Messages::SelectedRole::MinSize, Messages::SelectedRole::MaxSize, [this](Connection *c, uint8_t const *payload, uint32_t size)
+				  {
+		uint8_t selected;
+		Game::recv_selected_role_payload(payload, size, &selected);
+
+		// who sent this?
+		Client &client = client_for(c);
+		Game &game = game_for(client);
+		int idx = game.seat_of(client.place.player);
+		if (idx == 0)
+			return; // (not one of the pair)
+
+		if (idx == 1)
+			game.selected_role_1 = selected;
+		else
+			game.selected_role_2 = selected;
+
+		// NOTE: per your spec, we do NOT touch role_1/role_2 here.
+		// Conflict resolution stays in the login (Enter) path.
+	});
+
+	// Credit: helped by ChatGPT
+	dispatcher.on(Message::C2S_Login, Messages::Login::MinSize, Messages::Login::MaxSize, [this](Connection *c, uint8_t const *payload, uint32_t size)
+				  {
+		Role chosen;
+		Game::recv_login_payload(payload, size, &chosen);
+
+		Client &client = client_for(c);
+		Game &game = game_for(client);
+		game.players.role[player_for(client)] = chosen;
+		// Check role selection logic
+
+		int cur_player_idx = game.seat_of(client.place.player);
+		if (cur_player_idx == 0)
+			return; // (not one of the pair)
+
+		auto set_selected_opposite = [](uint8_t &selected, Role chosen)
+		{
+			// chosen: 1=Communicator -> other should *select* Operative (1)
+			//         2=Operative    -> other should *select* Communicator (0)
+			selected = (chosen == Role::Communicator ? 1 : 0);
+			Log::info("chosen: %d, other player forced to select %s", uint8_t(chosen), (selected == 0 ? "Communicator" : "Operative"));
+		};
+
+		// write role_1/role_2 from the chosen enum value:
+		uint8_t my_selected_role = (chosen == Role::Communicator ? 0 : 1);
+		if (cur_player_idx == 1)
+		{
+			game.role_1 = uint8_t(chosen);
+			game.selected_role_1 = my_selected_role;
+		}
+		else
+		{
+			game.role_2 = uint8_t(chosen);
+			game.selected_role_2 = my_selected_role;
+		}
+
+		// figure out the other side:
+		uint8_t &other_role = (cur_player_idx == 1 ? game.role_2 : game.role_1);
+		uint8_t &other_selected = (cur_player_idx == 1 ? game.selected_role_2 : game.selected_role_1);
+		// printf("\nother_role = %d, other_selected = %d, chosen = %d, other_role == uint8_t(chosen)? %d\n", other_role, other_selected, uint8_t(chosen), other_role == uint8_t(chosen));
+
+		if (other_role == 0)
+		{
+			// unknown: wait for the other player
+			// (labels are derived client-side)
+		}
+		else if (other_role == uint8_t(chosen))
+		{
+			// same role: reset other to unknown, push their selection to the opposite:
+			other_role = 0;
+			set_selected_opposite(other_selected, chosen);
+		}
+		else
+		{
+			// complementary: both ready -> proceed to Communication
+			game.phase = Game::Phase::Communication;
+		}
+	});
+
+	dispatcher.on(Message::C2S_Instruction, Messages::Instruction::MinSize, Messages::Instruction::MaxSize, [this](Connection *c, uint8_t const *payload, uint32_t size)
+				  {
+		std::string typed;
+		Game::recv_instruction_payload(payload, size, &typed);
+
+		Game &game = game_for(client_for(c));
+
+		// Move to Operation phase and store the message:
+		game.found_count = 0;
+		game.attempt_count = 25;
+		game.instruction_text = typed;
+
+		// corrupt instruction: replace 50% of non-space chars with '*'
+		std::string corrupted = typed;
+		std::vector<size_t> nonspace;
+		nonspace.reserve(corrupted.size());
+		for (size_t i = 0; i < corrupted.size(); ++i)
+		{
+			if (corrupted[i] != ' ')
+				nonspace.push_back(i);
+		}
+		size_t replace_n = nonspace.size() / 2; // 50%
+		std::shuffle(nonspace.begin(), nonspace.end(), mt);
+		for (size_t k = 0; k < replace_n; ++k)
+		{
+			corrupted[nonspace[k]] = '*';
+		}
+		game.corrupted_instruction = std::move(corrupted);
+
+		game.phase = Game::Phase::Operation;
+	});
+
+	//------------ metrics ------------
+
+	Metrics::Registry &registry = Metrics::registry();
+	std::string shard = "shard=\"" + std::to_string(index) + "\"";
+	metrics.tick = &registry.histogram("game_tick_seconds", "Time to run one tick: update every room, then serialize and send state.", shard, 1e-9);
+	metrics.update = &registry.histogram("game_update_seconds", "Time to update every room's game, per tick.", shard, 1e-9);
+	metrics.ticks = &registry.counter("game_ticks_total", "Ticks run.", shard);
+	metrics.ticks_late = &registry.counter("game_ticks_late_total", "Ticks that started a whole step or more after they were due.", shard);
+	metrics.ticks_dropped = &registry.counter("game_ticks_dropped_total", "Ticks skipped because the shard fell too far behind.", shard);
+	metrics.tick_overruns = &registry.counter("game_tick_overruns_total", "Ticks still running when the next was due.", shard);
+	metrics.connections = &registry.gauge("game_connections", "Connected clients.", shard);
+	metrics.rooms = &registry.gauge("game_rooms", "Open rooms.", shard);
+	metrics.players = &registry.gauge("game_players", "Players, over all rooms.", shard);
+	metrics.open_seats = &registry.gauge("game_open_seats", "Empty seats in rooms waiting for a partner.", shard);
+	metrics.send_syscalls = &registry.counter("net_send_syscalls_total", "send()/sendmsg() calls.", shard);
+	metrics.bytes_sent = &registry.counter("net_sent_bytes_total", "Bytes written to connections' sockets.", shard);
+	metrics.recv_syscalls = &registry.counter("net_recv_syscalls_total", "recv() calls that returned data.", shard);
+	metrics.bytes_received = &registry.counter("net_received_bytes_total", "Bytes read from connections' sockets.", shard);
+	metrics.send_queue = &registry.gauge("net_send_queue_bytes", "Bytes waiting to be sent, over all connections, as of the last tick.", shard);
+	metrics.send_queue_max = &registry.gauge("net_send_queue_max_bytes", "Most bytes waiting to be sent on any one connection, as of the last tick.", shard);
+	metrics.states_skipped = &registry.counter("net_states_skipped_total", "State messages not sent to congested connections.", shard);
+	metrics.congestions = &registry.counter("net_congestions_total", "Times a connection's send queue reached its high watermark.", shard);
+	metrics.backpressure_disconnects = &registry.counter("net_backpressure_disconnects_total", "Connections closed for having too much waiting to be sent.", shard);
+	metrics.datagrams_received = &registry.counter("net_datagrams_received_total", "Datagrams received (over the shard's datagram socket, if any).", shard);
+	metrics.datagrams_sent = &registry.counter("net_datagrams_sent_total", "Datagrams sent (over the shard's datagram socket, if any).", shard);
+}
+
+void Shard::enable_datagrams()
+{
+	assert(!thread.joinable() && "enable datagrams before starting the shard");
+	datagrams = std::make_unique< DatagramSocket >();
+	Log::info("Shard %u accepting datagrams on port %u.", index, datagrams->port());
+}
+
+void Shard::simulate(NetPath const &path)
+{
+	assert(!thread.joinable() && "simulate network conditions before starting the shard");
+	server.simulate(path);
+	if (datagrams)
+		datagrams->simulate(path);
+}
+
+void Shard::record(std::string const &path)
+{
+	assert(!thread.joinable() && "start recording before starting the shard");
+	capture = std::make_unique< CaptureWriter >(path, seed);
+	mt.seed(seed);
+	// (messages are logged as they are dispatched, so only well-formed ones are; anything else closes the connection, which is logged too)
+	dispatcher.on_message = [this](Connection *c, uint8_t const *message, uint32_t size)
+	{
+		capture->write(scheduler.tick + 1, Capture::Event::Message, c->tag, message, size);
+	};
+	Log::info("Shard %u recording to '%s'.", index, path.c_str());
+}
+
+Shard::~Shard()
+{
+	stop();
+
+	// close everything this shard still owns:
+	Socket socket;
+	while (handoff.pop(&socket))
+	{
+		Connection dropped;
+		dropped.socket = socket;
+		dropped.close();
+	}
+	for (auto &c : server.connections)
+		c.close();
+	//(server's own descriptors are closed by its destructor)
+}
+
+void Shard::start()
+{
+	assert(!thread.joinable());
+	stop_requested = false;
+	thread = std::thread([this]()
+						 { run(); });
+}
+
+void Shard::stop()
+{
+	stop_requested = true;
+	if (thread.joinable())
+		thread.join();
+	if (capture)
+	{
+		// (the tick that would have run next; so the log says how many ran)
+		capture->write(scheduler.tick + 1, Capture::Event::End, 0);
+		capture->flush();
+		capture.reset();
+	}
+}
+
+void Shard::hand_off(std::vector<std::unique_ptr<Shard>> const &shards, Socket socket)
+{
+	assert(!shards.empty());
+	Shard *target = nullptr;
+	for (auto &shard : shards)
+	{
+		// (account for sockets still in the handoff queue: each fills an open seat or opens a room)
+		uint32_t pending = shard->handoff.size();
+		uint32_t open = shard->open_seats;
+		for (uint32_t p = 0; p < pending; ++p)
+			open = (open > 0 ? open - 1 : Rooms::Seats - 1);
+		if (open > 0)
+		{
+			target = shard.get();
+			break;
+		}
+		if (!target || shard->connection_count + pending < target->connection_count + target->handoff.size())
+			target = shard.get();
+	}
+	if (target->handoff.push(socket))
+	{
+		target->server.wake();
+	}
+	else
+	{
+		Log::warn("Shard %u isn't keeping up with new connections; dropping one.", target->index);
+		Connection dropped;
+		dropped.socket = socket;
+		dropped.close();
+	}
+}
+
+void Shard::run()
+{
+	scheduler.start();
+	while (!stop_requested)
+	{
+		// take over connections accepted by the listener:
+		Socket socket;
+		while (handoff.pop(&socket))
+		{
+			server.adopt(socket, on_event);
+		}
+
+		// process incoming data from clients until a tick is due:
+		uint32_t steps = scheduler.due();
+		if (steps == 0)
+		{
+			double wait = scheduler.wait();
+			// (simulated datagrams go out once they have made it through, so wake up for those, too; incoming ones wait for the next tick anyway)
+			if (datagrams && datagrams->outgoing)
+			{
+				datagrams->flush();
+				wait = std::max(0.0, std::min(wait, datagrams->outgoing->next_arrival() - NetPipe::clock()));
+			}
+			server.poll(on_event, wait);
+		}
+		// (more than one step => catching up after falling behind)
+		for (uint32_t s = 0; s < steps; ++s)
+		{
+			scheduler.begin_tick();
+			tick();
+			scheduler.end_tick();
+		}
+		if (capture)
+			capture->flush(); // (so the log is usable even if the server is killed)
+
+		if (dump_stats_requested)
+		{
+			std::ostringstream stats;
+			stats << "---- shard " << index << " message stats (" << clients.size() << " clients, " << rooms.rooms.size() << " rooms) ----\n";
+			dispatcher.dump_stats(stats);
+			auto const &tick_stats = scheduler.stats;
+			stats << "ticks: " << tick_stats.ticks << " run, " << tick_stats.late << " late, " << tick_stats.dropped << " dropped, "
+				<< tick_stats.overruns << " overran (" << 1000.0 * tick_stats.overrun_seconds << " ms total, " << 1000.0 * tick_stats.max_overrun_seconds << " ms max)\n";
+			auto const &send_stats = server.send_stats;
+			double per_tick = 1.0 / std::max< uint64_t >(1, tick_stats.ticks);
+			stats << "sends (per tick): " << send_stats.syscalls * per_tick << " syscalls, " << send_stats.bytes_sent * per_tick << " bytes sent, "
+				<< send_stats.bytes_copied * per_tick << " copied into send buffers, " << send_stats.bytes_shared * per_tick << " shared\n";
+			if (datagrams)
+			{
+				auto const &socket_stats = datagrams->stats;
+				stats << "datagrams: " << datagram_clients.size() << " clients; " << socket_stats.received << " received (" << datagram_stats.stale << " stale, "
+					<< datagram_stats.rejected << " rejected), " << socket_stats.sent << " sent (" << datagram_stats.oversized << " too big, sent over connection), "
+					<< socket_stats.errors << " errors\n";
+			}
+			auto const &backpressure = backpressure_stats;
+			stats << "backpressure: " << backpressure.skipped << " states skipped, " << backpressure.congested << " congestions, "
+				<< backpressure.disconnected << " disconnected; queued " << backpressure.queued / double(std::max< uint64_t >(1, backpressure.samples))
+				<< " bytes avg, " << backpressure.max_queued << " max\n";
+			std::cout << stats.str();
+			std::cout.flush();
+			dump_stats_requested = false;
+		}
+	}
+}
+
+Shard::ReplayStats Shard::replay(std::string const &path)
+{
+	assert(!thread.joinable() && clients.size() == 0 && "replay into a new shard");
+	assert(scheduler.mode == TickScheduler::Mode::Accelerated && "replay doesn't need to wait for ticks");
+
+	CaptureReader reader(path);
+	mt.seed(reader.seed);
+
+	ReplayStats stats;
+
+	std::unordered_map< uint64_t, Connection * > recorded; // id in the capture => stand-in
+	auto find = [&](Capture::Record const &record) -> Connection *
+	{
+		auto found = recorded.find(record.connection);
+		if (found == recorded.end())
+			throw std::runtime_error("Capture has a record for a client that isn't connected.");
+		return found->second;
+	};
+
+	Capture::Record record;
+	bool more = reader.next(&record);
+	scheduler.start();
+	while (true)
+	{
+		// everything that arrived before the next tick:
+		while (more && record.tick <= scheduler.tick + 1)
+		{
+			if (record.event == Capture::Event::Open)
+			{
+				replayed.emplace_back();
+				Connection *c = &replayed.back();
+				c->offline = true;
+				recorded[record.connection] = c;
+				on_event(c, Connection::OnOpen);
+				stats.connections += 1;
+			}
+			else if (record.event == Capture::Event::Message)
+			{
+				Connection *c = find(record);
+				c->recv_buffer.append(record.bytes.data(), record.bytes.size());
+				on_event(c, Connection::OnRecv);
+				stats.messages += 1;
+			}
+			else if (record.event == Capture::Event::Datagram)
+			{
+				Connection *c = find(record);
+				if (record.bytes.size() != ControlsDatagramSize)
+					throw std::runtime_error("Capture has a datagram that isn't a controls message.");
+				recv_datagram_controls(client_for(c), record.bytes.data());
+				stats.datagrams += 1;
+			}
+			else
+			{
+				assert(record.event == Capture::Event::Close);
+				Connection *c = find(record);
+				if (*c) // (unless a message handler already closed it, just as when recording)
+				{
+					c->close();
+					on_event(c, Connection::OnClose);
+				}
+				recorded.erase(record.connection);
+				replayed.remove_if([c](Connection const &other) { return &other == c; });
+			}
+			more = reader.next(&record);
+		}
+		if (!more && scheduler.tick >= reader.ticks)
+			break;
+
+		scheduler.begin_tick();
+		tick();
+		scheduler.end_tick();
+		stats.ticks += 1;
+
+		for (auto &c : replayed)
+		{
+			stats.state_bytes += c.send_buffer.size();
+			c.send_buffer.clear();
+		}
+	}
+	// (clients still connected at the end of the capture stay, so the shard's state can be compared with the recording's)
+	return stats;
+}
+
+void Shard::tick()
+{
+	auto before = std::chrono::steady_clock::now();
+
+	if (datagrams)
+		recv_datagrams();
+
+	// update current game state (in every room)
+	auto update_before = std::chrono::steady_clock::now();
+	rooms.update(Game::Tick);
+	metrics.update->record(uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - update_before).count()));
+
+	// encode each room's new state once...
+	for (auto &room : rooms.rooms.values)
+	{
+		room.broadcast.prepare(room.game);
+	}
+	// ...and send it to all clients
+	backpressure_stats.tick_queued = 0;
+	backpressure_stats.tick_max_queued = 0;
+	for (auto &client : clients.values)
+	{
+		Room *room = rooms.get(client.place.room);
+		assert(room);
+
+		// (a connection that isn't keeping up skips states -- each supersedes the last -- until it has drained)
+		Connection &connection = *client.connection;
+		bool was_congested = connection.congested;
+		bool congested = connection.check_congestion();
+		size_t queued = connection.queued();
+		backpressure_stats.congested += (congested && !was_congested);
+		backpressure_stats.queued += queued;
+		backpressure_stats.samples += 1;
+		backpressure_stats.max_queued = std::max(backpressure_stats.max_queued, queued);
+		backpressure_stats.tick_queued += queued;
+		backpressure_stats.tick_max_queued = std::max(backpressure_stats.tick_max_queued, queued);
+		if (queued > MaxQueued)
+		{
+			overfull.emplace_back(&connection);
+			continue;
+		}
+
+		if (client.datagram_address)
+		{
+			room->game.send_state_message(&datagram_outbox, client.place.player, &client.baseline, &room->broadcast);
+			if (datagram_outbox.send_buffer.size() <= DatagramSocket::MaxSize)
+			{
+				datagrams->send(datagram_outbox.send_buffer, &client.datagram_address);
+			}
+			else if (congested)
+			{
+				// (every datagram state is a keyframe, so the next one makes up for this one)
+				backpressure_stats.skipped += 1;
+			}
+			else
+			{
+				// (it's a keyframe, so it can go over the connection just as well)
+				datagram_stats.oversized += 1;
+				std::vector< uint8_t > bytes = datagram_outbox.send_buffer.bytes();
+				connection.send_raw(bytes.data(), bytes.size());
+				connection.note_supersedable(bytes.size());
+			}
+			datagram_outbox.send_buffer.clear();
+		}
+		else if (congested)
+		{
+			// (the baseline stays at what was last sent, so the next state message brings the client up to date)
+			backpressure_stats.skipped += 1;
+		}
+		else
+		{
+			size_t before = connection.send_buffer.size();
+			room->game.send_state_message(&connection, client.place.player, &client.baseline, &room->broadcast);
+			connection.note_supersedable(connection.send_buffer.size() - before);
+		}
+	}
+	for (Connection *c : overfull)
+	{
+		Log::info("Disconnecting client: %zu bytes waiting to be sent.", c->queued());
+		backpressure_stats.disconnected += 1;
+		c->close();
+		remove_connection(c);
+	}
+	overfull.clear();
+	// (and get it on its way, rather than waiting for the next poll)
+	server.poll(on_event, 0.0);
+
+	ticks += 1;
+	uint64_t ns = uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - before).count());
+	tick_ns += ns;
+	metrics.tick->record(ns);
+	publish_metrics();
+}
+
+void Shard::publish_metrics()
+{
+	auto const &tick_stats = scheduler.stats;
+	metrics.ticks->set(tick_stats.ticks);
+	metrics.ticks_late->set(tick_stats.late);
+	metrics.ticks_dropped->set(tick_stats.dropped);
+	metrics.tick_overruns->set(tick_stats.overruns);
+
+	uint32_t players = 0;
+	for (auto const &room : rooms.rooms.values)
+		players += room.game.players.size();
+	metrics.connections->set(double(clients.size()));
+	metrics.rooms->set(double(rooms.rooms.size()));
+	metrics.players->set(double(players));
+	metrics.open_seats->set(double(open_seats.load(std::memory_order_relaxed)));
+
+	auto const &send_stats = server.send_stats;
+	metrics.send_syscalls->set(send_stats.syscalls);
+	metrics.bytes_sent->set(send_stats.bytes_sent);
+	metrics.recv_syscalls->set(send_stats.recv_syscalls);
+	metrics.bytes_received->set(send_stats.bytes_received);
+
+	metrics.send_queue->set(double(backpressure_stats.tick_queued));
+	metrics.send_queue_max->set(double(backpressure_stats.tick_max_queued));
+	metrics.states_skipped->set(backpressure_stats.skipped);
+	metrics.congestions->set(backpressure_stats.congested);
+	metrics.backpressure_disconnects->set(backpressure_stats.disconnected);
+
+	if (datagrams)
+	{
+		metrics.datagrams_received->set(datagrams->stats.received);
+		metrics.datagrams_sent->set(datagrams->stats.sent);
+	}
+
+	for (uint32_t type = 0; type < dispatcher.stats.size(); ++type)
+	{
+		auto const &stats = dispatcher.stats[type];
+		if (stats.count == 0)
+			continue;
+		if (!metrics.messages[type])
+		{
+			// (first message of this type: add its series; labelled with the type's character, if it has a plain one)
+			bool plain = (type >= 0x20 && type < 0x7f && type != '"' && type != '\\');
+			std::string labels = "shard=\"" + std::to_string(index) + "\",type=\"" + (plain ? std::string(1, char(type)) : std::to_string(type)) + "\"";
+			metrics.messages[type] = &Metrics::registry().counter("net_messages_received_total", "Messages handled, by type.", labels);
+			metrics.message_bytes[type] = &Metrics::registry().counter("net_message_received_bytes_total", "Bytes of messages handled (headers included), by type.", labels);
+		}
+		metrics.messages[type]->set(stats.count);
+		metrics.message_bytes[type]->set(stats.bytes);
+	}
+}
+
+void Shard::recv_datagrams()
+{
+	DatagramAddress from;
+	while (datagrams->recv(&datagram_buffer, &from))
+	{
+		// [token] + [type, size_low0, size_mid8, size_high16] + controls payload:
+		uint64_t token = 0;
+		if (datagram_buffer.size() == 8 + ControlsDatagramSize)
+			std::memcpy(&token, datagram_buffer.data(), sizeof(token));
+		auto found = datagram_clients.find(token);
+		uint8_t const *message = datagram_buffer.data() + 8;
+		if (found == datagram_clients.end() || message[0] != uint8_t(Message::C2S_Controls)
+			|| Schema::payload_size(message) != Messages::Controls::MinSize)
+		{
+			// (anyone can send us datagrams, so nonsense is ignored rather than fatal)
+			datagram_stats.rejected += 1;
+			continue;
+		}
+		Client *client = clients.get(found->second);
+		assert(client);
+
+		// the client starts getting state as datagrams once we know where it is:
+		if (!client->datagram_address)
+			client->baseline.deltas = false;
+		client->datagram_address = from;
+
+		// (this tick has started, so the controls arrived before it)
+		if (capture)
+			capture->write(scheduler.tick, Capture::Event::Datagram, client->connection->tag, message, ControlsDatagramSize);
+		recv_datagram_controls(*client, message);
+	}
+}
+
+void Shard::recv_datagram_controls(Client &client, uint8_t const *message)
+{
+	// only the newest controls matter (this one may have been overtaken, or be a duplicate):
+	Player::Controls &controls = game_for(client).players.controls[player_for(client)];
+	uint8_t buttons[5];
+	uint32_t seq;
+	Messages::Controls::decode(message + Schema::HeaderSize, Messages::Controls::MinSize, &buttons[0], &buttons[1], &buttons[2], &buttons[3], &buttons[4], &seq);
+	if (int32_t(seq - controls.seq) <= 0)
+	{
+		datagram_stats.stale += 1;
+		return;
+	}
+	controls.apply(buttons, seq);
+}
+
+Shard::Client &Shard::client_for(Connection *c)
+{
+	Client *client = clients.get(SlotHandle::unpack(c->tag));
+	assert(client && client->connection == c);
+	return *client;
+}
+
+Game &Shard::game_for(Client const &client)
+{
+	Room *room = rooms.get(client.place.room);
+	assert(room);
+	return room->game;
+}
+
+uint32_t Shard::player_for(Client const &client)
+{
+	Game &game = game_for(client);
+	uint32_t index = game.players.find(client.place.player);
+	assert(index < game.players.size());
+	return index;
+}
+
+// used on client close (due to quit) and server close (due to error):
+// (safe to call again for a connection already removed, e.g. closed by a handler and then reported closed by poll())
+void Shard::remove_connection(Connection *c)
+{
+	if (!SlotHandle::unpack(c->tag))
+		return;
+	Client &client = client_for(c);
+	if (capture)
+		capture->write(scheduler.tick + 1, Capture::Event::Close, c->tag);
+	if (client.datagram_token != 0)
+		datagram_clients.erase(client.datagram_token);
+	rooms.leave(client.place);
+	clients.erase(SlotHandle::unpack(c->tag));
+	c->tag = SlotHandle().pack();
+	publish_counts();
+}
+
+void Shard::publish_counts()
+{
+	open_seats = rooms.open_seats();
+	connection_count = clients.size();
+}
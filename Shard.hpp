@@ -0,0 +1,210 @@
+#pragma once
+
+/*
+ * A Shard is one worker thread's part of the server: its own connections (and
+ * poll loop), its own Rooms, and the message handlers that act on them. Other
+ * threads only touch a shard through its handoff queue and the atomics below.
+ *
+ * The listener thread (see server.cpp) accepts sockets, pushes them onto a
+ * shard's 'handoff' queue, and wakes that shard's poll() so it adopts them right
+ * away. Players are only ever paired with players in the same shard, so the
+ * listener uses 'open_seats' to send newcomers where someone is waiting.
+ *
+ * With enable_datagrams(), clients may also ask (C2S_DatagramRequest) to send
+ * controls and get state over the shard's DatagramSocket instead (see
+ * Datagram.hpp).
+ *
+ * With simulate(), all of the shard's traffic (connections and datagrams) goes
+ * through simulated network conditions (see NetSim.hpp).
+ *
+ * With record(), everything clients send is logged with the tick it arrived
+ * before (see Capture.hpp); replay() runs such a log through a new shard's
+ * handlers and ticks, without sockets and as fast as possible, ending up in the
+ * same state. (So game logic must only depend on messages and ticks -- not on
+ * wall-clock time or unseeded randomness; use 'mt' for randomness.)
+ *
+ * Each shard keeps its tick timings and counts in Metrics::registry(), as
+ * series labelled shard="<index>" (see publish_metrics()).
+ *
+ * Usage:
+ *   Shard shard(index);
+ *   shard.enable_datagrams(); //(optional)
+ *   shard.simulate(path); //(optional)
+ *   shard.record("session.cap"); //(optional)
+ *   shard.start(); //runs run() on a new thread
+ *   shard.handoff.push(socket); //from the listener thread
+ *   shard.stop(); //(also done by ~Shard)
+ *
+ *   Shard replayer(0, DefaultPollBackend, TickScheduler::Mode::Accelerated);
+ *   replayer.replay("session.cap"); //(on this thread; instead of start())
+ */
+
+#include "Capture.hpp"
+#include "Connection.hpp"
+#include "Datagram.hpp"
+#include "Game.hpp"
+#include "MessageDispatcher.hpp"
+#include "Metrics.hpp"
+#include "Rooms.hpp"
+#include "SlotMap.hpp"
+#include "SpscQueue.hpp"
+#include "TickScheduler.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <list>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct Shard {
+	Shard(uint32_t index, PollBackend backend = DefaultPollBackend, TickScheduler::Mode mode = TickScheduler::Mode::RealTime);
+	~Shard(); //stops the thread, and closes all of the shard's sockets
+	Shard(Shard const &) = delete;
+	Shard &operator=(Shard const &) = delete;
+
+	//start running run() on a new thread / ask it to stop, and wait until it has:
+	void start();
+	void stop();
+
+	//open a datagram socket and offer it to clients that ask (call before start()):
+	void enable_datagrams();
+	//run connections' and datagrams' traffic through simulated network conditions (call before start(), after enable_datagrams()):
+	void simulate(NetPath const &path);
+
+	//log everything clients send from now on to a capture file (call before start(); the log is finished by stop()):
+	void record(std::string const &path);
+
+	//run a recorded session through this shard's handlers and ticks, without sockets (instead of start()):
+	// (the shard should be new, with an Accelerated scheduler; throws if the capture is damaged)
+	struct ReplayStats {
+		uint64_t ticks = 0;
+		uint64_t connections = 0; //clients that connected
+		uint64_t messages = 0, datagrams = 0; //messages handled (over connections / as datagrams)
+		uint64_t state_bytes = 0; //state messages the shard sent (and replay() discarded)
+	};
+	ReplayStats replay(std::string const &path);
+
+	//handle messages, update rooms, and send state every Game::Tick (as timed by 'scheduler'), until stop() is called:
+	void run();
+
+	//give a newly accepted socket to one of 'shards' (from the listener thread):
+	// players are only paired within a shard, so this prefers shards where someone is waiting for a partner,
+	// and otherwise picks the least busy one.
+	static void hand_off(std::vector< std::unique_ptr< Shard > > const &shards, Socket socket);
+
+	//---- shared with other threads ----
+
+	SpscQueue< Socket, 1024 > handoff; //newly accepted sockets (listener thread -> this shard)
+
+	//published by the shard whenever they change:
+	std::atomic< uint32_t > open_seats{0}; //see Rooms::open_seats()
+	std::atomic< uint32_t > connection_count{0};
+
+	//tick cost (update + serialize + send), summed since start():
+	std::atomic< uint64_t > ticks{0};
+	std::atomic< uint64_t > tick_ns{0};
+
+	std::atomic< bool > stop_requested{false};
+	std::atomic< bool > dump_stats_requested{false}; //print message stats (then clear this)
+
+	//---- owned by the shard's thread ----
+
+	uint32_t index; //(for log messages)
+
+	Server server; //(no listen socket; connections are adopted from 'handoff')
+
+	//per-connection info:
+	struct Client {
+		Connection *connection = nullptr;
+		Rooms::Place place; //the room this connection is in, and the player it is controlling there
+		Game::StateBaseline baseline; //what state this connection has been sent (so only changes need to be sent)
+		uint64_t datagram_token = 0; //(if it asked for datagrams) the token its datagrams start with
+		DatagramAddress datagram_address; //where its last datagram came from (so, where its state goes; unset => over the connection)
+	};
+	//(stored densely, for broadcasting; each connection keeps the handle of its Client in Connection::tag)
+	SlotMap< Client > clients;
+
+	Rooms rooms; //one game per pair of players
+
+	MessageDispatcher dispatcher;
+
+	TickScheduler scheduler; //when to tick (message handlers can ask it for the current tick and phase)
+
+	//(if enable_datagrams() was called) controls and state for clients that asked for them:
+	std::unique_ptr< DatagramSocket > datagrams;
+	std::unordered_map< uint64_t, SlotHandle > datagram_clients; //token => client
+	std::mt19937_64 token_mt{std::random_device{}()};
+	Connection datagram_outbox; //(state messages are written here, then sent as datagrams)
+	std::vector< uint8_t > datagram_buffer; //(received datagrams land here)
+	struct {
+		uint64_t stale = 0; //controls older than ones already applied
+		uint64_t rejected = 0; //unknown token or not a controls message
+		uint64_t oversized = 0; //state messages too big for a datagram (sent over the connection instead)
+	} datagram_stats;
+
+	//backpressure (see Connection::check_congestion()): congested connections are skipped when sending state -- the
+	// next state they are sent covers the skipped ones' changes -- and ones with more than MaxQueued bytes waiting
+	// anyway (i.e., from messages that can't be skipped) are disconnected:
+	inline static constexpr size_t MaxQueued = 1024 * 1024;
+	struct {
+		uint64_t skipped = 0; //state messages not queued for congested connections
+		uint64_t congested = 0; //times a connection became congested
+		uint64_t disconnected = 0; //connections closed for having more than MaxQueued bytes waiting
+		uint64_t queued = 0, samples = 0; //bytes waiting, summed over each connection each tick (for the average)
+		size_t max_queued = 0;
+		uint64_t tick_queued = 0; //bytes waiting, summed over connections, as of the last tick
+		size_t tick_max_queued = 0; //...and the most waiting on any one connection
+	} backpressure_stats;
+	std::vector< Connection * > overfull; //(connections to close once the tick's state has been sent)
+
+	//game randomness (e.g., corrupting instructions), seeded from the capture when replaying:
+	uint32_t seed = std::random_device{}();
+	std::mt19937 mt{seed};
+
+	//(if record() was called) where everything clients send is logged:
+	std::unique_ptr< CaptureWriter > capture;
+	//(if replay() was called) stand-ins for the recorded clients' connections, which have no sockets:
+	std::list< Connection > replayed;
+
+	std::function< void(Connection *, Connection::Event) > on_event; //passed to server.poll()
+
+	std::thread thread;
+
+	//this shard's series in Metrics::registry(): timings are recorded as they happen,
+	// counts (kept above, by this thread) are copied over at the end of each tick:
+	struct {
+		Metrics::Histogram *tick = nullptr; //(nanoseconds) update + serialize + send
+		Metrics::Histogram *update = nullptr; //(nanoseconds) updating every room's game
+		Metrics::Counter *ticks = nullptr, *ticks_late = nullptr, *ticks_dropped = nullptr, *tick_overruns = nullptr;
+		Metrics::Gauge *connections = nullptr, *rooms = nullptr, *players = nullptr, *open_seats = nullptr;
+		Metrics::Counter *send_syscalls = nullptr, *bytes_sent = nullptr, *recv_syscalls = nullptr, *bytes_received = nullptr;
+		Metrics::Gauge *send_queue = nullptr, *send_queue_max = nullptr;
+		Metrics::Counter *states_skipped = nullptr, *congestions = nullptr, *backpressure_disconnects = nullptr;
+		Metrics::Counter *datagrams_received = nullptr, *datagrams_sent = nullptr;
+		std::array< Metrics::Counter *, 256 > messages{}, message_bytes{}; //by Message type byte (added once one arrives)
+	} metrics;
+	void publish_metrics();
+
+	//one tick: update every room, then send everyone their state:
+	void tick();
+
+	//apply controls that arrived as datagrams:
+	// (controls only matter at the next tick, so this is done at the start of tick() rather than on arrival)
+	void recv_datagrams();
+	//apply a controls message ([type, size, payload]) that arrived as a datagram, unless it is stale:
+	void recv_datagram_controls(Client &client, uint8_t const *message);
+
+	//helpers:
+	Client &client_for(Connection *c);
+	Game &game_for(Client const &client); //the game a connection is playing in
+	uint32_t player_for(Client const &client); //index (in its game's players) of the player a connection is controlling
+	void remove_connection(Connection *c);
+	void publish_counts();
+};
@@ -0,0 +1,155 @@
+#pragma once
+
+/*
+ * SlotMap keeps values in a dense array (so iterating them is a straight walk
+ * over memory) and hands out generational handles that stay valid while values
+ * move around inside that array.
+ *
+ * A handle is a slot number plus the generation of that slot when the handle was
+ * made. Each slot records where its value currently lives in the dense array;
+ * erasing a value moves the last value into the hole and bumps the slot's
+ * generation, so stale handles simply stop finding anything. Insert, erase, and
+ * lookup are all O(1), and freed slots are reused.
+ *
+ * SlotIndex is just the handle <-> dense index bookkeeping, for containers that
+ * store their values some other way (e.g., Game::Players keeps a structure of
+ * arrays, and moves every array's last entry into the hole whenever erase()
+ * says to). SlotMap< T > pairs a SlotIndex with a std::vector< T >.
+ */
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+#include <cassert>
+
+struct SlotHandle {
+	static constexpr uint32_t Invalid = ~0u;
+	uint32_t slot = Invalid;
+	uint32_t generation = 0;
+
+	explicit operator bool() const { return slot != Invalid; }
+	bool operator==(SlotHandle const &) const = default;
+
+	//as a single integer (e.g., to stash in some other object):
+	uint64_t pack() const { return (uint64_t(slot) << 32) | uint64_t(generation); }
+	static SlotHandle unpack(uint64_t packed) { return SlotHandle{uint32_t(packed >> 32), uint32_t(packed)}; }
+};
+
+struct SlotIndex {
+	static constexpr uint32_t Free = ~0u;
+	struct Slot {
+		uint32_t generation = 0; //bumped whenever the slot is freed
+		uint32_t dense = Free; //index of the slot's value in the dense array (Free if none)
+	};
+	std::vector< Slot > slots;
+	std::vector< uint32_t > dense_slot; //per dense index: the slot that refers to it
+	std::vector< uint32_t > free_slots; //freed slots, reused last-freed-first
+
+	uint32_t size() const { return uint32_t(dense_slot.size()); }
+	bool empty() const { return dense_slot.empty(); }
+
+	void clear() {
+		//(bump generations rather than forgetting slots, so old handles stay stale)
+		for (uint32_t s = 0; s < uint32_t(slots.size()); ++s) {
+			if (slots[s].dense != Free) free_slot(s);
+		}
+		dense_slot.clear();
+	}
+
+	//dense index of a handle's value, or size() if the handle is stale:
+	uint32_t find(SlotHandle handle) const {
+		if (handle.slot >= slots.size()) return size();
+		Slot const &slot = slots[handle.slot];
+		if (slot.generation != handle.generation || slot.dense == Free) return size();
+		return slot.dense;
+	}
+
+	SlotHandle handle(uint32_t dense) const {
+		assert(dense < size());
+		uint32_t slot = dense_slot[dense];
+		return SlotHandle{slot, slots[slot].generation};
+	}
+
+	//claim a slot for a new value, which goes at dense index size() - 1:
+	SlotHandle insert() {
+		while (!free_slots.empty()) {
+			uint32_t slot = free_slots.back();
+			free_slots.pop_back();
+			if (slots[slot].dense == Free) return claim(slot); //(skip slots since taken by insert_at)
+		}
+		slots.emplace_back();
+		return claim(uint32_t(slots.size()) - 1);
+	}
+
+	//claim a particular (free) slot, e.g., to mirror another SlotIndex:
+	SlotHandle insert_at(uint32_t slot) {
+		while (slots.size() <= slot) {
+			slots.emplace_back();
+			if (slots.size() - 1 != slot) free_slots.emplace_back(uint32_t(slots.size()) - 1);
+		}
+		assert(slots[slot].dense == Free);
+		return claim(slot);
+	}
+
+	//free a handle's slot; returns the dense index that was removed.
+	//  the value at dense index size() (the old last one) now belongs at that index, so move it there:
+	uint32_t erase(SlotHandle handle) {
+		uint32_t dense = find(handle);
+		assert(dense < size());
+		uint32_t last = size() - 1;
+		if (dense != last) {
+			dense_slot[dense] = dense_slot[last];
+			slots[dense_slot[dense]].dense = dense;
+		}
+		dense_slot.pop_back();
+		free_slot(handle.slot);
+		return dense;
+	}
+
+private:
+	SlotHandle claim(uint32_t slot) {
+		slots[slot].dense = size();
+		dense_slot.emplace_back(slot);
+		return SlotHandle{slot, slots[slot].generation};
+	}
+	void free_slot(uint32_t slot) {
+		slots[slot].dense = Free;
+		slots[slot].generation += 1;
+		free_slots.emplace_back(slot);
+	}
+};
+
+template< typename T >
+struct SlotMap {
+	SlotIndex index;
+	std::vector< T > values; //dense; values[i] belongs to index.handle(i)
+
+	uint32_t size() const { return index.size(); }
+	bool empty() const { return index.empty(); }
+
+	SlotHandle insert(T &&value) {
+		values.emplace_back(std::move(value));
+		return index.insert();
+	}
+
+	//nullptr if the handle is stale:
+	T *get(SlotHandle handle) {
+		uint32_t dense = index.find(handle);
+		return (dense < size() ? &values[dense] : nullptr);
+	}
+	T const *get(SlotHandle handle) const {
+		uint32_t dense = index.find(handle);
+		return (dense < size() ? &values[dense] : nullptr);
+	}
+
+	void erase(SlotHandle handle) {
+		uint32_t dense = index.erase(handle);
+		if (dense != values.size() - 1) values[dense] = std::move(values.back());
+		values.pop_back();
+	}
+
+	void clear() {
+		index.clear();
+		values.clear();
+	}
+};
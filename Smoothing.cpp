@@ -0,0 +1,140 @@
+#include "Smoothing.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+void Smoothing::advance(float elapsed) {
+	clock += elapsed;
+	frame_elapsed = elapsed;
+}
+
+void Smoothing::record_controls(Player::Controls *controls) {
+	controls->seq = next_seq++;
+	if (next_seq == 0) next_seq = 1; //(0 means "nothing acknowledged")
+
+	pending.emplace_back();
+	pending.back().controls = *controls;
+	pending.back().elapsed = frame_elapsed;
+	if (pending.size() > MaxPending) pending.pop_front();
+}
+
+void Smoothing::record_state(Game const &game) {
+	Snapshot const *prev = (snapshots_size ? &snapshots[(snapshots_next + SnapshotCount - 1) % SnapshotCount] : nullptr);
+	Snapshot &snapshot = snapshots[snapshots_next];
+
+	if (!prev) {
+		snapshot.time = clock;
+	} else {
+		//track how irregularly states arrive, and render far enough behind to cover it:
+		float interval = float(clock - last_arrival);
+		jitter = glm::mix(jitter, std::abs(interval - Game::Tick), 0.1f);
+		delay = std::min(1.5f * Game::Tick + 2.0f * jitter, MaxDelay);
+
+		//the server sends at a steady Game::Tick, so place states on that cadence, pulled gently toward their arrival times:
+		double expected = prev->time + Game::Tick;
+		if (std::abs(clock - expected) > MaxDelay) {
+			snapshot.time = std::max(clock, prev->time); //lost the cadence (e.g., stall or burst); start over from here
+		} else {
+			snapshot.time = expected + 0.1 * (clock - expected);
+		}
+	}
+	last_arrival = clock;
+
+	snapshot.players.resize(game.players.size());
+	for (uint32_t i = 0; i < game.players.size(); ++i) {
+		snapshot.players[i] = game.players.get(i);
+	}
+	std::sort(snapshot.players.begin(), snapshot.players.end(), [](Player const &a, Player const &b) { return a.id < b.id; });
+
+	snapshots_next = (snapshots_next + 1) % SnapshotCount;
+	snapshots_size = std::min(snapshots_size + 1, SnapshotCount);
+
+	reconcile = true;
+}
+
+void Smoothing::update(Game const &game) {
+	//---- local player: prediction ----
+	uint32_t self = game.players.find_id(game.self_id);
+
+	correction *= std::pow(0.5f, frame_elapsed / CorrectionHalflife);
+
+	if (self == game.players.size()) {
+		predicted.players.clear();
+		correction = glm::vec2(0.0f);
+	} else if (reconcile || predicted.players.empty()) {
+		//start over from the server's state and re-apply the controls it hasn't seen yet:
+		bool had_prediction = !predicted.players.empty();
+		glm::vec2 before = (had_prediction ? predicted.players.position(0) : game.players.position(self));
+
+		while (!pending.empty() && int32_t(pending.front().controls.seq - game.input_ack) <= 0) {
+			pending.pop_front();
+		}
+		predicted.players.clear();
+		predicted.players.insert(game.players.get(self));
+		for (auto const &input : pending) {
+			predicted.players.controls[0] = input.controls;
+			predicted.update(input.elapsed);
+		}
+
+		//blend out the difference rather than popping:
+		if (had_prediction) correction += before - predicted.players.position(0);
+		if (glm::length(correction) > MaxCorrection) correction = glm::vec2(0.0f);
+	} else if (!pending.empty()) {
+		//just step this frame's controls:
+		predicted.players.controls[0] = pending.back().controls;
+		predicted.update(pending.back().elapsed);
+	}
+	reconcile = false;
+
+	//---- everyone: interpolation ----
+	players.clear();
+	if (snapshots_size == 0) return;
+
+	double render_time = clock - delay;
+
+	//find the snapshots on either side of render_time:
+	Snapshot const *a = nullptr, *b = nullptr;
+	uint32_t oldest = (snapshots_next + SnapshotCount - snapshots_size) % SnapshotCount;
+	for (uint32_t i = 0; i < snapshots_size; ++i) {
+		Snapshot const &snapshot = snapshots[(oldest + i) % SnapshotCount];
+		if (snapshot.time <= render_time) {
+			a = &snapshot;
+		} else {
+			b = &snapshot;
+			break;
+		}
+	}
+
+	if (!a) {
+		//render time is before every snapshot (e.g., just connected); show the oldest:
+		players = b->players;
+	} else if (!b) {
+		//states are late; carry on along current velocities, for a little while:
+		float t = float(std::min< double >(render_time - a->time, MaxExtrapolation));
+		players = a->players;
+		for (auto &player : players) {
+			player.position += player.velocity * t;
+		}
+	} else {
+		float amt = float((render_time - a->time) / (b->time - a->time));
+		//(players that left before 'b' are dropped; players that joined appear where 'b' has them)
+		players = b->players;
+		auto pa = a->players.begin();
+		for (auto &player : players) {
+			while (pa != a->players.end() && pa->id < player.id) ++pa;
+			if (pa == a->players.end() || pa->id != player.id) continue;
+			player.position = glm::mix(pa->position, player.position, amt);
+			player.velocity = glm::mix(pa->velocity, player.velocity, amt);
+		}
+	}
+
+	//the local player is shown where prediction puts it:
+	if (!predicted.players.empty()) {
+		for (auto &player : players) {
+			if (player.id != game.self_id) continue;
+			player.position = predicted.players.position(0) + correction;
+			player.velocity = predicted.players.velocity(0);
+			break;
+		}
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+/*
+ * Smoothing turns the server's Game::Tick-rate state messages into positions
+ * that can be drawn every frame:
+ *  - other players are interpolated between the two snapshots that bracket a
+ *    render time slightly in the past ('delay' adapts to arrival jitter),
+ *  - the local player is predicted by re-running Game::update over the
+ *    controls the server hasn't acknowledged yet (Game::input_ack), so input
+ *    shows up immediately; corrections are blended out over a short time.
+ *
+ * Usage, once per frame:
+ *   smoothing.advance(elapsed);
+ *   smoothing.record_controls(&controls); //before controls.send_controls_message(...)
+ *   ...after each successful game.recv_state_message(...): smoothing.record_state(game);
+ *   smoothing.update(game); //fills smoothing.players
+ */
+
+#include "Game.hpp"
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+struct Smoothing {
+	//players to draw this frame, in ascending id order:
+	std::vector< Player > players;
+
+	//advance the local clock:
+	void advance(float elapsed);
+
+	//assign the next sequence number to 'controls' and remember them (with this frame's elapsed time) for prediction:
+	void record_controls(Player::Controls *controls);
+
+	//remember the state just applied to 'game':
+	void record_state(Game const &game);
+
+	//predict the local player and interpolate the others into 'players':
+	void update(Game const &game);
+
+	//---- internals (public for inspection) ----
+
+	double clock = 0.0; //local time, in seconds
+	float frame_elapsed = 0.0f; //elapsed time passed to the most recent advance()
+
+	//recent server states:
+	struct Snapshot {
+		double time = 0.0; //where the state sits on the local clock (arrival time, smoothed toward a Game::Tick cadence)
+		std::vector< Player > players; //in ascending id order
+	};
+	static constexpr uint32_t SnapshotCount = 16;
+	std::array< Snapshot, SnapshotCount > snapshots; //ring buffer
+	uint32_t snapshots_next = 0; //slot the next snapshot is written to
+	uint32_t snapshots_size = 0;
+
+	double last_arrival = 0.0; //local clock when the previous snapshot arrived
+	float jitter = 0.0f; //smoothed |arrival interval - Game::Tick|
+	float delay = 1.5f * Game::Tick; //render time is this far behind the clock
+
+	//controls sent but not yet applied by the server:
+	struct Input {
+		Player::Controls controls;
+		float elapsed = 0.0f; //frame time these controls were held for
+	};
+	std::deque< Input > pending;
+	uint32_t next_seq = 1;
+	bool reconcile = false; //a new state arrived since the last update()
+
+	Game predicted; //holds just the local player, stepped with Game::update
+	glm::vec2 correction = glm::vec2(0.0f); //prediction error being blended out (added to the predicted position)
+
+	//tuning:
+	static constexpr uint32_t MaxPending = 256; //oldest inputs are forgotten past this (e.g., server stalled)
+	static constexpr float MaxDelay = 0.25f;
+	static constexpr float MaxExtrapolation = 0.1f; //when snapshots are late, extrapolate at most this far
+	static constexpr float CorrectionHalflife = 0.05f;
+	static constexpr float MaxCorrection = 4.0f * Game::PlayerRadius; //larger prediction errors snap instead of blending
+};
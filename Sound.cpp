@@ -1,6 +1,7 @@
 #include "Sound.hpp"
 #include "load_wav.hpp"
 #include "load_opus.hpp"
+#include "Profiler.hpp"
 
 #include <SDL3/SDL.h>
 
@@ -302,6 +303,8 @@ void step_direction_ramp(float step, Sound::Ramp< glm::vec3 > &ramp) {
 
 //The audio callback -- invoked by SDL when it needs more sound to play:
 void SDLCALL mix_audio(void *, SDL_AudioStream *stream_, int additional_amount, int total_amount) {
+	Profiler::set_thread_name("audio");
+	PROFILE_ZONE("mix_audio");
 	if (total_amount <= 0) return;
 	assert(stream_ == stream && "callback should only be used with our main stream");
 
@@ -0,0 +1,54 @@
+#pragma once
+
+/*
+ * SpscQueue is a fixed-capacity FIFO for handing values from exactly one
+ * producer thread to exactly one consumer thread without locks.
+ *
+ * The producer only writes 'tail' and the consumer only writes 'head'; each
+ * reads the other's index with acquire ordering and publishes its own with
+ * release ordering, so an item's contents are visible before its slot is.
+ * (The indices sit on separate cache lines so the two threads don't contend
+ * over one line.)
+ *
+ * Used by the server to pass newly accepted sockets from the listener thread
+ * to worker threads (see Shard.hpp).
+ */
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+template< typename T, uint32_t Capacity >
+struct SpscQueue {
+	static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two.");
+
+	//producer thread only; returns false (and leaves 'value' alone) if the queue is full:
+	bool push(T const &value) {
+		uint32_t t = tail.load(std::memory_order_relaxed);
+		if (t - head.load(std::memory_order_acquire) == Capacity) return false;
+		items[t & (Capacity - 1)] = value;
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	//consumer thread only; returns false if the queue is empty:
+	bool pop(T *value) {
+		uint32_t h = head.load(std::memory_order_relaxed);
+		if (h == tail.load(std::memory_order_acquire)) return false;
+		*value = items[h & (Capacity - 1)];
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	//items waiting (exact from the producer's or consumer's point of view, a snapshot from anywhere else):
+	uint32_t size() const {
+		//(head first: tail never falls behind a head read earlier)
+		uint32_t h = head.load(std::memory_order_acquire);
+		uint32_t t = tail.load(std::memory_order_acquire);
+		return t - h;
+	}
+
+	std::array< T, Capacity > items;
+	alignas(64) std::atomic< uint32_t > head{0}; //next item to pop (written by consumer)
+	alignas(64) std::atomic< uint32_t > tail{0}; //next item to push (written by producer)
+};
@@ -0,0 +1,74 @@
+#include "TickScheduler.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+TickScheduler::TickScheduler(float step_, Mode mode_) : step(step_), mode(mode_) {
+	assert(step > 0.0f);
+	step_duration = std::chrono::duration_cast< Clock::duration >(std::chrono::duration< float >(step));
+	start();
+}
+
+void TickScheduler::start() {
+	simulated = Clock::now();
+	next = simulated + step_duration;
+}
+
+uint32_t TickScheduler::due() {
+	if (mode == Mode::Accelerated) return 1;
+
+	Clock::time_point now = Clock::now();
+	if (now < next) return 0;
+
+	//the tick at 'next' is due, plus any whole steps since:
+	uint64_t behind = uint64_t((now - next) / step_duration) + 1;
+	if (behind > MaxCatchUp) {
+		//too far behind to catch up without stalling everything else; skip the oldest:
+		stats.dropped += behind - MaxCatchUp;
+		next += step_duration * (behind - MaxCatchUp);
+		behind = MaxCatchUp;
+	}
+	return uint32_t(behind);
+}
+
+double TickScheduler::wait() const {
+	if (mode == Mode::Accelerated) return 0.0;
+	return std::max(0.0, std::chrono::duration< double >(next - Clock::now()).count());
+}
+
+void TickScheduler::begin_tick() {
+	Clock::time_point scheduled = next;
+	next += step_duration;
+	tick += 1;
+	stats.ticks += 1;
+
+	if (mode == Mode::Accelerated) {
+		simulated = scheduled;
+	} else {
+		behind = (Clock::now() >= next);
+		if (behind) stats.late += 1;
+	}
+}
+
+void TickScheduler::end_tick() {
+	if (mode == Mode::Accelerated) return;
+
+	//(a tick that started behind is catching up from an earlier overrun, which was already counted)
+	Clock::time_point now = Clock::now();
+	if (now > next && !behind) {
+		double over = std::chrono::duration< double >(now - next).count();
+		stats.overruns += 1;
+		stats.overrun_seconds += over;
+		stats.max_overrun_seconds = std::max(stats.max_overrun_seconds, over);
+	}
+}
+
+TickScheduler::Clock::time_point TickScheduler::now() const {
+	if (mode == Mode::Accelerated) return simulated;
+	return Clock::now();
+}
+
+float TickScheduler::phase() const {
+	float since = std::chrono::duration< float >(now() - (next - step_duration)).count();
+	return std::clamp(since / step, 0.0f, 1.0f);
+}
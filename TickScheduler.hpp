@@ -0,0 +1,83 @@
+#pragma once
+
+/*
+ * TickScheduler decides when a fixed-timestep loop runs its ticks.
+ *
+ * Tick n is due at start + n * step, rather than one step after tick n-1
+ * happened to finish, so a late tick doesn't push back every tick after it.
+ * When the loop falls behind, due() has it run the missed ticks back-to-back
+ * (at most MaxCatchUp at a time); a backlog bigger than that is dropped and
+ * counted, rather than snowballing.
+ *
+ * In Accelerated mode nothing waits: every tick is due as soon as the last one
+ * is done, and now() reports simulated time (start + ticks * step) -- for
+ * offline simulation and benchmarks.
+ *
+ * Usage:
+ *   TickScheduler scheduler(Game::Tick);
+ *   scheduler.start();
+ *   while (running) {
+ *     uint32_t steps = scheduler.due();
+ *     if (steps == 0) server.poll(on_event, scheduler.wait()); //(handle messages until the next tick)
+ *     for (uint32_t s = 0; s < steps; ++s) {
+ *       scheduler.begin_tick();
+ *       game.update(scheduler.step);
+ *       scheduler.end_tick();
+ *     }
+ *   }
+ */
+
+#include <chrono>
+#include <cstdint>
+
+struct TickScheduler {
+	using Clock = std::chrono::steady_clock;
+
+	enum class Mode : uint8_t {
+		RealTime, //ticks are due every 'step' seconds of wall-clock time
+		Accelerated, //ticks are due as soon as the previous one is done
+	};
+
+	TickScheduler(float step, Mode mode = Mode::RealTime);
+
+	//(re)start the schedule; the first tick is due one step from now:
+	void start();
+
+	//number of ticks to run now (0 => none due yet):
+	uint32_t due();
+	//seconds until the next tick is due (0 if one is due already, and always 0 in Accelerated mode):
+	double wait() const;
+
+	//call around each tick's work:
+	void begin_tick();
+	void end_tick();
+
+	//current time (simulated time -- the start of the current tick -- in Accelerated mode):
+	Clock::time_point now() const;
+	//how far now() is between the last tick's scheduled time and the next one's, in [0,1]:
+	// (e.g., so message handlers can tell when during a tick a message arrived)
+	float phase() const;
+
+	float step; //seconds per tick
+	Mode mode;
+
+	//most ticks run back-to-back to catch up; if further behind than this, the rest are dropped:
+	inline static constexpr uint32_t MaxCatchUp = 4;
+
+	uint64_t tick = 0; //number of the current (or, between ticks, the most recent) tick; counts from 1
+
+	struct Stats {
+		uint64_t ticks = 0; //ticks run
+		uint64_t late = 0; //ticks that started a whole step or more after they were due (i.e., were catching up)
+		uint64_t dropped = 0; //ticks skipped because the loop fell more than MaxCatchUp behind
+		uint64_t overruns = 0; //ticks that started on time but were still running when the next tick was due (i.e., stalls; the catch-up ticks after one aren't counted again)
+		double overrun_seconds = 0.0; //total time overrunning ticks ran past the next tick's due time
+		double max_overrun_seconds = 0.0;
+	} stats;
+
+private:
+	Clock::duration step_duration;
+	Clock::time_point next; //when the next tick is due
+	Clock::time_point simulated; //(Accelerated mode) due time of the current tick
+	bool behind = false; //did the current tick start after the next one was due?
+};
@@ -0,0 +1,2235 @@
+//Offline benchmarks for the networking and simulation code.
+// Each benchmark is a named sub-command; run with no arguments for a list.
+
+#include "Connection.hpp"
+#include "Game.hpp"
+#include "Log.hpp"
+#include "Metrics.hpp"
+#include "NetSim.hpp"
+#include "Profiler.hpp"
+#include "Scene.hpp"
+#include "Shard.hpp"
+#include "Smoothing.hpp"
+#include "TickScheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <iomanip>
+#include <iterator>
+#include <stdexcept>
+#include <memory>
+#include <new>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#include <sys/select.h>
+#include <unistd.h>
+#endif
+
+//silences std::cout/std::cerr chatter (e.g., per-connection logging) for the lifetime of the object:
+struct Quiet {
+	Quiet() : out(std::cout.rdbuf(nullptr)), err(std::cerr.rdbuf(nullptr)) { }
+	~Quiet() {
+		std::cout.rdbuf(out);
+		std::cerr.rdbuf(err);
+	}
+	std::streambuf *out, *err;
+};
+
+//helper: microseconds since some earlier time point:
+static double us_since(std::chrono::steady_clock::time_point const &before) {
+	return std::chrono::duration< double, std::micro >(std::chrono::steady_clock::now() - before).count();
+}
+
+//every heap allocation in this program goes through here and is counted (e.g., to check that a code path doesn't allocate):
+// (the array and nothrow forms of new call this one, and of delete the plain one)
+// (kept out of line, so gcc doesn't see malloc() pointers going to operator delete / new pointers to free() and warn)
+#if defined(__GNUC__)
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif
+static std::atomic< uint64_t > allocations{0};
+BENCH_NOINLINE void *operator new(std::size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void *ptr = std::malloc(size ? size : 1)) return ptr;
+	throw std::bad_alloc();
+}
+BENCH_NOINLINE void operator delete(void *ptr) noexcept {
+	std::free(ptr);
+}
+BENCH_NOINLINE void operator delete(void *ptr, std::size_t) noexcept {
+	std::free(ptr);
+}
+
+//----------------------------------------------
+//poll: latency of Server::poll vs. number of connected loopback clients, for each PollBackend
+
+static int bench_poll(std::vector< std::string > const &args) {
+	std::vector< uint32_t > counts;
+	for (auto const &arg : args) counts.emplace_back(uint32_t(std::stoul(arg)));
+	if (counts.empty()) counts = {1, 16, 64, 256, 480, 1000, 4000};
+
+	#ifndef _WIN32
+	{ //each client uses two sockets in this process, so raise the open file limit as far as allowed:
+		struct rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+			limit.rlim_cur = limit.rlim_max;
+			setrlimit(RLIMIT_NOFILE, &limit);
+			std::cout << "(open file limit: " << limit.rlim_cur << ")" << std::endl;
+		}
+	}
+	#endif
+
+	std::vector< std::pair< PollBackend, char const * > > backends{
+		{PollBackend::Select, "select"},
+	};
+	#ifdef __linux__
+	backends.emplace_back(PollBackend::Epoll, "epoll");
+	#endif
+
+	constexpr uint32_t Rounds = 2000;
+	std::mt19937 mt(0x15466);
+	uint32_t port = 15466;
+
+	std::cout << std::setw(8) << "backend" << std::setw(8) << "clients"
+		<< std::setw(14) << "idle (us)" << std::setw(14) << "active (us)" << std::setw(16) << "send+close seen" << std::endl;
+	bool ok = true;
+
+	for (auto const &[backend, backend_name] : backends) {
+		for (uint32_t count : counts) {
+			#ifndef _WIN32
+			if (backend == PollBackend::Select && 2 * count + 8 >= FD_SETSIZE) {
+				std::cout << std::setw(8) << backend_name << std::setw(8) << count << "  (skipped: exceeds FD_SETSIZE)" << std::endl;
+				continue;
+			}
+			#endif
+
+			std::string port_str = std::to_string(port++);
+			std::unique_ptr< Server > server;
+			std::vector< std::unique_ptr< Client > > clients;
+			try {
+				Quiet quiet;
+				server = std::make_unique< Server >(port_str, backend);
+				clients.reserve(count);
+				while (clients.size() < count) {
+					clients.emplace_back(std::make_unique< Client >("localhost", port_str, backend));
+					server->poll(nullptr, 0.0);
+				}
+				while (server->connections.size() < count) {
+					server->poll(nullptr, 0.01);
+				}
+			} catch (std::exception const &e) {
+				std::cout << std::setw(8) << backend_name << std::setw(8) << count << "  (failed: " << e.what() << ")" << std::endl;
+				break;
+			}
+
+			uint32_t received = 0, closes = 0;
+			auto on_event = [&](Connection *c, Connection::Event evt) {
+				if (evt == Connection::OnRecv) {
+					received += uint32_t(c->recv_buffer.size());
+					c->recv_buffer.clear();
+				} else if (evt == Connection::OnClose) {
+					closes += 1;
+				}
+			};
+
+			//idle: nothing is ready, so this is pure bookkeeping overhead:
+			double idle_us = 0.0;
+			for (uint32_t r = 0; r < Rounds; ++r) {
+				auto before = std::chrono::steady_clock::now();
+				server->poll(on_event, 0.0);
+				idle_us += us_since(before);
+			}
+
+			//active: one random client sent a byte; time until the server has it:
+			double active_us = 0.0;
+			for (uint32_t r = 0; r < Rounds; ++r) {
+				Client &client = *clients[mt() % clients.size()];
+				client.connection.send(uint8_t(r));
+				client.poll(nullptr, 0.0);
+
+				uint32_t target = received + 1;
+				auto before = std::chrono::steady_clock::now();
+				while (received < target) {
+					server->poll(on_event, 0.1);
+				}
+				active_us += us_since(before);
+			}
+
+			//hangup: a client sends a little and closes right away, so the data and the FIN may arrive together:
+			// (the server should notice the close without having to write to the connection)
+			bool hangup_seen = false;
+			{
+				Quiet quiet;
+				Client &client = *clients.back();
+				for (uint32_t i = 0; i < 10; ++i) client.connection.send(uint8_t(i));
+				client.poll(nullptr, 0.0);
+				client.connection.close();
+				auto before = std::chrono::steady_clock::now();
+				while (!(closes == 1 && server->connections.size() + 1 == count) && us_since(before) < 1e6) {
+					server->poll(on_event, 0.01);
+				}
+				hangup_seen = (closes == 1 && server->connections.size() + 1 == count);
+			}
+
+			std::cout << std::setw(8) << backend_name << std::setw(8) << count
+				<< std::setw(14) << std::fixed << std::setprecision(2) << (idle_us / Rounds)
+				<< std::setw(14) << std::fixed << std::setprecision(2) << (active_us / Rounds)
+				<< std::setw(16) << (hangup_seen ? "yes" : "NO") << std::endl;
+			if (!hangup_seen) {
+				std::cout << "  FAILED: the server didn't notice a client that sent data and closed." << std::endl;
+				ok = false;
+			}
+
+			{ //teardown:
+				Quiet quiet;
+				for (auto &client : clients) {
+					client->connection.close();
+				}
+				for (auto &c : server->connections) {
+					c.close();
+				}
+				Connection listener;
+				listener.socket = server->listen_socket;
+				listener.close();
+			}
+		}
+	}
+
+	return (ok ? 0 : 1);
+}
+
+//----------------------------------------------
+//state: S2C_State bytes per tick per client, full keyframes vs. deltas against per-client baselines
+
+//randomly hold/release movement buttons, as if players were wandering around:
+static void wander(Game &game, std::mt19937 &mt) {
+	for (auto &controls : game.players.controls) {
+		if (mt() % 8 != 0) continue;
+		controls.left.pressed = (mt() % 3 == 0);
+		controls.right.pressed = (mt() % 3 == 0);
+		controls.up.pressed = (mt() % 3 == 0);
+		controls.down.pressed = (mt() % 3 == 0);
+	}
+}
+
+static int bench_state(std::vector< std::string > const &args) {
+	std::vector< uint32_t > counts;
+	for (auto const &arg : args) counts.emplace_back(uint32_t(std::stoul(arg)));
+	if (counts.empty()) counts = {2, 16, 128};
+
+	constexpr uint32_t Ticks = 300;
+
+	std::cout << std::setw(8) << "players" << std::setw(16) << "full (B/tick)" << std::setw(16) << "delta (B/tick)" << std::setw(8) << "ratio"
+		<< std::setw(18) << "per-client (us)" << std::setw(16) << "broadcast (us)"
+		<< std::setw(14) << "max pos err" << std::setw(14) << "max vel err" << std::endl;
+
+	for (uint32_t count : counts) {
+		Game game;
+		std::vector< PlayerHandle > players; //players[i] is controlled by client i
+		std::vector< Game::StateBaseline > baselines(count); //for deltas encoded per client
+		std::vector< Game::StateBaseline > shared_baselines(count); //for deltas from 'broadcast'
+		Game::StateBroadcast broadcast;
+		for (uint32_t i = 0; i < count; ++i) {
+			players.emplace_back(game.spawn_player());
+		}
+		std::mt19937 mt(count);
+
+		//unconnected connections just accumulate what would be sent:
+		Connection full, delta, shared;
+		//client 0's view of the game, rebuilt from its per-client / broadcast delta messages:
+		Game client, shared_client;
+		Connection to_client, to_shared_client;
+
+		uint64_t full_bytes = 0, delta_bytes = 0;
+		double per_client_us = 0.0, broadcast_us = 0.0;
+		float max_position_error = 0.0f, max_velocity_error = 0.0f;
+
+		//(time one tick's sends to every client)
+		auto send_all = [&](Connection &to, std::vector< Game::StateBaseline > &bases, Game::StateBroadcast *cast, Game &client, Connection &to_client) {
+			auto before = std::chrono::steady_clock::now();
+			if (cast) cast->prepare(game);
+			for (uint32_t i = 0; i < count; ++i) {
+				game.send_state_message(&to, players[i], &bases[i], cast);
+				if (i == 0) {
+					//(client 0's message is first in the buffer)
+					std::vector< uint8_t > bytes = to.send_buffer.bytes();
+					to_client.recv_buffer.append(bytes.data(), bytes.size());
+				}
+			}
+			double us = us_since(before);
+			if (!client.recv_state_message(&to_client) || client.needs_keyframe) {
+				throw std::runtime_error("Client failed to apply state message.");
+			}
+			uint64_t bytes = to.send_buffer.size();
+			to.send_buffer.clear();
+			return std::make_pair(us, bytes);
+		};
+
+		//check a client's reconstruction against the server's state:
+		auto check = [&](Game const &client) {
+			if (client.players.size() != game.players.size()) {
+				throw std::runtime_error("Client has " + std::to_string(client.players.size()) + " players, server has " + std::to_string(game.players.size()) + ".");
+			}
+			for (uint32_t slot = 0; slot < game.players.handles.slots.size(); ++slot) { //(client uses the same slots as the server)
+				uint32_t index = game.players.handles.slots[slot].dense;
+				if (index == SlotIndex::Free) continue;
+				if (slot >= client.players.handles.slots.size() || client.players.handles.slots[slot].dense == SlotIndex::Free) {
+					throw std::runtime_error("Client is missing the player in slot " + std::to_string(slot) + ".");
+				}
+				Player c = client.players.get(client.players.handles.slots[slot].dense);
+				Player player = game.players.get(index);
+				//(quantized state messages send colors with 8 bits per channel)
+				float color_error = std::max({std::abs(c.color.r - player.color.r), std::abs(c.color.g - player.color.g), std::abs(c.color.b - player.color.b)});
+				if (c.id != player.id || c.name != player.name || color_error > (game.quantized_state ? 0.5f / 255.0f + 1e-6f : 0.0f)) {
+					throw std::runtime_error("Client player " + std::to_string(c.id) + " doesn't match server player " + std::to_string(player.id) + ".");
+				}
+				max_position_error = std::max({max_position_error, std::abs(c.position.x - player.position.x), std::abs(c.position.y - player.position.y)});
+				max_velocity_error = std::max({max_velocity_error, std::abs(c.velocity.x - player.velocity.x), std::abs(c.velocity.y - player.velocity.y)});
+			}
+		};
+
+		for (uint32_t tick = 0; tick < Ticks; ++tick) {
+			//every so often, some client (other than client 0) leaves and another joins in its place:
+			if (tick % 10 == 5 && count > 1) {
+				uint32_t i = 1 + mt() % (count - 1);
+				game.remove_player(players[i]);
+				players[i] = game.spawn_player();
+				baselines[i] = Game::StateBaseline();
+				shared_baselines[i] = Game::StateBaseline();
+			}
+
+			wander(game, mt);
+			game.update(Game::Tick);
+
+			for (uint32_t i = 0; i < count; ++i) {
+				game.send_state_message(&full, players[i]);
+				full_bytes += full.send_buffer.size();
+				full.send_buffer.clear();
+			}
+
+			auto [us, bytes] = send_all(delta, baselines, nullptr, client, to_client);
+			per_client_us += us;
+			delta_bytes += bytes;
+
+			broadcast_us += send_all(shared, shared_baselines, &broadcast, shared_client, to_shared_client).first; //(same bytes, give or take a keyframe)
+
+			check(client);
+			check(shared_client);
+		}
+
+		double full_per = double(full_bytes) / double(Ticks * count);
+		double delta_per = double(delta_bytes) / double(Ticks * count);
+		std::cout << std::setw(8) << count
+			<< std::setw(16) << std::fixed << std::setprecision(1) << full_per
+			<< std::setw(16) << std::fixed << std::setprecision(1) << delta_per
+			<< std::setw(8) << std::fixed << std::setprecision(2) << (full_per / delta_per)
+			<< std::setw(18) << std::fixed << std::setprecision(2) << per_client_us / Ticks
+			<< std::setw(16) << std::fixed << std::setprecision(2) << broadcast_us / Ticks
+			<< std::setw(14) << std::scientific << std::setprecision(2) << max_position_error
+			<< std::setw(14) << std::scientific << std::setprecision(2) << max_velocity_error
+			<< std::defaultfloat << std::endl;
+	}
+	std::cout << "(per-client: players encoded for each client; broadcast: encoded once per tick, shared by every client; both checked against client 0's reconstruction)" << std::endl;
+	std::cout << "(quantization: position " << Game::PositionQuantum << ", velocity " << Game::VelocityQuantum << ")" << std::endl;
+
+	return 0;
+}
+
+//----------------------------------------------
+//quantize: S2C_State bytes per player with float vs. quantized (fixed-point) encoding, and checks of the quantized encoding's error bounds
+
+static int bench_quantize(std::vector< std::string > const &args) {
+	std::vector< uint32_t > counts;
+	for (auto const &arg : args) counts.emplace_back(uint32_t(std::stoul(arg)));
+	if (counts.empty()) counts = {2, 16, 128};
+
+	constexpr uint32_t Ticks = 300;
+
+	std::cout << std::setw(8) << "players" << std::setw(12) << "encoding" << std::setw(20) << "keyframe (B/player)" << std::setw(18) << "delta (B/player)"
+		<< std::setw(14) << "max pos err" << std::setw(14) << "max vel err" << std::endl;
+
+	for (uint32_t count : counts) {
+		for (bool quantized : {false, true}) {
+			Game game;
+			game.quantized_state = quantized;
+			std::vector< PlayerHandle > players;
+			for (uint32_t i = 0; i < count; ++i) players.emplace_back(game.spawn_player());
+			std::mt19937 mt(count);
+
+			Connection keyframes, deltas, to_client;
+			Game::StateBaseline baseline;
+			Game client; //(client 0, from deltas)
+			uint64_t keyframe_bytes = 0, delta_bytes = 0, player_ticks = 0;
+			float max_position_error = 0.0f, max_velocity_error = 0.0f;
+
+			for (uint32_t tick = 0; tick < Ticks; ++tick) {
+				if (tick % 10 == 5 && count > 1) {
+					uint32_t i = 1 + mt() % (count - 1);
+					game.remove_player(players[i]);
+					players[i] = game.spawn_player();
+				}
+				wander(game, mt);
+				game.update(Game::Tick);
+
+				game.send_state_message(&keyframes, players[0]);
+				keyframe_bytes += keyframes.send_buffer.size();
+				keyframes.send_buffer.clear();
+
+				game.send_state_message(&deltas, players[0], &baseline);
+				delta_bytes += deltas.send_buffer.size();
+				std::vector< uint8_t > bytes = deltas.send_buffer.bytes();
+				deltas.send_buffer.clear();
+				to_client.recv_buffer.append(bytes.data(), bytes.size());
+				if (!client.recv_state_message(&to_client) || client.needs_keyframe) {
+					throw std::runtime_error("Client failed to apply state message.");
+				}
+				player_ticks += game.players.size();
+
+				for (uint32_t i = 0; i < game.players.size(); ++i) {
+					uint32_t c = client.players.find_id(game.players.id[i]);
+					if (c == client.players.size()) throw std::runtime_error("Client is missing a player.");
+					glm::vec2 dp = client.players.position(c) - game.players.position(i);
+					glm::vec2 dv = client.players.velocity(c) - game.players.velocity(i);
+					max_position_error = std::max({max_position_error, std::abs(dp.x), std::abs(dp.y)});
+					max_velocity_error = std::max({max_velocity_error, std::abs(dv.x), std::abs(dv.y)});
+				}
+			}
+
+			std::cout << std::setw(8) << count << std::setw(12) << (quantized ? "quantized" : "float") << std::fixed
+				<< std::setw(20) << std::setprecision(1) << double(keyframe_bytes) / double(player_ticks)
+				<< std::setw(18) << std::setprecision(1) << double(delta_bytes) / double(player_ticks)
+				<< std::scientific << std::setprecision(2)
+				<< std::setw(14) << max_position_error << std::setw(14) << max_velocity_error
+				<< std::defaultfloat << std::endl;
+		}
+	}
+	std::cout << "(per player per tick, message overhead included; delta errors are the client's reconstruction vs. the server's state)" << std::endl;
+
+	//error bounds: one player on each of the 65535 positions along each axis, with velocities/colors all over (and past) their ranges:
+	constexpr uint32_t Count = 65535; //(most entries a state message can hold)
+	glm::vec2 position_step = (Game::ArenaMax - Game::ArenaMin) / 65535.0f;
+	float velocity_step = 2.0f * Game::VelocityLimit / 65535.0f;
+	//half a step, plus float rounding:
+	float x_bound = 0.5f * position_step.x + 1e-6f, y_bound = 0.5f * position_step.y + 1e-6f;
+	float velocity_bound = 0.5f * velocity_step + 1e-6f, color_bound = 0.5f / 255.0f + 1e-6f;
+
+	Game game;
+	game.quantized_state = true;
+	std::mt19937 mt(0x15466);
+	auto uniform = [&](float lo, float hi) { return std::uniform_real_distribution< float >(lo, hi)(mt); };
+	for (uint32_t i = 0; i < Count; ++i) {
+		game.spawn_player();
+		float t = float(i) / float(Count - 1); //(so along x the players cover every grid point but the last, and along y every one but the first)
+		game.players.set_position(i, glm::vec2(
+			glm::mix(Game::ArenaMin.x, Game::ArenaMax.x, t) + uniform(-0.5f, 0.5f) * position_step.x,
+			glm::mix(Game::ArenaMax.y, Game::ArenaMin.y, t) + uniform(-0.5f, 0.5f) * position_step.y));
+		game.players.set_velocity(i, glm::vec2(uniform(-Game::VelocityLimit, Game::VelocityLimit), uniform(-Game::VelocityLimit, Game::VelocityLimit)));
+		game.players.color[i] = glm::vec3(uniform(0.0f, 1.0f), uniform(0.0f, 1.0f), uniform(0.0f, 1.0f));
+	}
+	game.players.set_position(0, Game::ArenaMin); //(the very corners)
+	game.players.set_position(Count - 1, Game::ArenaMax);
+
+	//one client follows the broadcast from its first keyframe; one joins later, and gets a keyframe re-encoded from the snapshot:
+	Game::StateBroadcast broadcast;
+	Game::StateBaseline first_baseline, late_baseline;
+	Game first, late;
+	Connection out, to_first, to_late;
+	auto deliver = [&](Game::StateBaseline *baseline, Game *client, Connection *to) {
+		game.send_state_message(&out, PlayerHandle(), baseline, &broadcast);
+		std::vector< uint8_t > bytes = out.send_buffer.bytes();
+		out.send_buffer.clear();
+		to->recv_buffer.append(bytes.data(), bytes.size());
+		if (!client->recv_state_message(to) || client->needs_keyframe) throw std::runtime_error("Client failed to apply state message.");
+	};
+
+	bool ok = true;
+	float max_x = 0.0f, max_y = 0.0f, max_velocity = 0.0f, max_color = 0.0f;
+	broadcast.prepare(game);
+	deliver(&first_baseline, &first, &to_first);
+	for (uint32_t i = 0; i < Count; ++i) {
+		uint32_t c = first.players.find_id(game.players.id[i]);
+		glm::vec2 dp = first.players.position(c) - game.players.position(i);
+		glm::vec2 dv = first.players.velocity(c) - game.players.velocity(i);
+		glm::vec3 const &color = first.players.color[c], &actual = game.players.color[i];
+		max_x = std::max(max_x, std::abs(dp.x));
+		max_y = std::max(max_y, std::abs(dp.y));
+		max_velocity = std::max({max_velocity, std::abs(dv.x), std::abs(dv.y)});
+		max_color = std::max({max_color, std::abs(color.r - actual.r), std::abs(color.g - actual.g), std::abs(color.b - actual.b)});
+	}
+	ok = ok && max_x <= x_bound && max_y <= y_bound && max_velocity <= velocity_bound && max_color <= color_bound;
+
+	//everyone moves (some a long way, so their changes don't fit in a delta; some past the velocity limit, and get clamped):
+	for (uint32_t i = 0; i < Count; ++i) {
+		glm::vec2 position = game.players.position(i);
+		if (i % 97 == 0) position = glm::vec2(uniform(Game::ArenaMin.x, Game::ArenaMax.x), uniform(Game::ArenaMin.y, Game::ArenaMax.y));
+		else position += glm::vec2(uniform(-0.1f, 0.1f), uniform(-0.1f, 0.1f));
+		game.players.set_position(i, glm::clamp(position, Game::ArenaMin, Game::ArenaMax));
+		game.players.set_velocity(i, glm::vec2(uniform(-1.5f, 1.5f), uniform(-1.5f, 1.5f)) * Game::VelocityLimit);
+		if (i % 13 == 0) game.players.color[i] = glm::vec3(uniform(0.0f, 1.0f), uniform(0.0f, 1.0f), uniform(0.0f, 1.0f));
+	}
+	broadcast.prepare(game);
+	deliver(&first_baseline, &first, &to_first); //(a delta)
+	deliver(&late_baseline, &late, &to_late); //(a keyframe of the snapshot the delta leads to)
+
+	//both should now have exactly what the server thinks they have:
+	auto exact = [&](Game const &client) {
+		Game::PlayersSnapshot const &snapshot = *broadcast.current;
+		for (size_t i = 0; i < snapshot.players.size(); ++i) {
+			uint32_t c = client.players.handles.slots[snapshot.slots[i]].dense;
+			Player const &expected = snapshot.players[i];
+			if (client.players.id[c] != expected.id || client.players.position(c) != expected.position
+			 || client.players.velocity(c) != expected.velocity || client.players.color[c] != expected.color) return false;
+		}
+		return client.players.size() == snapshot.players.size();
+	};
+	bool delta_exact = exact(first), keyframe_exact = exact(late);
+	ok = ok && delta_exact && keyframe_exact;
+
+	std::cout << "quantization error over " << Count << " players (bound: half a step):" << std::scientific << std::setprecision(3)
+		<< "\n  position x " << max_x << " (bound " << x_bound << "), y " << max_y << " (bound " << y_bound << ")"
+		<< "\n  velocity " << max_velocity << " (bound " << velocity_bound << ", within +/- " << std::defaultfloat << Game::VelocityLimit << ")"
+		<< std::scientific << "\n  color " << max_color << " (bound " << color_bound << ")" << std::defaultfloat
+		<< "\n  after a delta, client matches server's record exactly: " << (delta_exact ? "yes" : "NO")
+		<< "\n  keyframe re-encoded from that record reproduces it exactly: " << (keyframe_exact ? "yes" : "NO") << std::endl;
+
+	if (!ok) {
+		std::cerr << "Quantized state encoding is outside its error bounds." << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+//----------------------------------------------
+//parse: client-side cost of applying S2C_State messages, and heap allocations per message once the player list is steady
+
+static int bench_parse(std::vector< std::string > const &args) {
+	std::vector< uint32_t > counts;
+	for (auto const &arg : args) counts.emplace_back(uint32_t(std::stoul(arg)));
+	if (counts.empty()) counts = {2, 16, 128};
+
+	constexpr uint32_t ChurnTicks = 100; //players come and go (checking the client keeps up)
+	constexpr uint32_t SteadyTicks = 300; //same players throughout (measured)
+
+	std::cout << std::setw(8) << "players" << std::setw(14) << "delta (B)" << std::setw(14) << "delta (us)" << std::setw(14) << "delta allocs"
+		<< std::setw(14) << "keyframe (B)" << std::setw(14) << "keyframe (us)" << std::setw(16) << "keyframe allocs" << std::endl;
+
+	bool allocated = false;
+	for (uint32_t count : counts) {
+		Game game;
+		std::vector< PlayerHandle > players;
+		std::mt19937 mt(count);
+		//(names long enough to live on the heap, rather than inside std::string)
+		auto spawn = [&]() {
+			PlayerHandle player = game.spawn_player();
+			uint32_t index = game.players.find(player);
+			game.players.name[index] = "Player " + std::to_string(game.players.id[index]) + " has a rather long name";
+			return player;
+		};
+		for (uint32_t i = 0; i < count; ++i) players.emplace_back(spawn());
+
+		//client 0's view of the game, from deltas over a connection / from keyframes as datagrams:
+		Game delta_client, keyframe_client;
+		Game::StateBaseline delta_baseline, keyframe_baseline;
+		keyframe_baseline.deltas = false;
+		Connection out, to_delta_client;
+
+		struct Measured {
+			uint64_t bytes = 0;
+			double us = 0.0;
+			uint64_t allocations = 0;
+		} delta, keyframe;
+
+		auto check = [&](Game const &client) {
+			if (client.players.size() != game.players.size()) throw std::runtime_error("Client has the wrong number of players.");
+			for (uint32_t slot = 0; slot < game.players.handles.slots.size(); ++slot) {
+				uint32_t index = game.players.handles.slots[slot].dense;
+				if (index == SlotIndex::Free) continue;
+				if (slot >= client.players.handles.slots.size() || client.players.handles.slots[slot].dense == SlotIndex::Free) {
+					throw std::runtime_error("Client is missing the player in slot " + std::to_string(slot) + ".");
+				}
+				uint32_t c = client.players.handles.slots[slot].dense;
+				if (client.players.id[c] != game.players.id[index] || client.players.name[c] != game.players.name[index]
+				 || glm::length(client.players.position(c) - game.players.position(index)) > 0.01f) {
+					throw std::runtime_error("Client player " + std::to_string(client.players.id[c]) + " doesn't match the server's.");
+				}
+			}
+		};
+
+		for (uint32_t tick = 0; tick < ChurnTicks + SteadyTicks; ++tick) {
+			bool measure = (tick >= ChurnTicks);
+			if (!measure && tick % 10 == 5 && count > 1) {
+				uint32_t i = 1 + mt() % (count - 1);
+				game.remove_player(players[i]);
+				players[i] = spawn();
+			}
+			wander(game, mt);
+			game.update(Game::Tick);
+
+			game.send_state_message(&out, players[0], &delta_baseline);
+			std::vector< uint8_t > bytes = out.send_buffer.bytes();
+			out.send_buffer.clear();
+			to_delta_client.recv_buffer.append(bytes.data(), bytes.size());
+			uint64_t before_allocations = allocations;
+			auto before = std::chrono::steady_clock::now();
+			if (!delta_client.recv_state_message(&to_delta_client) || delta_client.needs_keyframe) {
+				throw std::runtime_error("Client failed to apply delta state message.");
+			}
+			if (measure) {
+				delta.us += us_since(before);
+				delta.allocations += allocations - before_allocations;
+				delta.bytes += bytes.size();
+			}
+
+			game.send_state_message(&out, players[0], &keyframe_baseline);
+			bytes = out.send_buffer.bytes();
+			out.send_buffer.clear();
+			before_allocations = allocations;
+			before = std::chrono::steady_clock::now();
+			if (!keyframe_client.recv_state_datagram(bytes.data(), bytes.size())) {
+				throw std::runtime_error("Client failed to apply keyframe state message.");
+			}
+			if (measure) {
+				keyframe.us += us_since(before);
+				keyframe.allocations += allocations - before_allocations;
+				keyframe.bytes += bytes.size();
+			}
+
+			check(delta_client);
+			check(keyframe_client);
+		}
+		allocated = allocated || delta.allocations != 0 || keyframe.allocations != 0;
+
+		//a state message cut short anywhere is rejected without changing the client's state:
+		// (a keyframe after a player has been replaced, so applying it would remove and add players as well as update them)
+		if (count > 1) {
+			game.remove_player(players[1]);
+			players[1] = spawn();
+		}
+		wander(game, mt);
+		game.update(Game::Tick);
+		game.send_state_message(&out, players[0], &keyframe_baseline);
+		std::vector< uint8_t > bytes = out.send_buffer.bytes();
+		out.send_buffer.clear();
+		Game::Players const before = keyframe_client.players;
+		auto unchanged = [&](Game::Players const &after) {
+			if (after.id != before.id || after.name != before.name || after.position_x != before.position_x || after.position_y != before.position_y
+			 || after.velocity_x != before.velocity_x || after.velocity_y != before.velocity_y || after.color != before.color) return false;
+			if (after.handles.slots.size() != before.handles.slots.size()) return false;
+			for (uint32_t slot = 0; slot < after.handles.slots.size(); ++slot) {
+				if (after.handles.slots[slot].dense != before.handles.slots[slot].dense) return false;
+			}
+			return true;
+		};
+		for (uint32_t size = 0; Schema::HeaderSize + size < bytes.size(); ++size) {
+			bool rejected = false;
+			try {
+				keyframe_client.recv_state_payload(bytes.data() + Schema::HeaderSize, size);
+			} catch (std::runtime_error const &) {
+				rejected = true;
+			}
+			if (!rejected || !unchanged(keyframe_client.players)) {
+				throw std::runtime_error("A state message cut to " + std::to_string(size) + " bytes of payload " + (rejected ? "changed the client's players." : "wasn't rejected."));
+			}
+		}
+		if (!keyframe_client.recv_state_datagram(bytes.data(), bytes.size())) throw std::runtime_error("Client failed to apply keyframe state message.");
+		check(keyframe_client);
+
+		std::cout << std::setw(8) << count << std::fixed
+			<< std::setw(14) << std::setprecision(1) << delta.bytes / double(SteadyTicks)
+			<< std::setw(14) << std::setprecision(2) << delta.us / SteadyTicks
+			<< std::setw(14) << std::setprecision(2) << delta.allocations / double(SteadyTicks)
+			<< std::setw(14) << std::setprecision(1) << keyframe.bytes / double(SteadyTicks)
+			<< std::setw(14) << std::setprecision(2) << keyframe.us / SteadyTicks
+			<< std::setw(16) << std::setprecision(2) << keyframe.allocations / double(SteadyTicks)
+			<< std::defaultfloat << std::endl;
+	}
+	std::cout << "(per message, after " << ChurnTicks << " ticks of players coming and going (checked against the server) and then "
+		<< SteadyTicks << " with the same players; keyframes are what datagram clients get every tick; every truncation of a keyframe was rejected without changing the client)" << std::endl;
+	if (allocated) {
+		std::cerr << "Applying state messages allocated memory with a steady player list." << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
+
+//----------------------------------------------
+//schema: messages sent/received with MessageSchema vs. written out by hand (as Game.cpp did before), checking they agree byte-for-byte
+
+//send 'SchemaBatch' messages with 'send', then receive them all with 'recv':
+// (through 'out' and 'in', reused so their buffers are already allocated; adds the ns per message each took to send_ns and recv_ns, and returns the bytes of the batch)
+static constexpr uint32_t SchemaBatch = 1000;
+template< typename Send, typename Recv >
+static void time_batch(Connection &out, Connection &in, Send const &send, Recv const &recv, std::vector< double > *send_ns, std::vector< double > *recv_ns, std::vector< uint8_t > *batch_bytes) {
+	out.send_buffer.clear();
+	auto before = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < SchemaBatch; ++i) send(&out, i);
+	send_ns->emplace_back(us_since(before) * 1000.0 / SchemaBatch);
+
+	*batch_bytes = out.send_buffer.bytes();
+	in.recv_buffer.clear();
+	in.recv_buffer.append(batch_bytes->data(), batch_bytes->size());
+	before = std::chrono::steady_clock::now();
+	for (uint32_t i = 0; i < SchemaBatch; ++i) {
+		if (!recv(&in)) throw std::runtime_error("Message didn't come back out.");
+	}
+	recv_ns->emplace_back(us_since(before) * 1000.0 / SchemaBatch);
+	if (in.recv_buffer.size() != 0) throw std::runtime_error("Bytes left over after receiving.");
+}
+
+static int bench_schema(std::vector< std::string > const &) {
+	std::cout << std::setw(14) << "message" << std::setw(8) << "bytes"
+		<< std::setw(14) << "hand send" << std::setw(14) << "schema send"
+		<< std::setw(14) << "hand recv" << std::setw(14) << "schema recv" << "  (ns/message)" << std::endl;
+
+	bool mismatch = false;
+	//times both versions of a message, checking they write the same bytes and decode the same values:
+	auto compare = [&](char const *name, auto const &send_hand, auto const &recv_hand, auto const &send_schema, auto const &recv_schema) {
+		//(rounds alternate between the versions, so both see the same machine; medians, so a descheduled round doesn't count)
+		constexpr uint32_t Rounds = 1000;
+		uint64_t hand_sum = 0, schema_sum = 0; //(decoded values are summed into these, so they are used)
+		std::vector< double > hand_sends, hand_recvs, schema_sends, schema_recvs;
+		std::vector< uint8_t > hand_bytes, schema_bytes;
+		Connection out, in;
+		for (uint32_t round = 0; round < Rounds; ++round) {
+			time_batch(out, in, send_hand, [&](Connection *c) { return recv_hand(c, &hand_sum); }, &hand_sends, &hand_recvs, &hand_bytes);
+			time_batch(out, in, send_schema, [&](Connection *c) { return recv_schema(c, &schema_sum); }, &schema_sends, &schema_recvs, &schema_bytes);
+		}
+		auto median = [](std::vector< double > &ns) {
+			std::nth_element(ns.begin(), ns.begin() + ns.size() / 2, ns.end());
+			return ns[ns.size() / 2];
+		};
+		double hand_send = median(hand_sends), hand_recv = median(hand_recvs);
+		double schema_send = median(schema_sends), schema_recv = median(schema_recvs);
+		if (hand_bytes != schema_bytes || hand_sum != schema_sum) {
+			std::cerr << name << ": schema and hand-written versions disagree." << std::endl;
+			mismatch = true;
+		}
+		std::cout << std::setw(14) << name << std::setw(8) << hand_bytes.size() / 1000 << std::fixed << std::setprecision(2)
+			<< std::setw(14) << hand_send << std::setw(14) << schema_send
+			<< std::setw(14) << hand_recv << std::setw(14) << schema_recv << std::defaultfloat << std::endl;
+	};
+
+	//hand-written header handling, as each recv_*_message function used to do it:
+	auto peek_header = [](Connection *c, Message type, uint32_t *size) {
+		auto &recv_buffer = c->recv_buffer;
+		if (recv_buffer.size() < 4 || recv_buffer[0] != uint8_t(type)) return false;
+		*size = (uint32_t(recv_buffer[3]) << 16) | (uint32_t(recv_buffer[2]) << 8) | uint32_t(recv_buffer[1]);
+		return recv_buffer.size() >= 4 + *size;
+	};
+
+	compare("controls",
+		[](Connection *c, uint32_t i) {
+			uint32_t size = 9;
+			c->send(Message::C2S_Controls);
+			c->send(uint8_t(size));
+			c->send(uint8_t(size >> 8));
+			c->send(uint8_t(size >> 16));
+			for (uint32_t b = 0; b < 5; ++b) c->send(uint8_t(i + b));
+			c->send(i);
+		},
+		[&](Connection *c, uint64_t *sum) {
+			uint32_t size;
+			if (!peek_header(c, Message::C2S_Controls, &size)) return false;
+			if (size != 9) throw std::runtime_error("Controls message with size " + std::to_string(size) + " != 9!");
+			uint8_t const *payload = c->recv_buffer.data() + 4;
+			uint32_t seq;
+			std::memcpy(&seq, payload + 5, sizeof(seq));
+			*sum += payload[0] + payload[1] + payload[2] + payload[3] + payload[4] + seq;
+			c->recv_buffer.pop_front(4 + size);
+			return true;
+		},
+		[](Connection *c, uint32_t i) {
+			Messages::Controls::send(c, uint8_t(i), uint8_t(i + 1), uint8_t(i + 2), uint8_t(i + 3), uint8_t(i + 4), i);
+		},
+		[](Connection *c, uint64_t *sum) {
+			uint8_t b[5];
+			uint32_t seq;
+			if (!Messages::Controls::recv(c, &b[0], &b[1], &b[2], &b[3], &b[4], &seq)) return false;
+			*sum += b[0] + b[1] + b[2] + b[3] + b[4] + seq;
+			return true;
+		});
+
+	compare("datagram hello",
+		[](Connection *c, uint32_t i) {
+			c->send(uint8_t(Message::S2C_DatagramHello));
+			c->send(uint8_t(10));
+			c->send(uint8_t(0));
+			c->send(uint8_t(0));
+			c->send(uint16_t(i));
+			c->send(uint64_t(i) * 0x9e3779b97f4a7c15ull);
+		},
+		[&](Connection *c, uint64_t *sum) {
+			uint32_t size;
+			if (!peek_header(c, Message::S2C_DatagramHello, &size)) return false;
+			if (size != 10) throw std::runtime_error("DatagramHello message must have size 10, got " + std::to_string(size));
+			uint8_t const *payload = c->recv_buffer.data() + 4;
+			uint16_t port;
+			uint64_t token;
+			std::memcpy(&port, payload, sizeof(port));
+			std::memcpy(&token, payload + 2, sizeof(token));
+			*sum += port + token;
+			c->recv_buffer.pop_front(4 + size);
+			return true;
+		},
+		[](Connection *c, uint32_t i) {
+			Messages::DatagramHello::send(c, uint16_t(i), uint64_t(i) * 0x9e3779b97f4a7c15ull);
+		},
+		[](Connection *c, uint64_t *sum) {
+			uint16_t port;
+			uint64_t token;
+			if (!Messages::DatagramHello::recv(c, &port, &token)) return false;
+			*sum += port + token;
+			return true;
+		});
+
+	std::string text = "Go left past the second crate, then up.";
+	std::string received; //(reused, as the server's handler would)
+	compare("instruction",
+		[&](Connection *c, uint32_t) {
+			uint16_t N = uint16_t(std::min< size_t >(text.size(), 65535));
+			c->send(uint8_t(Message::C2S_Instruction));
+			uint32_t payload = 2u + uint32_t(N);
+			c->send(uint8_t(payload));
+			c->send(uint8_t(payload >> 8));
+			c->send(uint8_t(payload >> 16));
+			c->send(N);
+			c->send_raw(text.data(), N);
+		},
+		[&](Connection *c, uint64_t *sum) {
+			uint32_t size;
+			if (!peek_header(c, Message::C2S_Instruction, &size)) return false;
+			uint8_t const *payload = c->recv_buffer.data() + 4;
+			if (size < 2) throw std::runtime_error("Instruction payload too small");
+			uint16_t N;
+			std::memcpy(&N, payload, 2);
+			if (2u + N != size) throw std::runtime_error("Instruction payload size mismatch");
+			received.assign(reinterpret_cast< char const * >(payload) + 2, N);
+			*sum += received.size() + uint8_t(received.back());
+			c->recv_buffer.pop_front(4 + size);
+			return true;
+		},
+		[&](Connection *c, uint32_t) {
+			Messages::Instruction::send(c, text);
+		},
+		[&](Connection *c, uint64_t *sum) {
+			if (!Messages::Instruction::recv(c, &received)) return false;
+			*sum += received.size() + uint8_t(received.back());
+			return true;
+		});
+
+	std::cout << "(median over rounds of " << SchemaBatch << " messages into/out of one connection's buffers; 'bytes' is per message, header included)" << std::endl;
+	return mismatch ? 1 : 0;
+}
+
+//----------------------------------------------
+//smoothing: what the client draws with Smoothing vs. with the latest state, over a simulated link (see NetSim.hpp)
+
+static int bench_smoothing(std::vector< std::string > const &args) {
+	std::vector< NetConditions > links; //(each way)
+	for (auto const &arg : args) links.emplace_back(NetConditions::parse(arg));
+	if (links.empty()) {
+		for (char const *spec : {"latency=50ms", "latency=50ms,jitter=10ms", "latency=50ms,jitter=30ms", "latency=50ms,jitter=60ms",
+			"latency=50ms,jitter=10ms,dist=pareto", "latency=50ms,jitter=10ms,loss=2%", "latency=50ms,bandwidth=12kbit"}) {
+			links.emplace_back(NetConditions::parse(spec));
+		}
+	}
+
+	constexpr float Frame = 1.0f / 60.0f;
+	constexpr uint32_t Frames = 60 * 30;
+	constexpr uint32_t Warmup = 60; //frames before measuring
+
+	std::cout << "(conditions apply each way, on a TCP-like stream; remote 'jerk' is mean |change in per-frame motion|;"
+		" local 'error' is mean distance from where the server puts the local player once it has applied that frame's controls;"
+		" 'state delay' is mean time from a state message being sent to it arriving; bandwidth is protocol bytes per second)" << std::endl;
+	std::cout << std::setw(14) << "jerk latest" << std::setw(14) << "jerk smooth"
+		<< std::setw(14) << "error latest" << std::setw(16) << "error predicted" << std::setw(12) << "delay (ms)"
+		<< std::setw(13) << "state delay" << std::setw(10) << "up B/s" << std::setw(10) << "down B/s" << "  conditions" << std::endl;
+
+	for (NetConditions const &link : links) {
+		std::mt19937 mt(0x15466);
+
+		Game server;
+		PlayerHandle local = server.spawn_player();
+		PlayerHandle remote = server.spawn_player();
+		Game::StateBaseline baseline;
+
+		Game client;
+		Smoothing smoothing;
+		Player::Controls controls;
+
+		//messages in flight (on simulated time, with fixed seeds so runs repeat):
+		NetPipe to_server(link, true, 0x15466), to_client(link, true, 0x15467);
+		Connection client_out, client_in, server_out, server_in;
+		auto send_delayed = [](Connection &from, NetPipe &pipe, double now) {
+			std::vector< uint8_t > bytes = from.send_buffer.bytes();
+			pipe.push(now, bytes.data(), bytes.size());
+			from.send_buffer.clear();
+		};
+		auto deliver = [](NetPipe &pipe, Connection &to, double now) {
+			std::vector< uint8_t > bytes;
+			while (pipe.pop(now, &bytes)) {
+				to.recv_buffer.append(bytes.data(), bytes.size());
+			}
+		};
+		auto find = [](std::vector< Player > const &players, uint32_t id) -> Player const * {
+			for (auto const &player : players) {
+				if (player.id == id) return &player;
+			}
+			return nullptr;
+		};
+		auto find_in = [](Game::Players const &players, uint32_t id) -> std::optional< Player > {
+			uint32_t index = players.find_id(id);
+			if (index == players.size()) return std::nullopt;
+			return players.get(index);
+		};
+		uint32_t const local_index = server.players.find(local);
+		uint32_t const remote_index = server.players.find(remote);
+		uint32_t const local_id = server.players.id[local_index];
+		uint32_t const remote_id = server.players.id[remote_index];
+
+		//where the client showed its own player on the frame each controls message was sent:
+		struct Shown {
+			uint32_t seq;
+			glm::vec2 latest, predicted;
+		};
+		std::deque< Shown > shown;
+
+		double now = 0.0;
+		double next_tick = Game::Tick;
+		glm::vec2 raw_last = server.players.position(remote_index), raw_motion = glm::vec2(0.0f);
+		glm::vec2 smooth_last = raw_last, smooth_motion = glm::vec2(0.0f);
+		double raw_jerk = 0.0, smooth_jerk = 0.0, raw_error = 0.0, predicted_error = 0.0;
+		uint32_t jerk_frames = 0, error_ticks = 0;
+
+		for (uint32_t frame = 0; frame < Frames; ++frame) {
+			now += Frame;
+
+			//server: apply controls that have arrived, tick, send state:
+			deliver(to_server, server_in, now);
+			Player::Controls &local_controls = server.players.controls[local_index];
+			while (local_controls.recv_controls_message(&server_in)) { }
+			while (next_tick <= now) {
+				if (mt() % 8 == 0) {
+					Player::Controls &remote_controls = server.players.controls[remote_index];
+					remote_controls.left.pressed = (mt() % 3 == 0);
+					remote_controls.right.pressed = (mt() % 3 == 0);
+					remote_controls.up.pressed = (mt() % 3 == 0);
+					remote_controls.down.pressed = (mt() % 3 == 0);
+				}
+				server.update(Game::Tick);
+				server.send_state_message(&server_out, local, &baseline);
+				send_delayed(server_out, to_client, next_tick);
+				next_tick += Game::Tick;
+
+				//compare with what the client showed when it sent the controls just applied:
+				glm::vec2 local_position = server.players.position(local_index);
+				while (!shown.empty() && int32_t(shown.front().seq - local_controls.seq) < 0) shown.pop_front();
+				if (!shown.empty() && shown.front().seq == local_controls.seq && frame >= Warmup) {
+					raw_error += glm::length(shown.front().latest - local_position);
+					predicted_error += glm::length(shown.front().predicted - local_position);
+					error_ticks += 1;
+				}
+			}
+
+			//client: pick controls, send them, receive state, smooth:
+			if (frame % 20 == 0) {
+				controls.left.pressed = (mt() % 3 == 0);
+				controls.right.pressed = (mt() % 3 == 0);
+				controls.up.pressed = (mt() % 3 == 0);
+				controls.down.pressed = (mt() % 3 == 0);
+			}
+			smoothing.advance(Frame);
+			smoothing.record_controls(&controls);
+			controls.send_controls_message(&client_out);
+			send_delayed(client_out, to_server, now);
+
+			deliver(to_client, client_in, now);
+			while (client.recv_state_message(&client_in)) {
+				smoothing.record_state(client);
+			}
+			smoothing.update(client);
+
+			//measure:
+			std::optional< Player > raw_remote = find_in(client.players, remote_id);
+			std::optional< Player > raw_local = find_in(client.players, local_id);
+			Player const *smooth_remote = find(smoothing.players, remote_id);
+			Player const *smooth_local = find(smoothing.players, local_id);
+			if (!raw_remote || !raw_local || !smooth_remote || !smooth_local) continue;
+
+			shown.emplace_back(Shown{controls.seq, raw_local->position, smooth_local->position});
+
+			glm::vec2 raw_step = raw_remote->position - raw_last;
+			glm::vec2 smooth_step = smooth_remote->position - smooth_last;
+			if (frame >= Warmup) {
+				raw_jerk += glm::length(raw_step - raw_motion);
+				smooth_jerk += glm::length(smooth_step - smooth_motion);
+				jerk_frames += 1;
+			}
+			raw_last = raw_remote->position;
+			raw_motion = raw_step;
+			smooth_last = smooth_remote->position;
+			smooth_motion = smooth_step;
+		}
+		if (jerk_frames == 0 || error_ticks == 0) throw std::runtime_error("Client never saw both players.");
+
+		std::cout << std::setw(14) << std::scientific << std::setprecision(2) << (raw_jerk / jerk_frames)
+			<< std::setw(14) << std::scientific << std::setprecision(2) << (smooth_jerk / jerk_frames)
+			<< std::setw(14) << std::scientific << std::setprecision(2) << (raw_error / error_ticks)
+			<< std::setw(16) << std::scientific << std::setprecision(2) << (predicted_error / error_ticks)
+			<< std::setw(12) << std::fixed << std::setprecision(1) << (smoothing.delay * 1000.0f)
+			<< std::setw(13) << std::fixed << std::setprecision(1) << (1000.0 * to_client.stats.delay / std::max< uint64_t >(1, to_client.stats.packets))
+			<< std::setw(10) << std::fixed << std::setprecision(0) << (to_server.stats.bytes / now)
+			<< std::setw(10) << std::fixed << std::setprecision(0) << (to_client.stats.bytes / now)
+			<< std::defaultfloat << "  " << link.to_string() << std::endl;
+	}
+
+	return 0;
+}
+
+//----------------------------------------------
+//update: Game::update time vs. player count, per collision broadphase, checking that they agree exactly
+
+static int bench_update(std::vector< std::string > const &args) {
+	std::vector< uint32_t > counts;
+	for (auto const &arg : args) counts.emplace_back(uint32_t(std::stoul(arg)));
+	if (counts.empty()) counts = {10, 100, 1000, 10000};
+
+	std::cout << std::setw(8) << "players" << std::setw(8) << "ticks"
+		<< std::setw(14) << "scalar (us)" << std::setw(12) << "simd (us)"
+		<< std::setw(16) << "all pairs (us)" << std::setw(12) << "grid (us)"
+		<< std::setw(12) << "slow (us)" << std::setw(12) << "fast (us)" << std::setw(10) << "speedup" << std::endl;
+
+	for (uint32_t count : counts) {
+		uint32_t ticks = std::clamp(100000u / std::max(count, 1u), 10u, 300u);
+
+		//two copies of the same game: the straightforward loops vs. the vectorized motion step and grid broadphase:
+		Game games[2];
+		games[0].integrator = Game::Integrator::Scalar;
+		games[0].broadphase = Game::Broadphase::AllPairs;
+		games[1].integrator = Game::Integrator::Simd;
+		games[1].broadphase = Game::Broadphase::Grid;
+		games[1].grid_min_players = 0; //(always use the grid, to show its whole curve)
+		double motion_us[2] = {0.0, 0.0};
+		double collisions_us[2] = {0.0, 0.0};
+
+		for (uint32_t g = 0; g < 2; ++g) {
+			Game &game = games[g];
+			//(spread players over the whole arena; spawn_player crowds them into the middle)
+			std::mt19937 mt(count);
+			std::uniform_real_distribution< float > x(Game::ArenaMin.x, Game::ArenaMax.x), y(Game::ArenaMin.y, Game::ArenaMax.y);
+			for (uint32_t i = 0; i < count; ++i) {
+				uint32_t index = game.players.find(game.spawn_player());
+				game.players.set_position(index, glm::vec2(x(mt), y(mt)));
+			}
+			for (uint32_t tick = 0; tick < ticks; ++tick) {
+				wander(game, mt);
+				//(same as game.update(Game::Tick), but timing each half)
+				auto before = std::chrono::steady_clock::now();
+				game.update_motion(Game::Tick);
+				motion_us[g] += us_since(before);
+				before = std::chrono::steady_clock::now();
+				game.update_collisions();
+				collisions_us[g] += us_since(before);
+			}
+		}
+
+		for (uint32_t i = 0; i < count; ++i) {
+			if (games[0].players.position(i) != games[1].players.position(i) || games[0].players.velocity(i) != games[1].players.velocity(i)) {
+				throw std::runtime_error("Update paths disagree about player " + std::to_string(games[1].players.id[i]) + " with " + std::to_string(count) + " players.");
+			}
+		}
+
+		double slow_us = motion_us[0] + collisions_us[0];
+		double fast_us = motion_us[1] + collisions_us[1];
+		std::cout << std::setw(8) << count << std::setw(8) << ticks << std::fixed << std::setprecision(2)
+			<< std::setw(14) << (motion_us[0] / ticks)
+			<< std::setw(12) << (motion_us[1] / ticks)
+			<< std::setw(16) << (collisions_us[0] / ticks)
+			<< std::setw(12) << (collisions_us[1] / ticks)
+			<< std::setw(12) << (slow_us / ticks)
+			<< std::setw(12) << (fast_us / ticks)
+			<< std::setw(10) << (slow_us / fast_us)
+			<< std::defaultfloat << std::endl;
+	}
+	std::cout << "(results identical for every player, every count; by default the grid is only used from " << Game().grid_min_players << " players)" << std::endl;
+	std::cout << "(simd motion step uses " <<
+#if defined(__AVX__)
+		"AVX"
+#elif defined(__SSE2__) || defined(_M_X64)
+		"SSE2"
+#else
+		"no vector instructions -- scalar fallback"
+#endif
+		<< ")" << std::endl;
+
+	return 0;
+}
+
+static int bench_churn(std::vector< std::string > const &args) {
+	std::vector< uint32_t > counts;
+	for (auto const &arg : args) counts.emplace_back(uint32_t(std::stoul(arg)));
+	if (counts.empty()) counts = {10, 100, 1000, 10000, 100000};
+
+	constexpr uint32_t Cycles = 100000;
+
+	std::cout << std::setw(8) << "players" << std::setw(18) << "leave+join (ns)" << std::setw(14) << "lookup (ns)" << std::endl;
+
+	for (uint32_t count : counts) {
+		Game game;
+		std::vector< PlayerHandle > handles;
+		std::vector< uint32_t > ids; //ids[i] is the id of the player handles[i] refers to
+		for (uint32_t i = 0; i < count; ++i) {
+			handles.emplace_back(game.spawn_player());
+			ids.emplace_back(game.players.id.back());
+		}
+		std::mt19937 mt(count);
+
+		//a random player leaves and a new one joins (as when load-test bots reconnect):
+		auto before = std::chrono::steady_clock::now();
+		for (uint32_t c = 0; c < Cycles; ++c) {
+			uint32_t i = mt() % count;
+			PlayerHandle stale = handles[i];
+			game.remove_player(stale);
+			handles[i] = game.spawn_player();
+			ids[i] = game.players.id.back();
+			if (game.players.find(stale) != game.players.size()) {
+				throw std::runtime_error("Handle of removed player still finds a player.");
+			}
+		}
+		double churn_us = us_since(before);
+
+		//every handle should still find its own player:
+		before = std::chrono::steady_clock::now();
+		uint32_t lookups = 0;
+		for (uint32_t pass = 0; lookups < Cycles; ++pass) {
+			for (uint32_t i = 0; i < count; ++i) {
+				uint32_t index = game.players.find(handles[i]);
+				if (index == game.players.size() || game.players.id[index] != ids[i]) {
+					throw std::runtime_error("Handle " + std::to_string(i) + " lost its player.");
+				}
+			}
+			lookups += count;
+		}
+		double lookup_us = us_since(before);
+
+		std::cout << std::setw(8) << count << std::fixed << std::setprecision(1)
+			<< std::setw(18) << (churn_us * 1000.0 / Cycles)
+			<< std::setw(14) << (lookup_us * 1000.0 / lookups)
+			<< std::defaultfloat << std::endl;
+	}
+
+	return 0;
+}
+
+//----------------------------------------------
+//fanout: sending one game's state to many loopback clients, with the shared part copied into vs. referenced from each send queue
+
+static int bench_fanout(std::vector< std::string > const &args) {
+	std::vector< uint32_t > counts;
+	for (auto const &arg : args) counts.emplace_back(uint32_t(std::stoul(arg)));
+	if (counts.empty()) counts = {16, 64, 256};
+
+	#ifndef _WIN32
+	{ //each client uses two sockets in this process, so raise the open file limit as far as allowed:
+		struct rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+			limit.rlim_cur = limit.rlim_max;
+			setrlimit(RLIMIT_NOFILE, &limit);
+		}
+	}
+	#endif
+
+	constexpr uint32_t Ticks = 200;
+	uint32_t port = 15666;
+
+	std::cout << std::setw(8) << "clients" << std::setw(8) << "mode" << std::setw(16) << "send (us/tick)"
+		<< std::setw(16) << "syscalls/tick" << std::setw(16) << "copied B/tick" << std::setw(16) << "shared B/tick" << std::setw(14) << "sent B/tick" << std::endl;
+
+	for (uint32_t count : counts) {
+		std::string port_str = std::to_string(port++);
+		std::unique_ptr< Server > server;
+		std::vector< std::unique_ptr< Client > > clients;
+		{
+			Quiet quiet;
+			server = std::make_unique< Server >(port_str);
+			for (uint32_t i = 0; i < count; ++i) {
+				clients.emplace_back(std::make_unique< Client >("localhost", port_str));
+			}
+			while (server->connections.size() < count) server->poll(nullptr, 0.001);
+		}
+
+		//one game with a player per connection:
+		Game game;
+		std::vector< Connection * > connections;
+		std::vector< PlayerHandle > players;
+		for (auto &c : server->connections) {
+			connections.emplace_back(&c);
+			players.emplace_back(game.spawn_player());
+		}
+		std::mt19937 mt(count);
+
+		for (bool copy : {true, false}) {
+			std::vector< Game::StateBaseline > baselines(count);
+			Game::StateBroadcast broadcast;
+			broadcast.copy = copy;
+
+			SendStats before_stats = server->send_stats;
+			double send_us = 0.0;
+			for (uint32_t tick = 0; tick < Ticks; ++tick) {
+				wander(game, mt);
+				game.update(Game::Tick);
+
+				auto before = std::chrono::steady_clock::now();
+				broadcast.prepare(game);
+				for (uint32_t i = 0; i < count; ++i) {
+					game.send_state_message(connections[i], players[i], &baselines[i], &broadcast);
+				}
+				server->poll(nullptr, 0.0);
+				send_us += us_since(before);
+
+				//(clients just discard what they get)
+				for (auto &client : clients) {
+					client->poll(nullptr, 0.0);
+					client->connection.recv_buffer.clear();
+				}
+			}
+			SendStats const &after_stats = server->send_stats;
+			std::cout << std::setw(8) << count << std::setw(8) << (copy ? "copy" : "shared") << std::fixed << std::setprecision(1)
+				<< std::setw(16) << send_us / Ticks
+				<< std::setw(16) << double(after_stats.syscalls - before_stats.syscalls) / Ticks
+				<< std::setw(16) << double(after_stats.bytes_copied - before_stats.bytes_copied) / Ticks
+				<< std::setw(16) << double(after_stats.bytes_shared - before_stats.bytes_shared) / Ticks
+				<< std::setw(14) << double(after_stats.bytes_sent - before_stats.bytes_sent) / Ticks
+				<< std::defaultfloat << std::endl;
+		}
+
+		{ //teardown:
+			Quiet quiet;
+			for (auto &c : server->connections) c.close();
+			for (auto &client : clients) {
+				client->connection.close();
+			}
+			Connection closer;
+			closer.socket = server->listen_socket;
+			closer.close();
+		}
+	}
+	std::cout << "(each connection's header and the shared players part go out in one sendmsg(); shared parts under " << Connection::MinSharedSize << " bytes are copied anyway)" << std::endl;
+
+	return 0;
+}
+
+//----------------------------------------------
+//backpressure: a client whose link can't keep up with its state messages, with every state queued vs. states skipped while it is congested
+
+static int bench_backpressure(std::vector< std::string > const &args) {
+	std::vector< uint32_t > counts;
+	for (auto const &arg : args) counts.emplace_back(uint32_t(std::stoul(arg)));
+	if (counts.empty()) counts = {16, 128};
+
+	constexpr uint32_t Ticks = 1800;
+	constexpr double LinkShare = 0.5; //slow links carry this fraction of what a client that keeps up is sent
+	//a skipping link queues at most WatermarkMessages + 1 states, each up to ~2x the usual size (catching up), at LinkShare of a state per tick:
+	constexpr uint32_t MaxAge = uint32_t(2 * (Connection::WatermarkMessages + 1) / LinkShare);
+
+	//a connection (unconnected, so it just accumulates) and the client at the far end of its link:
+	struct Link {
+		char const *name;
+		bool skip; //skip states while congested (as Shard::tick() does)
+		Connection connection;
+		Game::StateBaseline baseline;
+		Game client;
+		Connection to_client;
+		double budget = 0.0; //bytes the link may carry this tick
+		uint64_t appended = 0, drained = 0; //bytes, over the whole run
+		std::deque< std::pair< uint64_t, uint32_t > > messages; //(end byte, tick sent) of each message not yet fully drained
+		size_t max_queued = 0, max_allowed = 0; //(allowed: the high watermark plus the message that reached it)
+		uint32_t max_age = 0; //ticks between a message being queued and arriving
+		uint64_t skipped = 0;
+	};
+
+	//the players two clients have (as reconstructed from state messages) are exactly the same:
+	auto same_players = [](Game const &a, Game const &b) {
+		if (a.players.size() != b.players.size() || a.players.handles.slots.size() != b.players.handles.slots.size()) return false;
+		for (uint32_t slot = 0; slot < a.players.handles.slots.size(); ++slot) {
+			uint32_t ia = a.players.handles.slots[slot].dense, ib = b.players.handles.slots[slot].dense;
+			if ((ia == SlotIndex::Free) != (ib == SlotIndex::Free)) return false;
+			if (ia == SlotIndex::Free) continue;
+			Player pa = a.players.get(ia), pb = b.players.get(ib);
+			if (pa.id != pb.id || pa.name != pb.name || pa.position != pb.position || pa.velocity != pb.velocity
+			 || pa.color.r != pb.color.r || pa.color.g != pb.color.g || pa.color.b != pb.color.b) return false;
+		}
+		return true;
+	};
+
+	std::cout << "(links carry " << LinkShare << "x what the server sends a client that keeps up; the high watermark is "
+		<< Connection::WatermarkMessages << " states' worth)" << std::endl;
+	std::cout << std::setw(8) << "players" << std::setw(10) << "link" << std::setw(18) << "max queued (KiB)" << std::setw(18) << "max age (ticks)"
+		<< std::setw(16) << "states skipped" << std::setw(14) << "sent B/tick" << std::endl;
+
+	bool ok = true;
+	for (uint32_t count : counts) {
+		Game game;
+		std::vector< PlayerHandle > players;
+		for (uint32_t i = 0; i < count; ++i) {
+			players.emplace_back(game.spawn_player());
+		}
+		Game::StateBroadcast broadcast;
+		std::mt19937 mt(count);
+
+		std::vector< std::unique_ptr< Link > > links;
+		for (auto [name, skip] : {std::make_pair("fast", false), std::make_pair("queue", false), std::make_pair("skip", true)}) {
+			links.emplace_back(std::make_unique< Link >());
+			links.back()->name = name;
+			links.back()->skip = skip;
+		}
+		Link &fast = *links[0];
+
+		//move up to 'limit' bytes across a link, and have the client apply whatever messages are complete:
+		auto drain = [](Link &link, size_t limit, uint32_t tick) {
+			size_t count = std::min(limit, link.connection.send_buffer.size());
+			size_t left = count;
+			for (auto const &segment : link.connection.send_buffer.segments) {
+				if (left == 0) break;
+				size_t n = std::min(left, segment.size());
+				link.to_client.recv_buffer.append(segment.data(), n);
+				left -= n;
+			}
+			link.connection.send_buffer.pop_front(count);
+			link.drained += count;
+			while (!link.messages.empty() && link.messages.front().first <= link.drained) {
+				link.max_age = std::max(link.max_age, tick - link.messages.front().second);
+				link.messages.pop_front();
+			}
+			while (link.client.recv_state_message(&link.to_client)) {
+				if (link.client.needs_keyframe) throw std::runtime_error(std::string(link.name) + " client lost track of state.");
+			}
+		};
+
+		for (uint32_t tick = 0; tick < Ticks; ++tick) {
+			wander(game, mt);
+			game.update(Game::Tick);
+			broadcast.prepare(game);
+
+			for (auto &link_ptr : links) {
+				Link &link = *link_ptr;
+				if (link.skip && link.connection.check_congestion()) {
+					link.skipped += 1;
+				} else {
+					size_t before = link.connection.send_buffer.size();
+					game.send_state_message(&link.connection, players[0], &link.baseline, &broadcast);
+					size_t size = link.connection.send_buffer.size() - before;
+					link.connection.note_supersedable(size);
+					link.appended += size;
+					link.max_allowed = std::max(link.max_allowed, link.connection.high_watermark + size);
+					link.messages.emplace_back(link.appended, tick);
+				}
+				link.max_queued = std::max(link.max_queued, link.connection.queued());
+			}
+
+			//the fast link carries everything; the others, a share of what the fast one has carried so far:
+			double rate = LinkShare * double(fast.appended) / double(tick + 1);
+			for (auto &link_ptr : links) {
+				Link &link = *link_ptr;
+				if (&link == &fast) {
+					drain(link, link.connection.send_buffer.size(), tick);
+					continue;
+				}
+				link.budget = std::min(link.budget, rate) + rate; //(an idle link doesn't save up)
+				size_t limit = size_t(link.budget);
+				link.budget -= double(std::min(limit, link.connection.send_buffer.size()));
+				drain(link, limit, tick);
+			}
+		}
+
+		//once the links catch up (and are sent the latest state, in case it was skipped), every client should have the same players:
+		broadcast.prepare(game);
+		for (auto &link_ptr : links) {
+			Link &link = *link_ptr;
+			drain(link, link.connection.send_buffer.size(), Ticks);
+			game.send_state_message(&link.connection, players[0], &link.baseline, &broadcast);
+			drain(link, link.connection.send_buffer.size(), Ticks);
+		}
+		for (auto &link_ptr : links) {
+			Link &link = *link_ptr;
+			std::cout << std::setw(8) << count << std::setw(10) << link.name << std::fixed << std::setprecision(1)
+				<< std::setw(18) << link.max_queued / 1024.0
+				<< std::setw(18) << link.max_age
+				<< std::setw(16) << link.skipped
+				<< std::setw(14) << double(link.appended) / Ticks
+				<< std::defaultfloat << std::endl;
+			if (!same_players(link.client, fast.client)) {
+				std::cout << "  FAILED: " << link.name << " client's players don't match once its link has caught up." << std::endl;
+				ok = false;
+			}
+			if (link.skip && link.max_queued > link.max_allowed) {
+				std::cout << "  FAILED: " << link.name << " link queued more than the high watermark plus one message." << std::endl;
+				ok = false;
+			}
+			if (link.skip && link.max_age > MaxAge) {
+				std::cout << "  FAILED: " << link.name << " link delivered states more than " << MaxAge << " ticks old." << std::endl;
+				ok = false;
+			}
+		}
+	}
+	std::cout << "('age' is how long a state waits in the send buffer; skipped states are superseded by the next one, a keyframe if the client fell behind)" << std::endl;
+
+	return (ok ? 0 : 1);
+}
+
+//----------------------------------------------
+//metrics: cost and accuracy of Metrics histograms and counters, and the cost of a Log line with the writer thread running
+
+static int bench_metrics(std::vector< std::string > const &args) {
+	uint32_t count = (args.empty() ? 1000000 : uint32_t(std::stoul(args[0])));
+	bool ok = true;
+
+	{ //histogram: record (e.g.) tick times, then compare its quantiles with the exact ones:
+		std::mt19937 mt(0x15466);
+		std::lognormal_distribution< double > times(std::log(200000.0), 0.75); //(nanoseconds; ~200us typical, long tail)
+		std::vector< uint64_t > values(count);
+		for (auto &v : values) v = uint64_t(times(mt));
+
+		Metrics::Histogram histogram;
+		auto before = std::chrono::steady_clock::now();
+		for (uint64_t v : values) histogram.record(v);
+		double record_ns = 1000.0 * us_since(before) / count;
+
+		std::sort(values.begin(), values.end());
+		std::cout << "histogram: " << std::fixed << std::setprecision(2) << record_ns << " ns/record; quantiles (us) exact vs. histogram:" << std::defaultfloat << std::endl;
+		for (double q : Metrics::Registry::Quantiles) {
+			uint64_t exact = values[std::max< size_t >(1, size_t(std::ceil(q * count))) - 1];
+			uint64_t got = histogram.quantile(q);
+			//(reported as the top of the value's bucket, which is within 1/SubBuckets above it)
+			bool close = (got >= exact && double(got) <= double(exact) * (1.0 + 1.0 / Metrics::Histogram::SubBuckets) + 1.0);
+			std::cout << "  " << std::setprecision(4) << std::setw(6) << q << std::fixed << std::setprecision(1) << std::setw(12) << exact / 1000.0 << std::setw(12) << got / 1000.0
+				<< std::defaultfloat << (close ? "" : "  FAILED: more than a bucket off") << std::endl;
+			ok = ok && close;
+		}
+	}
+
+	{ //counters: several threads adding at once:
+		constexpr uint32_t Threads = 4;
+		Metrics::Counter counter;
+		std::vector< std::thread > threads;
+		auto before = std::chrono::steady_clock::now();
+		for (uint32_t t = 0; t < Threads; ++t) {
+			threads.emplace_back([&]() {
+				for (uint32_t i = 0; i < count; ++i) counter.add();
+			});
+		}
+		for (auto &thread : threads) thread.join();
+		double add_ns = 1000.0 * us_since(before) / count;
+		bool exact = (counter.value() == uint64_t(Threads) * count);
+		std::cout << "counter: " << std::fixed << std::setprecision(2) << add_ns << " ns/add with " << Threads << " threads adding" << std::defaultfloat
+			<< (exact ? "" : "  FAILED: lost adds") << std::endl;
+		ok = ok && exact;
+	}
+
+	{ //log: lines handed to the writer thread (whose output is discarded here), in bursts that fit the ring and ones that don't:
+		constexpr uint32_t Burst = Log::Capacity / 2;
+		double line_ns = 0.0;
+		uint64_t burst_allocations = 0;
+		uint64_t dropped_before, dropped_after;
+		{
+			Quiet quiet;
+			Log::start();
+			dropped_before = Log::dropped();
+			uint64_t allocations_before = allocations;
+			auto before = std::chrono::steady_clock::now();
+			for (uint32_t i = 0; i < Burst; ++i) Log::info("[bench] client %u sent %u bytes (%s).", i, i * 7, "message");
+			line_ns = 1000.0 * us_since(before) / Burst;
+			burst_allocations = allocations - allocations_before;
+			std::this_thread::sleep_for(std::chrono::milliseconds(50)); //(let the writer catch up)
+			for (uint32_t i = 0; i < 4 * Log::Capacity; ++i) Log::info("[bench] client %u sent %u bytes (%s).", i, i * 7, "message");
+			dropped_after = Log::dropped();
+			Log::stop();
+		}
+		std::cout << "log: " << std::fixed << std::setprecision(2) << line_ns << " ns/line (" << burst_allocations << " allocations over " << Burst << " lines); "
+			<< std::defaultfloat << dropped_after - dropped_before << " of " << 4 * Log::Capacity << " lines dropped from a burst of 4x the ring" << std::endl;
+		//(the writer thread may allocate as it writes, so this only fails if the logging threads clearly do)
+		if (burst_allocations >= Burst) {
+			std::cout << "  FAILED: logging allocates." << std::endl;
+			ok = false;
+		}
+	}
+
+	return (ok ? 0 : 1);
+}
+
+//----------------------------------------------
+//profile: cost of a PROFILE_ZONE with the profiler off and on, and a check of the trace it writes
+
+static int bench_profile(std::vector< std::string > const &args) {
+	uint32_t count = (args.empty() ? 1000000 : uint32_t(std::stoul(args[0])));
+	bool ok = true;
+
+	//(noinline, so the zones can't be folded away)
+	struct Work {
+		[[gnu::noinline]] static void run(uint32_t *sink) {
+			PROFILE_ZONE("bench_profile::run");
+			*sink += 1;
+		}
+	};
+
+	uint32_t sink = 0;
+	auto time_zones = [&]() {
+		auto before = std::chrono::steady_clock::now();
+		for (uint32_t i = 0; i < count; ++i) Work::run(&sink);
+		return 1000.0 * us_since(before) / count;
+	};
+
+	std::string path = (std::filesystem::temp_directory_path() / "bench-profile.json").string();
+
+	Profiler::set_thread_name("bench");
+	Profiler::clear();
+	Profiler::enabled = false;
+	double off_ns = time_zones();
+	uint64_t off_zones = Profiler::write(path);
+
+	Profiler::clear();
+	Profiler::enabled = true;
+	uint64_t allocations_before = allocations;
+	double on_ns = time_zones();
+	uint64_t on_allocations = allocations - allocations_before;
+	//a zone on another thread, to check that it gets its own row:
+	std::thread([]() {
+		Profiler::set_thread_name("bench worker");
+		PROFILE_ZONE("bench_profile::worker");
+	}).join();
+	Profiler::enabled = false;
+	uint64_t on_zones = Profiler::write(path);
+
+	//every zone that fits in the ring, plus the worker's:
+	// (once the ring has wrapped, write() also leaves out the oldest zone, whose slot a recording thread would overwrite next)
+	uint64_t expected = (count < Profiler::Capacity ? count : Profiler::Capacity - 1) + 1;
+	std::cout << "zone: " << std::fixed << std::setprecision(2) << off_ns << " ns disabled, " << on_ns << " ns enabled (" << on_allocations << " allocations over "
+		<< count << " zones)" << std::defaultfloat << std::endl;
+	std::cout << "trace: " << on_zones << " zones written to '" << path << "' (ring holds " << Profiler::Capacity << " per thread)" << std::endl;
+	if (off_zones != 0) {
+		std::cout << "  FAILED: " << off_zones << " zones recorded while disabled." << std::endl;
+		ok = false;
+	}
+	if (on_zones != expected) {
+		std::cout << "  FAILED: expected " << expected << " zones in the trace." << std::endl;
+		ok = false;
+	}
+	//(the first zone creates the thread's ring; after that, recording shouldn't allocate)
+	if (on_allocations > 2) {
+		std::cout << "  FAILED: recording zones allocates." << std::endl;
+		ok = false;
+	}
+
+	{ //the trace should name both threads and hold the zones as complete ("X") events:
+		std::ifstream in(path, std::ios::binary);
+		std::string trace((std::istreambuf_iterator< char >(in)), std::istreambuf_iterator< char >());
+		auto occurrences = [&trace](std::string const &needle) {
+			uint64_t found = 0;
+			for (size_t at = trace.find(needle); at != std::string::npos; at = trace.find(needle, at + 1)) found += 1;
+			return found;
+		};
+		bool named = (occurrences("\"name\":\"bench\"") == 1 && occurrences("\"name\":\"bench worker\"") == 1);
+		bool complete = (occurrences("\"ph\":\"X\"") == on_zones && occurrences("bench_profile::worker") == 1);
+		bool whole = (trace.rfind("{\"traceEvents\":[", 0) == 0 && trace.size() >= 6 && trace.compare(trace.size() - 6, 6, "\"ms\"}\n") == 0);
+		if (!named || !complete || !whole) {
+			std::cout << "  FAILED: trace is missing thread names or zones." << std::endl;
+			ok = false;
+		}
+	}
+	std::filesystem::remove(path);
+	Profiler::clear();
+
+	(void)sink;
+	return (ok ? 0 : 1);
+}
+
+//----------------------------------------------
+//ticks: TickScheduler keeping time through stalls (real time), and running flat out (accelerated)
+
+static int bench_ticks(std::vector< std::string > const &args) {
+	std::vector< uint32_t > stalls_ms;
+	for (auto const &arg : args) stalls_ms.emplace_back(uint32_t(std::stoul(arg)));
+	if (stalls_ms.empty()) stalls_ms = {0, 20, 100, 500};
+
+	constexpr uint32_t RoomCount = 200;
+	auto make_rooms = [](Rooms &rooms) {
+		for (uint32_t p = 0; p < RoomCount * Rooms::Seats; ++p) rooms.join();
+	};
+
+	//a server loop with no connections; once a second, one tick takes 'stall' longer than usual:
+	constexpr double Seconds = 3.0;
+	std::cout << "Real time, " << RoomCount << " rooms, " << Seconds << "s, one stalled tick per second:" << std::endl;
+	std::cout << std::setw(10) << "stall (ms)" << std::setw(8) << "ticks" << std::setw(10) << "expected" << std::setw(8) << "late"
+		<< std::setw(9) << "dropped" << std::setw(10) << "overruns" << std::setw(18) << "max overrun (ms)" << std::setw(18) << "longest catch-up" << std::endl;
+	bool ok = true;
+	for (uint32_t stall : stalls_ms) {
+		Rooms rooms;
+		make_rooms(rooms);
+		std::mt19937 mt(0x15466);
+
+		TickScheduler scheduler(Game::Tick);
+		scheduler.start();
+		auto start = std::chrono::steady_clock::now();
+		uint32_t catch_up = 0, longest_catch_up = 0; //late ticks run one after another
+		uint32_t stalled = 0; //ticks that stalled for longer than a step
+		while (std::chrono::steady_clock::now() - start < std::chrono::duration< double >(Seconds)) {
+			uint32_t steps = scheduler.due();
+			if (steps == 0) {
+				std::this_thread::sleep_for(std::chrono::duration< double >(scheduler.wait()));
+				continue;
+			}
+			for (uint32_t s = 0; s < steps; ++s) {
+				uint64_t late_before = scheduler.stats.late;
+				scheduler.begin_tick();
+				catch_up = (scheduler.stats.late != late_before ? catch_up + 1 : 0);
+				longest_catch_up = std::max(longest_catch_up, catch_up);
+				for (auto &room : rooms.rooms.values) wander(room.game, mt);
+				rooms.update(scheduler.step);
+				if (scheduler.tick % uint64_t(std::round(1.0f / Game::Tick)) == 0) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(stall));
+					stalled += (stall > 1000.0f * Game::Tick);
+				}
+				scheduler.end_tick();
+			}
+		}
+		auto const &stats = scheduler.stats;
+		std::cout << std::setw(10) << stall << std::setw(8) << stats.ticks << std::setw(10) << uint32_t(Seconds / Game::Tick)
+			<< std::setw(8) << stats.late << std::setw(9) << stats.dropped << std::setw(10) << stats.overruns
+			<< std::fixed << std::setprecision(1) << std::setw(18) << 1000.0 * stats.max_overrun_seconds << std::defaultfloat
+			<< std::setw(18) << longest_catch_up << std::endl;
+		//(a loaded machine can add an overrun of its own, so these are upper bounds)
+		if (stats.overruns > stalled + 1) {
+			std::cout << "  FAILED: " << stats.overruns << " overruns counted for " << stalled << " stalled ticks." << std::endl;
+			ok = false;
+		}
+		if (longest_catch_up > TickScheduler::MaxCatchUp) {
+			std::cout << "  FAILED: ran more than MaxCatchUp late ticks in a row." << std::endl;
+			ok = false;
+		}
+	}
+	std::cout << "(due() hands out at most " << TickScheduler::MaxCatchUp << " ticks at once -- a bigger backlog is dropped -- and each stall is one overrun)" << std::endl;
+
+	//accelerated: no waiting; simulated time comes from the tick count, so runs are repeatable:
+	constexpr uint32_t Ticks = 3000;
+	auto simulate = [&](double *wall_seconds) {
+		Rooms rooms;
+		make_rooms(rooms);
+		std::mt19937 mt(0x15466);
+		TickScheduler scheduler(Game::Tick, TickScheduler::Mode::Accelerated);
+		scheduler.start();
+		auto before = std::chrono::steady_clock::now();
+		while (scheduler.tick < Ticks) {
+			uint32_t steps = scheduler.due();
+			for (uint32_t s = 0; s < steps; ++s) {
+				scheduler.begin_tick();
+				for (auto &room : rooms.rooms.values) wander(room.game, mt);
+				rooms.update(scheduler.step);
+				scheduler.end_tick();
+			}
+		}
+		*wall_seconds = us_since(before) / 1e6;
+		std::vector< float > positions;
+		for (auto const &room : rooms.rooms.values) {
+			auto const &players = room.game.players;
+			positions.insert(positions.end(), players.position_x.begin(), players.position_x.end());
+			positions.insert(positions.end(), players.position_y.begin(), players.position_y.end());
+		}
+		return positions;
+	};
+	double wall_a = 0.0, wall_b = 0.0;
+	std::vector< float > a = simulate(&wall_a);
+	std::vector< float > b = simulate(&wall_b);
+	if (a != b) throw std::runtime_error("Accelerated runs with the same inputs ended in different states.");
+	double simulated = Ticks * double(Game::Tick);
+	std::cout << "Accelerated, " << RoomCount << " rooms: " << std::fixed << std::setprecision(0) << simulated << "s simulated in " << std::setprecision(3) << wall_a << "s ("
+		<< std::setprecision(0) << simulated / wall_a << "x real time); a second run ended in the identical state." << std::defaultfloat << std::endl;
+
+	return (ok ? 0 : 1);
+}
+
+//----------------------------------------------
+//shards: server tick cost vs. rooms, for different numbers of worker threads, with scripted loopback clients
+
+static int bench_shards(std::vector< std::string > const &args) {
+	std::vector< uint32_t > room_counts;
+	for (auto const &arg : args) room_counts.emplace_back(uint32_t(std::stoul(arg)));
+	if (room_counts.empty()) room_counts = {50, 200, 800};
+	std::vector< uint32_t > worker_counts{1, 2, 4, 8};
+
+	#ifndef _WIN32
+	{ //each client uses two sockets in this process, so raise the open file limit as far as allowed:
+		struct rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+			limit.rlim_cur = limit.rlim_max;
+			setrlimit(RLIMIT_NOFILE, &limit);
+		}
+	}
+	#endif
+
+	constexpr double Seconds = 1.0; //measured time per configuration
+	std::mt19937 mt(0x15466);
+	uint32_t port = 15566;
+
+	std::cout << "(" << std::thread::hardware_concurrency() << " hardware threads; clients are driven from one more thread)" << std::endl;
+	std::cout << std::setw(8) << "workers" << std::setw(8) << "rooms"
+		<< std::setw(14) << "tick (us)" << std::setw(20) << "slowest shard (us)" << std::setw(12) << "ticks/s" << std::endl;
+
+	for (uint32_t rooms : room_counts) {
+		for (uint32_t workers : worker_counts) {
+			uint32_t count = rooms * Rooms::Seats;
+			std::string port_str = std::to_string(port++);
+
+			std::unique_ptr< Server > listener;
+			std::vector< std::unique_ptr< Shard > > shards;
+			std::vector< std::unique_ptr< Client > > clients;
+			auto connected = [&]() {
+				uint32_t total = 0;
+				for (auto const &shard : shards) total += shard->connection_count;
+				return total;
+			};
+			try {
+				Quiet quiet;
+				listener = std::make_unique< Server >(port_str);
+				listener->on_accept = [&](Socket socket) { Shard::hand_off(shards, socket); };
+				for (uint32_t w = 0; w < workers; ++w) {
+					shards.emplace_back(std::make_unique< Shard >(w));
+					shards.back()->start();
+				}
+				clients.reserve(count);
+				while (clients.size() < count) {
+					clients.emplace_back(std::make_unique< Client >("localhost", port_str));
+					listener->poll(nullptr, 0.0);
+					//(let each pair reach the same shard before the next pair starts)
+					if (clients.size() % Rooms::Seats == 0) {
+						while (connected() < clients.size()) listener->poll(nullptr, 0.001);
+					}
+				}
+				while (connected() < count) listener->poll(nullptr, 0.001);
+			} catch (std::exception const &e) {
+				std::cout << std::setw(8) << workers << std::setw(8) << rooms << "  (failed: " << e.what() << ")" << std::endl;
+				break;
+			}
+
+			//scripted players: wander about, sending controls every tick and reading (and discarding) state:
+			std::vector< Player::Controls > controls(count);
+			auto drive = [&](double seconds) {
+				auto start = std::chrono::steady_clock::now();
+				auto next = start;
+				while (std::chrono::steady_clock::now() - start < std::chrono::duration< double >(seconds)) {
+					for (uint32_t i = 0; i < count; ++i) {
+						if (mt() % 8 == 0) {
+							controls[i].left.pressed = (mt() % 3 == 0);
+							controls[i].right.pressed = (mt() % 3 == 0);
+							controls[i].up.pressed = (mt() % 3 == 0);
+							controls[i].down.pressed = (mt() % 3 == 0);
+						}
+						controls[i].seq += 1;
+						controls[i].send_controls_message(&clients[i]->connection);
+						clients[i]->poll(nullptr, 0.0);
+						clients[i]->connection.recv_buffer.clear();
+					}
+					next += std::chrono::duration_cast< std::chrono::steady_clock::duration >(std::chrono::duration< double >(Game::Tick));
+					std::this_thread::sleep_until(next);
+				}
+			};
+
+			drive(0.25); //(warm up)
+
+			std::vector< uint64_t > ticks_before, ns_before;
+			for (auto const &shard : shards) {
+				ticks_before.emplace_back(shard->ticks);
+				ns_before.emplace_back(shard->tick_ns);
+			}
+			drive(Seconds);
+
+			uint64_t total_ticks = 0, total_ns = 0;
+			double slowest_us = 0.0;
+			for (uint32_t w = 0; w < workers; ++w) {
+				uint64_t ticks = shards[w]->ticks - ticks_before[w];
+				uint64_t ns = shards[w]->tick_ns - ns_before[w];
+				total_ticks += ticks;
+				total_ns += ns;
+				if (ticks) slowest_us = std::max(slowest_us, ns / 1000.0 / ticks);
+			}
+
+			std::cout << std::setw(8) << workers << std::setw(8) << rooms << std::fixed << std::setprecision(1)
+				<< std::setw(14) << (total_ticks ? total_ns / 1000.0 / total_ticks : 0.0)
+				<< std::setw(20) << slowest_us
+				<< std::setw(12) << (total_ticks / double(workers) / Seconds)
+				<< std::defaultfloat << std::endl;
+
+			{ //teardown:
+				Quiet quiet;
+				shards.clear(); //(stops threads, closes server-side sockets)
+				for (auto &client : clients) {
+					client->connection.close();
+				}
+				Connection closer;
+				closer.socket = listener->listen_socket;
+				closer.close();
+			}
+		}
+	}
+	std::cout << "('tick' is one shard updating its rooms and serializing/sending their state; ideally " << (1.0 / Game::Tick) << " ticks/s per shard)" << std::endl;
+
+	return 0;
+}
+
+//----------------------------------------------
+//replay: record a session of scripted loopback clients, replay it without sockets, and check the replay ends in the same state
+
+static int bench_replay(std::vector< std::string > const &args) {
+	std::vector< uint32_t > room_counts;
+	for (auto const &arg : args) room_counts.emplace_back(uint32_t(std::stoul(arg)));
+	if (room_counts.empty()) room_counts = {10, 100};
+
+	#ifndef _WIN32
+	{ //each client uses two sockets in this process, so raise the open file limit as far as allowed:
+		struct rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+			limit.rlim_cur = limit.rlim_max;
+			setrlimit(RLIMIT_NOFILE, &limit);
+		}
+	}
+	#endif
+
+	constexpr double Seconds = 3.0; //recorded time per configuration
+	std::string path = (std::filesystem::temp_directory_path() / "bench-replay.cap").string();
+	std::mt19937 mt(0x15466);
+	uint32_t port = 15766;
+
+	//everything about a shard's games that replaying should reproduce:
+	auto fingerprint = [](Shard const &shard) {
+		uint64_t hash = 0xcbf29ce484222325ull; //(FNV-1a)
+		auto add = [&](void const *data, size_t size) {
+			for (size_t i = 0; i < size; ++i) {
+				hash = (hash ^ reinterpret_cast< uint8_t const * >(data)[i]) * 0x100000001b3ull;
+			}
+		};
+		for (auto const &room : shard.rooms.rooms.values) {
+			Game const &game = room.game;
+			add(&game.phase, sizeof(game.phase));
+			for (uint8_t role : {game.role_1, game.role_2, game.selected_role_1, game.selected_role_2}) add(&role, 1);
+			add(game.corrupted_instruction.data(), game.corrupted_instruction.size());
+			auto const &players = game.players;
+			add(players.id.data(), players.size() * sizeof(uint32_t));
+			add(players.position_x.data(), players.size() * sizeof(float));
+			add(players.position_y.data(), players.size() * sizeof(float));
+			add(players.velocity_x.data(), players.size() * sizeof(float));
+			add(players.velocity_y.data(), players.size() * sizeof(float));
+			for (auto const &controls : players.controls) add(&controls.seq, sizeof(controls.seq));
+		}
+		return hash;
+	};
+
+	std::cout << "(" << Seconds << " s recorded per row, with one shard; replay runs the same handlers and ticks with no sockets or waiting)" << std::endl;
+	std::cout << std::setw(8) << "rooms" << std::setw(8) << "ticks" << std::setw(12) << "messages" << std::setw(14) << "capture (B)"
+		<< std::setw(10) << "B/tick" << std::setw(14) << "replay (ms)" << std::setw(12) << "ticks/s" << std::setw(14) << "x real time"
+		<< std::setw(10) << "same" << std::endl;
+
+	for (uint32_t rooms : room_counts) {
+		uint32_t count = rooms * Rooms::Seats;
+		std::string port_str = std::to_string(port++);
+
+		std::unique_ptr< Server > listener;
+		std::unique_ptr< Shard > shard;
+		std::vector< std::unique_ptr< Client > > clients;
+		try {
+			Quiet quiet;
+			listener = std::make_unique< Server >(port_str);
+			shard = std::make_unique< Shard >(0);
+			shard->record(path);
+			shard->start();
+			listener->on_accept = [&](Socket socket) { shard->handoff.push(socket); shard->server.wake(); };
+			clients.reserve(count);
+			while (clients.size() < count) {
+				clients.emplace_back(std::make_unique< Client >("localhost", port_str));
+				listener->poll(nullptr, 0.0);
+			}
+			while (shard->connection_count < count) listener->poll(nullptr, 0.001);
+		} catch (std::exception const &e) {
+			std::cout << std::setw(8) << rooms << "  (failed: " << e.what() << ")" << std::endl;
+			break;
+		}
+
+		//scripted players: wander about, log in partway through, and send an instruction a bit later:
+		std::vector< Player::Controls > controls(count);
+		uint64_t messages = 0;
+		{
+			Quiet quiet; //(the server prints role choices)
+			auto start = std::chrono::steady_clock::now();
+			auto next = start;
+			bool logged_in = false, instructed = false;
+			while (true) {
+				double elapsed = std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count();
+				if (elapsed >= Seconds) break;
+				for (uint32_t i = 0; i < count; ++i) {
+					Connection &connection = clients[i]->connection;
+					if (mt() % 8 == 0) {
+						controls[i].left.pressed = (mt() % 3 == 0);
+						controls[i].right.pressed = (mt() % 3 == 0);
+						controls[i].up.pressed = (mt() % 3 == 0);
+						controls[i].down.pressed = (mt() % 3 == 0);
+					}
+					controls[i].seq += 1;
+					controls[i].send_controls_message(&connection);
+					messages += 1;
+					if (!logged_in && elapsed >= 0.3 * Seconds) {
+						Game::send_login_message(&connection, (i % 2 == 0 ? Role::Communicator : Role::Operative));
+						messages += 1;
+					}
+					if (!instructed && elapsed >= 0.6 * Seconds && i % 2 == 0) {
+						Game::send_instruction_message(&connection, "find the red door left of the tall man");
+						messages += 1;
+					}
+					clients[i]->poll(nullptr, 0.0);
+					connection.recv_buffer.clear();
+				}
+				logged_in = logged_in || elapsed >= 0.3 * Seconds;
+				instructed = instructed || elapsed >= 0.6 * Seconds;
+				next += std::chrono::duration_cast< std::chrono::steady_clock::duration >(std::chrono::duration< double >(Game::Tick));
+				std::this_thread::sleep_until(next);
+			}
+			shard->stop(); //(finishes the capture)
+		}
+		uint64_t recorded = fingerprint(*shard);
+		uint64_t capture_bytes = std::filesystem::file_size(path);
+
+		Shard replayer(0, DefaultPollBackend, TickScheduler::Mode::Accelerated);
+		Shard::ReplayStats stats;
+		auto before = std::chrono::steady_clock::now();
+		{
+			Quiet quiet;
+			stats = replayer.replay(path);
+		}
+		double seconds = std::chrono::duration< double >(std::chrono::steady_clock::now() - before).count();
+		bool same = (fingerprint(replayer) == recorded && replayer.clients.size() == shard->clients.size() && stats.ticks == shard->scheduler.tick);
+
+		std::cout << std::setw(8) << rooms << std::setw(8) << stats.ticks << std::setw(12) << (stats.messages + stats.datagrams)
+			<< std::setw(14) << capture_bytes << std::setw(10) << std::fixed << std::setprecision(0) << (capture_bytes / double(std::max< uint64_t >(1, stats.ticks)))
+			<< std::setw(14) << std::setprecision(2) << (seconds * 1000.0) << std::setw(12) << std::setprecision(0) << (stats.ticks / seconds)
+			<< std::setw(14) << std::setprecision(0) << (stats.ticks * Game::Tick / seconds) << std::defaultfloat
+			<< std::setw(10) << (same ? "yes" : "NO") << std::endl;
+		if (messages < stats.messages) throw std::runtime_error("Replay handled more messages than were sent.");
+
+		{ //teardown:
+			Quiet quiet;
+			shard.reset(); //(closes server-side sockets)
+			for (auto &client : clients) {
+				client->connection.close();
+			}
+			Connection closer;
+			closer.socket = listener->listen_socket;
+			closer.close();
+		}
+		if (!same) {
+			std::cerr << "Replay did not reproduce the recorded session (capture kept at '" << path << "')." << std::endl;
+			return 1;
+		}
+	}
+	std::filesystem::remove(path);
+
+	return 0;
+}
+
+//----------------------------------------------
+//garbage: clients sending malformed bytes to a shard get disconnected, without disturbing the shard or its other clients
+
+static int bench_garbage(std::vector< std::string > const &args) {
+	uint32_t size = (args.empty() ? 100000 : uint32_t(std::stoul(args[0])));
+	bool ok = true;
+
+	std::mt19937 mt(0x15466);
+	struct Case {
+		char const *name;
+		std::vector< uint8_t > bytes;
+		bool close_after = false; //(hang up right after sending)
+	};
+	std::vector< Case > cases;
+	cases.push_back(Case{"0xff bytes", std::vector< uint8_t >(size, 0xff)});
+	{
+		std::vector< uint8_t > bytes(size);
+		for (auto &b : bytes) b = uint8_t(mt());
+		cases.push_back(Case{"random bytes", bytes});
+	}
+	{ //a known type, with a size its handler doesn't accept:
+		std::vector< uint8_t > bytes = {uint8_t(Message::C2S_Controls), 0xff, 0xff, 0x00};
+		bytes.resize(4 + 0xffff, 0x00);
+		cases.push_back(Case{"oversized controls", bytes});
+	}
+	cases.push_back(Case{"0xff bytes, then close", std::vector< uint8_t >(size, 0xff), true});
+
+	constexpr uint32_t Good = 4; //well-behaved clients, which should keep getting state throughout
+	std::string port_str = "15866";
+	std::unique_ptr< Server > listener;
+	std::unique_ptr< Shard > shard;
+	std::vector< std::unique_ptr< Client > > good;
+	{
+		Quiet quiet;
+		listener = std::make_unique< Server >(port_str);
+		shard = std::make_unique< Shard >(0);
+		shard->start();
+		listener->on_accept = [&](Socket socket) { shard->handoff.push(socket); shard->server.wake(); };
+		while (good.size() < Good) {
+			good.emplace_back(std::make_unique< Client >("localhost", port_str));
+			listener->poll(nullptr, 0.0);
+		}
+		while (shard->connection_count < Good) listener->poll(nullptr, 0.001);
+	}
+
+	//poll everything for a while; returns the bytes the good clients received:
+	auto run_for = [&](double seconds, Client *bad) {
+		size_t received = 0;
+		auto start = std::chrono::steady_clock::now();
+		while (std::chrono::duration< double >(std::chrono::steady_clock::now() - start).count() < seconds) {
+			listener->poll(nullptr, 0.001);
+			for (auto &client : good) {
+				client->poll(nullptr, 0.0);
+				received += client->connection.recv_buffer.size();
+				client->connection.recv_buffer.clear();
+			}
+			if (bad && bad->connection) bad->poll(nullptr, 0.0);
+		}
+		return received;
+	};
+
+	std::cout << std::setw(24) << "garbage" << std::setw(10) << "bytes" << std::setw(16) << "disconnected" << std::setw(16) << "others served" << std::endl;
+	for (auto &c : cases) {
+		bool disconnected = false;
+		size_t received = 0;
+		{
+			Quiet quiet; //(the shard logs the disconnect)
+			Client bad("localhost", port_str);
+			while (shard->connection_count < Good + 1) listener->poll(nullptr, 0.001);
+			bad.connection.send_raw(c.bytes.data(), c.bytes.size());
+			if (c.close_after) {
+				bad.poll(nullptr, 0.0); //(get some of it on its way)
+				bad.connection.close();
+			}
+			received = run_for(0.5, &bad);
+			//the shard should have closed the connection (seen by the client as the socket closing), and forgotten the client:
+			disconnected = (shard->connection_count == Good) && (c.close_after || !bad.connection);
+			if (bad.connection) bad.connection.close();
+		}
+		bool served = (received > 0);
+		std::cout << std::setw(24) << c.name << std::setw(10) << c.bytes.size() << std::setw(16) << (disconnected ? "yes" : "NO")
+			<< std::setw(16) << (served ? "yes" : "NO") << std::endl;
+		if (!disconnected) {
+			std::cout << "  FAILED: the misbehaving client is still connected." << std::endl;
+			ok = false;
+		}
+		if (!served) {
+			std::cout << "  FAILED: the other clients stopped getting state." << std::endl;
+			ok = false;
+		}
+	}
+
+	{ //teardown:
+		Quiet quiet;
+		shard.reset(); //(closes server-side sockets)
+		for (auto &client : good) client->connection.close();
+		Connection closer;
+		closer.socket = listener->listen_socket;
+		closer.close();
+	}
+	return (ok ? 0 : 1);
+}
+
+//----------------------------------------------
+//transforms: Scene::Transform world matrices for a deep hierarchy, recomputed on every call (as they used to be) vs. cached
+
+//(the uncached computations, for comparison:)
+static glm::mat4x3 world_from_local_uncached(Scene::Transform const &transform) {
+	if (!transform.parent) return transform.make_parent_from_local();
+	return world_from_local_uncached(*transform.parent) * glm::mat4(transform.make_parent_from_local());
+}
+static glm::mat4x3 local_from_world_uncached(Scene::Transform const &transform) {
+	if (!transform.parent) return transform.make_local_from_parent();
+	return transform.make_local_from_parent() * glm::mat4(local_from_world_uncached(*transform.parent));
+}
+
+static int bench_transforms(std::vector< std::string > const &args) {
+	uint32_t count = (args.size() >= 1 ? uint32_t(std::stoul(args[0])) : 10000);
+	uint32_t depth = (args.size() >= 2 ? uint32_t(std::stoul(args[1])) : 8);
+	if (depth == 0 || count < depth) throw std::runtime_error("Need at least one transform per level.");
+	constexpr uint32_t Frames = 200;
+	bool ok = true;
+
+	//levels growing by a constant factor, from one root to the most nodes at the deepest level:
+	std::vector< uint32_t > sizes(depth, 1);
+	{
+		double lo = 1.0, hi = double(count);
+		for (uint32_t iter = 0; iter < 60; ++iter) {
+			double branching = 0.5 * (lo + hi), total = 0.0;
+			for (uint32_t d = 0; d < depth; ++d) total += std::pow(branching, d);
+			(total < count ? lo : hi) = branching;
+		}
+		uint32_t total = 0;
+		for (uint32_t d = 0; d + 1 < depth; ++d) {
+			sizes[d] = std::max< uint32_t >(1, uint32_t(std::round(std::pow(lo, d))));
+			total += sizes[d];
+		}
+		sizes[depth - 1] = std::max< uint32_t >(1, count - std::min(count - 1, total));
+	}
+
+	//make the transforms (in shuffled order, so the list isn't parent-before-child), then link each level to the one above:
+	Scene scene;
+	std::mt19937 mt(0x15466);
+	std::vector< uint32_t > level_of;
+	for (uint32_t d = 0; d < depth; ++d) level_of.insert(level_of.end(), sizes[d], d);
+	std::shuffle(level_of.begin(), level_of.end(), mt);
+	std::vector< std::vector< Scene::Transform * > > levels(depth);
+	std::vector< Scene::Transform * > all;
+	std::uniform_real_distribution< float > unit(-1.0f, 1.0f);
+	auto random_rotation = [&]() {
+		return glm::normalize(glm::quat(unit(mt), unit(mt), unit(mt), unit(mt)) );
+	};
+	for (uint32_t d : level_of) {
+		scene.transforms.emplace_back();
+		Scene::Transform &transform = scene.transforms.back();
+		transform.position = glm::vec3(unit(mt), unit(mt), unit(mt));
+		transform.rotation = random_rotation();
+		transform.scale = glm::vec3(1.0f + 0.1f * unit(mt));
+		levels[d].emplace_back(&transform);
+		all.emplace_back(&transform);
+	}
+	for (uint32_t d = 1; d < depth; ++d) {
+		for (Scene::Transform *transform : levels[d]) transform->parent = levels[d - 1][mt() % levels[d - 1].size()];
+	}
+
+	std::cout << all.size() << " transforms in " << depth << " levels (";
+	for (uint32_t d = 0; d < depth; ++d) std::cout << (d ? "/" : "") << sizes[d];
+	std::cout << "), " << Frames << " frames of finding every world matrix:" << std::endl;
+	std::cout << std::setw(34) << "" << std::setw(12) << "us/frame" << std::setw(12) << "ns/node" << std::setw(20) << "recomputed/frame" << std::endl;
+
+	float checksum = 0.0f; //(so the matrices can't be optimized away)
+	auto run = [&](char const *name, bool cached, bool resolve, std::function< void() > const &change) {
+		double us = 0.0;
+		uint64_t versions_before = Scene::Transform::versions;
+		for (uint32_t frame = 0; frame < Frames; ++frame) {
+			if (change) change();
+			auto before = std::chrono::steady_clock::now();
+			if (!cached) {
+				for (Scene::Transform const *transform : all) checksum += world_from_local_uncached(*transform)[3].x;
+			} else {
+				std::optional< Scene::Transform::Resolve > pass;
+				if (resolve) pass.emplace();
+				for (Scene::Transform const *transform : all) checksum += transform->make_world_from_local()[3].x;
+			}
+			us += us_since(before);
+		}
+		double recomputed = double(Scene::Transform::versions - versions_before) / Frames;
+		std::cout << std::setw(34) << name << std::fixed << std::setprecision(1) << std::setw(12) << us / Frames
+			<< std::setprecision(2) << std::setw(12) << 1000.0 * us / Frames / all.size()
+			<< std::setprecision(1) << std::setw(20) << recomputed << std::defaultfloat << std::endl;
+
+		//the cached matrices should be exactly the ones computed from scratch:
+		uint32_t wrong = 0;
+		for (Scene::Transform const *transform : all) {
+			if (!(transform->make_world_from_local() == world_from_local_uncached(*transform))) wrong += 1;
+			if (!(transform->make_local_from_world() == local_from_world_uncached(*transform))) wrong += 1;
+		}
+		if (wrong) {
+			std::cout << "  FAILED: " << wrong << " cached matrices differ from freshly computed ones." << std::endl;
+			ok = false;
+		}
+	};
+
+	//a few transforms move each frame (e.g., animated props), or the root does (moving everything):
+	uint32_t movers = std::max< uint32_t >(1, uint32_t(all.size()) / 100);
+	auto move_some = [&]() {
+		for (uint32_t i = 0; i < movers; ++i) all[mt() % all.size()]->rotation = random_rotation();
+	};
+	auto move_root = [&]() {
+		levels[0][0]->rotation = random_rotation();
+	};
+
+	run("uncached", false, false, nullptr);
+	run("cached, static", true, false, nullptr);
+	run("cached, static, in a Resolve", true, true, nullptr);
+	run(("cached, " + std::to_string(movers) + " moving, in a Resolve").c_str(), true, true, move_some);
+	run("cached, root moving, in a Resolve", true, true, move_root);
+	run("uncached, root moving", false, false, move_root);
+
+	//a transform changed outside of a Resolve is noticed by the next call (and its descendants' too):
+	{
+		Scene::Transform *leaf = levels[depth - 1][0];
+		glm::mat4x3 before = leaf->make_world_from_local();
+		leaf->parent->position += glm::vec3(1.0f, 0.0f, 0.0f);
+		glm::mat4x3 after = leaf->make_world_from_local();
+		if (before == after || !(after == world_from_local_uncached(*leaf))) {
+			std::cout << "  FAILED: moving a parent didn't update its child's cached matrix." << std::endl;
+			ok = false;
+		}
+	}
+
+	if (!std::isfinite(checksum)) std::cout << "(checksum " << checksum << ")" << std::endl;
+	return (ok ? 0 : 1);
+}
+
+//----------------------------------------------
+
+int main(int argc, char **argv) {
+	struct Benchmark {
+		char const *name;
+		char const *usage;
+		int (*run)(std::vector< std::string > const &args);
+	};
+	std::vector< Benchmark > benchmarks{
+		{"poll", "[clients...]  Server::poll latency vs. connected clients, per poll backend", bench_poll},
+		{"state", "[players...]  S2C_State bytes/tick/client, full vs. delta, with reconstruction check", bench_state},
+		{"quantize", "[players...]  S2C_State bytes/player with float vs. fixed-point encoding, and checks of the fixed-point error bounds", bench_quantize},
+		{"parse", "[players...]  client cost of applying state messages (deltas and keyframes), checking they don't allocate once players are steady", bench_parse},
+		{"schema", " MessageSchema send/recv vs. the hand-written code it replaced, checking they agree byte-for-byte", bench_schema},
+		{"update", "[players...]  Game::update time per tick, scalar vs. simd motion and all-pairs vs. grid collisions, with equality check", bench_update},
+		{"smoothing", "[conditions...]  client interpolation/prediction vs. latest state, and protocol bandwidth, over simulated links (e.g. latency=50ms,jitter=10ms,loss=1%)", bench_smoothing},
+		{"churn", "[players...]  cost of a player leaving and another joining, and of finding a player by handle", bench_churn},
+		{"fanout", "[clients...]  state send cost to loopback clients, shared players part copied vs. referenced, with syscall/copy counts", bench_fanout},
+		{"backpressure", "[players...]  send queue depth and state latency for a client on a slow link, queueing every state vs. skipping states while congested", bench_backpressure},
+		{"metrics", "[values]  Metrics histogram/counter cost and quantile accuracy, and Log cost per line with the writer thread running", bench_metrics},
+		{"profile", "[zones]  PROFILE_ZONE cost with the profiler disabled and enabled, and a check of the Chrome trace it writes", bench_profile},
+		{"ticks", "[stall ms...]  TickScheduler catch-up/overrun accounting around stalled ticks, and accelerated (no-wait) simulation speed", bench_ticks},
+		{"shards", "[rooms...]  server tick cost vs. rooms at 1/2/4/8 worker threads, with scripted loopback clients", bench_shards},
+		{"replay", "[rooms...]  record a scripted loopback session, replay it without sockets, and check it ends in the same state", bench_replay},
+		{"garbage", "[bytes]  clients sending malformed data to a shard are disconnected, and the shard keeps serving the others", bench_garbage},
+		{"transforms", "[nodes] [depth]  Scene::Transform world matrices for a generated hierarchy, recomputed on every call vs. cached (static, some moving, root moving), with equality check", bench_transforms},
+	};
+
+	if (argc >= 2) {
+		std::vector< std::string > args(argv + 2, argv + argc);
+		for (auto const &benchmark : benchmarks) {
+			if (benchmark.name == std::string(argv[1])) {
+				try {
+					return benchmark.run(args);
+				} catch (std::exception const &e) {
+					std::cerr << "Benchmark '" << benchmark.name << "' failed: " << e.what() << std::endl;
+					return 1;
+				}
+			}
+		}
+		std::cerr << "Unknown benchmark '" << argv[1] << "'." << std::endl;
+	}
+
+	std::cerr << "Usage:\n";
+	for (auto const &benchmark : benchmarks) {
+		std::cerr << "\t./bench " << benchmark.name << " " << benchmark.usage << "\n";
+	}
+	std::cerr.flush();
+	return 1;
+}
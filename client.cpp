@@ -1,8 +1,11 @@
 #include "PlayMode.hpp"
 
 #include "Connection.hpp"
+#include "Datagram.hpp"
 #include "Mode.hpp"
+#include "GpuTimer.hpp"
 #include "Load.hpp"
+#include "Profiler.hpp"
 #include "Sound.hpp"
 #include "GL.hpp"
 #include "load_save_png.hpp"
@@ -15,6 +18,8 @@
 #include <iostream>
 #include <stdexcept>
 #include <memory>
+#include <string>
+#include <vector>
 #include <algorithm>
 
 #ifdef _WIN32
@@ -36,16 +41,51 @@ int main(int argc, char **argv) {
 	try {
 #endif
 	//------------ command line arguments ------------
-	if (argc != 3) {
-		std::cerr << "Usage:\n\t./client <host> <port>" << std::endl;
+	//--udp asks the server to carry controls and state as datagrams (see Datagram.hpp):
+	bool udp = false;
+	//--net, --net-up, and --net-down simulate network conditions on our traffic (see NetSim.hpp):
+	NetPath netsim; //(outgoing is up, client -> server)
+	//--profile records a frame timing trace from the start (F9 starts/stops one at any time), written to profile.json or --profile=<file> (see Profiler.hpp):
+	bool profile = false;
+	std::string profile_path = "profile.json";
+	//--gpu-timers times drawing on the GPU, per pass, and prints a report at exit (F10 prints one at any time; see GpuTimer.hpp):
+	bool gpu_timers = false;
+	std::vector< std::string > args;
+	try {
+		for (int i = 1; i < argc; ++i) {
+			std::string arg = argv[i];
+			if (arg == "--udp") udp = true;
+			else if (arg.rfind("--net=", 0) == 0) netsim.outgoing = netsim.incoming = NetConditions::parse(arg.substr(6));
+			else if (arg.rfind("--net-up=", 0) == 0) netsim.outgoing = NetConditions::parse(arg.substr(9));
+			else if (arg.rfind("--net-down=", 0) == 0) netsim.incoming = NetConditions::parse(arg.substr(11));
+			else if (arg == "--profile") profile = true;
+			else if (arg == "--gpu-timers") gpu_timers = true;
+			else if (arg.rfind("--profile=", 0) == 0) { profile = true; profile_path = arg.substr(10); }
+			else args.emplace_back(arg);
+		}
+	} catch (std::exception const &e) {
+		std::cerr << e.what() << std::endl;
+		args.clear();
+	}
+	if (args.size() != 2) {
+		std::cerr << "Usage:\n\t./client <host> <port> [--udp] [--net=<conditions>] [--net-up=<conditions>] [--net-down=<conditions>] [--profile[=<file>]] [--gpu-timers]" << std::endl;
 		return 1;
 	}
 
 	//------------ connect to server --------------
-	Client client(argv[1], argv[2]);
+	Client client(args[0], args[1]);
+	DatagramChannel datagrams;
+	if (netsim.active()) {
+		std::cout << "Simulating " << netsim.outgoing.to_string() << " up and " << netsim.incoming.to_string() << " down." << std::endl;
+		client.simulate(netsim);
+		datagrams.netsim = netsim;
+	}
 
 	//------------  initialization ------------
 
+	Profiler::set_thread_name("main");
+	Profiler::enabled = profile;
+
 	//Initialize SDL library:
 	SDL_Init(SDL_INIT_VIDEO);
 
@@ -92,6 +132,8 @@ int main(int argc, char **argv) {
 	//On windows, load OpenGL entrypoints: (does nothing on other platforms)
 	init_GL();
 
+	if (gpu_timers) GpuTimer::start();
+
 	//Set VSYNC + Late Swap (prevents crazy FPS):
 	if (!SDL_GL_SetSwapInterval(-1)) {
 		std::cerr << "NOTE: couldn't set vsync + late swap tearing (" << SDL_GetError() << ")." << std::endl;
@@ -113,7 +155,7 @@ int main(int argc, char **argv) {
 	call_load_functions();
 
 	//------------ create game mode + make current --------------
-	Mode::set_current(std::make_shared< PlayMode >(client, Mode::window));
+	Mode::set_current(std::make_shared< PlayMode >(client, Mode::window, (udp ? &datagrams : nullptr)));
 
 	//------------ main loop ------------
 
@@ -132,12 +174,24 @@ int main(int argc, char **argv) {
 	};
 	on_resize();
 
+	//write out the frame timing trace recorded so far:
+	auto save_profile = [&](){
+		try {
+			uint64_t zones = Profiler::write(profile_path);
+			std::cout << "Wrote " << zones << " profiler zones to '" << profile_path << "' (open in chrome://tracing or ui.perfetto.dev)." << std::endl;
+		} catch (std::exception const &e) {
+			std::cerr << e.what() << std::endl;
+		}
+	};
+
 	//This will loop until the current mode is set to null:
 	while (Mode::current) {
 		//every pass through the game loop creates one frame of output
 		//  by performing three steps:
+		PROFILE_ZONE("frame");
 
 		{ //(1) process any events that are pending
+			PROFILE_ZONE("events");
 			static SDL_Event evt;
 			while (SDL_PollEvent(&evt)) {
 				//handle resizing:
@@ -164,6 +218,24 @@ int main(int argc, char **argv) {
 						px.a = 0xff;
 					}
 					save_png(filename, glm::uvec2(w,h), data.data(), LowerLeftOrigin);
+				} else if (evt.type == SDL_EVENT_KEY_DOWN && evt.key.key == SDLK_F9) {
+					// --- profiler key: start recording, or stop and save ---
+					if (!Profiler::enabled) {
+						Profiler::clear();
+						Profiler::enabled = true;
+						std::cout << "Profiling (press F9 again to save)." << std::endl;
+					} else {
+						Profiler::enabled = false;
+						save_profile();
+					}
+				} else if (evt.type == SDL_EVENT_KEY_DOWN && evt.key.key == SDLK_F10) {
+					// --- gpu timer key: start timing, or report (and restart) the timings so far ---
+					if (!GpuTimer::enabled) {
+						if (GpuTimer::start()) std::cout << "Timing GPU passes (press F10 for a report)." << std::endl;
+					} else {
+						GpuTimer::report(std::cout);
+						GpuTimer::reset();
+					}
 				}
 			}
 			if (!Mode::current) break;
@@ -179,21 +251,35 @@ int main(int argc, char **argv) {
 			//lag to avoid spiral of death:
 			elapsed = std::min(0.1f, elapsed);
 
+			PROFILE_ZONE("update");
 			Mode::current->update(elapsed);
 			if (!Mode::current) break;
 		}
 
 		{ //(3) call the current mode's "draw" function to produce output:
-		
+			PROFILE_ZONE("draw");
+			GpuTimer::begin_frame();
 			Mode::current->draw(drawable_size);
+			GpuTimer::end_frame();
 		}
 
 		//Wait until the recently-drawn frame is shown before doing it all again:
+		PROFILE_ZONE("SDL_GL_SwapWindow");
 		SDL_GL_SwapWindow(Mode::window);
 	}
 
+	if (Profiler::enabled) {
+		Profiler::enabled = false;
+		save_profile();
+	}
+
 
 	//------------  teardown ------------
+	if (GpuTimer::enabled) {
+		GpuTimer::report(std::cout);
+		GpuTimer::stop();
+	}
+
 	Sound::shutdown();
 
 	SDL_GL_DestroyContext(context);
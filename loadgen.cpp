@@ -0,0 +1,577 @@
+//Headless load generator: connects many scripted players ("bots") to a server from one process,
+// and reports how quickly the server answers them, how steadily state arrives, and how much traffic flows.
+//
+// Each bot plays roughly like a person would: it wanders about (sending controls every frame),
+// flips its role selection a few times in the Lobby before logging in, types an instruction when
+// it is the Communicator, and after a while leaves and joins again.
+//
+// With --udp, bots ask for controls and state to go as datagrams (see Datagram.hpp).
+//
+// --net runs each bot's traffic (stream and datagrams) through simulated network conditions, both ways,
+// to see how things hold up on a bad network; --net-up and --net-down set just one direction
+// (up is bot -> server). Conditions are written as in NetSim.hpp, e.g. --net=latency=40ms,jitter=10ms,loss=1%
+//
+// Usage: ./loadgen <host> <port> [bots] [seconds] [--udp] [--net=<conditions>] [--net-up=<conditions>] [--net-down=<conditions>]
+
+#include "Connection.hpp"
+#include "Datagram.hpp"
+#include "Game.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+using Clock = std::chrono::steady_clock;
+
+static Clock::duration seconds(double s) {
+	return std::chrono::duration_cast< Clock::duration >(std::chrono::duration< double >(s));
+}
+static float ms_between(Clock::time_point const &before, Clock::time_point const &after) {
+	return std::chrono::duration< float, std::milli >(after - before).count();
+}
+
+//silences std::cout/std::cerr chatter (e.g., Client's connection logging) for the lifetime of the object:
+struct Quiet {
+	Quiet() : out(std::cout.rdbuf(nullptr)), err(std::cerr.rdbuf(nullptr)) { }
+	~Quiet() {
+		std::cout.rdbuf(out);
+		std::cerr.rdbuf(err);
+	}
+	std::streambuf *out, *err;
+};
+
+//script timing:
+constexpr float ControlsRate = 60.0f; //controls messages per second (the real client sends one per frame)
+constexpr float SessionMin = 20.0f, SessionMax = 60.0f; //seconds before a bot leaves and joins again
+constexpr float ThinkMin = 0.3f, ThinkMax = 1.5f; //seconds between lobby actions
+constexpr float KeyMin = 0.08f, KeyMax = 0.2f; //seconds per typed character
+constexpr float GiveUp = 5.0f; //seconds to wait for the server to answer a request before counting it as unanswered
+
+//round-trip times for one kind of request:
+struct Samples {
+	std::vector< float > ms;
+	uint64_t unanswered = 0;
+};
+
+//everything measured, across all bots:
+struct Totals {
+	//request sent -> first state message that reflects it:
+	Samples controls; //C2S_Controls, answered by input_ack (so includes waiting for the server's next tick)
+	Samples selected_role; //C2S_SelectedRole, answered by our selected_role
+	Samples login; //C2S_Login, answered by our role
+	Samples instruction; //C2S_Instruction, answered by the Operation phase
+
+	std::vector< float > state_interval_ms; //time between consecutive state messages arriving at a bot
+
+	uint64_t messages_sent = 0, bytes_sent = 0;
+	uint64_t states_received = 0, bytes_received = 0;
+	uint64_t keyframe_requests = 0;
+	uint64_t stale_states = 0; //(datagrams) state arrived after a newer one
+	DatagramSocket::Stats datagrams; //(summed over bots' sockets)
+	uint64_t stream_retransmits = 0, datagrams_lost = 0; //(--net) summed over bots' pipes, both ways
+	uint64_t sessions = 0, connect_failures = 0, dropped = 0; //(dropped => closed by the server)
+};
+
+struct Bot {
+	std::unique_ptr< Client > client; //(nullptr between sessions)
+	std::unique_ptr< DatagramChannel > datagrams; //(with --udp)
+	std::vector< uint8_t > datagram_buffer;
+	Game game; //as the bot's client sees it
+	Player::Controls controls;
+	std::mt19937 mt;
+
+	Clock::time_point next_step; //send controls (and maybe act) at this time
+	Clock::time_point next_action; //earliest time for the next lobby action
+	Clock::time_point session_end; //leave at this time
+	Clock::time_point reconnect_at; //(between sessions) join again at this time
+
+	Clock::time_point last_state;
+	bool have_last_state = false;
+
+	//requests waiting for an answer:
+	std::deque< std::pair< uint32_t, Clock::time_point > > controls_sent; //seq, when sent
+	struct Request {
+		bool waiting = false;
+		Clock::time_point sent;
+		uint8_t expect = 0;
+	} selected_role, login, instruction;
+
+	//instruction typing (Communication phase):
+	bool typing = false;
+	Clock::time_point typed_at;
+	std::string typing_text;
+
+	float uniform(float lo, float hi) { return lo + (hi - lo) * (mt() / float(mt.max())); }
+
+	uint8_t my_role() const { return (game.self_index == 1 ? game.role_1 : game.role_2); }
+	uint8_t my_selected_role() const { return (game.self_index == 1 ? game.selected_role_1 : game.selected_role_2); }
+};
+
+//compose a random instruction out of a few words:
+static std::string make_instruction(std::mt19937 &mt) {
+	static std::vector< std::string > const words{
+		"find", "the", "red", "door", "left", "of", "tall", "man", "behind", "crate", "near", "window", "blue", "coat", "second", "from", "end",
+	};
+	std::string text;
+	uint32_t count = 3 + mt() % 8;
+	for (uint32_t w = 0; w < count; ++w) {
+		if (w) text += ' ';
+		text += words[mt() % words.size()];
+	}
+	return text;
+}
+
+//percentile (0..1) of samples, which get sorted:
+static float percentile(std::vector< float > &samples, float p) {
+	if (samples.empty()) return 0.0f;
+	size_t i = std::min(samples.size() - 1, size_t(p * samples.size()));
+	std::nth_element(samples.begin(), samples.begin() + i, samples.end());
+	return samples[i];
+}
+
+static void print_samples(std::string const &name, Samples &samples) {
+	std::cout << std::setw(16) << name << std::setw(10) << samples.ms.size();
+	for (float p : {0.5f, 0.9f, 0.99f, 0.999f}) {
+		std::cout << std::setw(10) << percentile(samples.ms, p);
+	}
+	float max = (samples.ms.empty() ? 0.0f : *std::max_element(samples.ms.begin(), samples.ms.end()));
+	std::cout << std::setw(10) << max << std::setw(12) << samples.unanswered << "\n";
+}
+
+int main(int argc, char **argv) {
+	std::vector< std::string > args;
+	bool udp = false;
+	NetPath netsim; //(outgoing is up, bot -> server)
+	try {
+		for (int i = 1; i < argc; ++i) {
+			std::string arg = argv[i];
+			if (arg == "--udp") udp = true;
+			else if (arg.rfind("--net=", 0) == 0) netsim.outgoing = netsim.incoming = NetConditions::parse(arg.substr(6));
+			else if (arg.rfind("--net-up=", 0) == 0) netsim.outgoing = NetConditions::parse(arg.substr(9));
+			else if (arg.rfind("--net-down=", 0) == 0) netsim.incoming = NetConditions::parse(arg.substr(11));
+			else args.emplace_back(arg);
+		}
+	} catch (std::exception const &e) {
+		std::cerr << e.what() << std::endl;
+		args.clear();
+	}
+	if (args.size() < 2 || args.size() > 4) {
+		std::cerr << "Usage:\n\t./loadgen <host> <port> [bots] [seconds] [--udp] [--net=<conditions>] [--net-up=<conditions>] [--net-down=<conditions>]" << std::endl;
+		return 1;
+	}
+	std::string host = args[0];
+	std::string port = args[1];
+	uint32_t bot_count = (args.size() > 2 ? uint32_t(std::stoul(args[2])) : 100);
+	double duration = (args.size() > 3 ? std::stod(args[3]) : 30.0);
+
+	#ifdef __linux__
+	{ //each bot uses two or three file descriptors (socket + its Client's epoll [+ datagram socket]), so raise the open file limit as far as allowed:
+		struct rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+			limit.rlim_cur = limit.rlim_max;
+			setrlimit(RLIMIT_NOFILE, &limit);
+		}
+	}
+
+	//one more epoll set, holding every bot's socket, so only bots with data waiting get polled:
+	int ready_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (ready_fd < 0) {
+		std::cerr << "Failed to create epoll instance." << std::endl;
+		return 1;
+	}
+	#endif
+
+	Totals totals;
+	std::vector< Bot > bots(bot_count);
+
+	auto start = Clock::now();
+	for (uint32_t b = 0; b < bot_count; ++b) {
+		Bot &bot = bots[b];
+		bot.mt.seed(0x15466 + b);
+		//spread bots' joins and frames out a bit, rather than having them all act at once:
+		bot.reconnect_at = start + seconds(bot.uniform(0.0f, std::min(1.0f, 0.001f * bot_count)));
+		bot.next_step = bot.reconnect_at;
+	}
+
+	auto count_sent = [&](Bot &bot, size_t before) {
+		totals.messages_sent += 1;
+		totals.bytes_sent += bot.client->connection.send_buffer.size() - before;
+	};
+
+	auto connect = [&](uint32_t b, Clock::time_point now) {
+		Bot &bot = bots[b];
+		try {
+			Quiet quiet;
+			bot.client = std::make_unique< Client >(host, port);
+		} catch (std::exception const &) {
+			totals.connect_failures += 1;
+			bot.reconnect_at = now + seconds(1.0);
+			return;
+		}
+		if (netsim.active()) bot.client->simulate(netsim);
+		#ifdef __linux__
+		epoll_event event;
+		event.events = EPOLLIN | EPOLLRDHUP;
+		event.data.u32 = b;
+		epoll_ctl(ready_fd, EPOLL_CTL_ADD, bot.client->connection.socket, &event);
+		#endif
+
+		if (udp) {
+			bot.datagrams = std::make_unique< DatagramChannel >();
+			bot.datagrams->netsim = netsim;
+			size_t before = bot.client->connection.send_buffer.size();
+			Game::send_datagram_request_message(&bot.client->connection);
+			count_sent(bot, before);
+		}
+
+		totals.sessions += 1;
+		bot.game = Game();
+		bot.controls = Player::Controls();
+		bot.controls_sent.clear();
+		bot.selected_role = bot.login = bot.instruction = Bot::Request();
+		bot.typing = false;
+		bot.have_last_state = false;
+		bot.next_action = now + seconds(bot.uniform(ThinkMin, ThinkMax));
+		bot.session_end = now + seconds(bot.uniform(SessionMin, SessionMax));
+	};
+
+	auto disconnect = [&](Bot &bot, Clock::time_point now) {
+		if (auto const &pipes = bot.client->connection.netsim) {
+			totals.stream_retransmits += pipes->outgoing.stats.lost + pipes->incoming.stats.lost;
+		}
+		{
+			Quiet quiet;
+			bot.client->connection.close(); //(also removes it from ready_fd)
+		}
+		bot.client.reset(); //(its destructor closes its epoll descriptor)
+		if (bot.datagrams && bot.datagrams->socket) {
+			auto const &stats = bot.datagrams->socket->stats;
+			totals.datagrams.sent += stats.sent;
+			totals.datagrams.received += stats.received;
+			totals.datagrams.errors += stats.errors;
+			if (bot.datagrams->socket->outgoing) {
+				totals.datagrams_lost += bot.datagrams->socket->outgoing->stats.lost + bot.datagrams->socket->incoming->stats.lost;
+			}
+		}
+		bot.datagrams.reset(); //(closing its socket also removes it from ready_fd)
+		bot.reconnect_at = now + seconds(bot.uniform(0.5f, 2.0f));
+		bot.next_step = bot.reconnect_at;
+	};
+
+	//check whether a newly applied state answers any of the bot's requests:
+	auto check_answers = [&](Bot &bot, Clock::time_point now) {
+		while (!bot.controls_sent.empty() && bot.controls_sent.front().first <= bot.game.input_ack) {
+			totals.controls.ms.emplace_back(ms_between(bot.controls_sent.front().second, now));
+			bot.controls_sent.pop_front();
+		}
+		auto check = [&](Bot::Request &request, Samples &samples, bool answered) {
+			if (!request.waiting) return;
+			if (answered) {
+				samples.ms.emplace_back(ms_between(request.sent, now));
+				request.waiting = false;
+			}
+		};
+		check(bot.selected_role, totals.selected_role, bot.my_selected_role() == bot.selected_role.expect);
+		check(bot.login, totals.login, bot.my_role() == bot.login.expect);
+		check(bot.instruction, totals.instruction, bot.game.phase == Game::Phase::Operation);
+	};
+
+	//give up on requests the server hasn't answered in a long while:
+	auto check_give_up = [&](Bot &bot, Clock::time_point now) {
+		auto oldest = now - seconds(GiveUp);
+		while (!bot.controls_sent.empty() && bot.controls_sent.front().second < oldest) {
+			totals.controls.unanswered += 1;
+			bot.controls_sent.pop_front();
+		}
+		auto check = [&](Bot::Request &request, Samples &samples) {
+			if (request.waiting && request.sent < oldest) {
+				samples.unanswered += 1;
+				request.waiting = false;
+			}
+		};
+		check(bot.selected_role, totals.selected_role);
+		check(bot.login, totals.login);
+		check(bot.instruction, totals.instruction);
+	};
+
+	auto got_state = [&](Bot &bot, size_t bytes, Clock::time_point now) {
+		totals.states_received += 1;
+		totals.bytes_received += bytes;
+		if (bot.have_last_state) totals.state_interval_ms.emplace_back(ms_between(bot.last_state, now));
+		bot.last_state = now;
+		bot.have_last_state = true;
+		if (bot.game.state_seq != 0) check_answers(bot, now); //(not if the message was skipped while waiting for a keyframe)
+	};
+
+	//send/receive whatever is pending for a bot, and read any state messages:
+	auto poll = [&](uint32_t b) {
+		Bot &bot = bots[b];
+		bot.client->poll([&](Connection *c, Connection::Event event) {
+			if (event != Connection::OnRecv) return;
+			Clock::time_point now = Clock::now();
+			while (true) {
+				size_t before = c->recv_buffer.size();
+				uint16_t datagram_port;
+				uint64_t token;
+				if (bot.game.recv_state_message(c)) {
+					got_state(bot, before - c->recv_buffer.size(), now);
+				} else if (bot.datagrams && Game::recv_datagram_hello_message(c, &datagram_port, &token)) {
+					bot.datagrams->open(*c, datagram_port, token);
+					#ifdef __linux__
+					epoll_event event;
+					event.events = EPOLLIN;
+					event.data.u32 = b;
+					epoll_ctl(ready_fd, EPOLL_CTL_ADD, bot.datagrams->socket->socket, &event);
+					#endif
+				} else {
+					break;
+				}
+			}
+		}, 0.0);
+
+		if (bot.datagrams && bot.datagrams->ready()) {
+			while (bot.datagrams->socket->recv(&bot.datagram_buffer)) {
+				Clock::time_point now = Clock::now();
+				if (bot.game.recv_state_datagram(bot.datagram_buffer.data(), bot.datagram_buffer.size())) {
+					got_state(bot, bot.datagram_buffer.size(), now);
+				} else {
+					totals.stale_states += 1;
+				}
+			}
+		}
+	};
+
+	//one frame of a bot's script:
+	auto step = [&](uint32_t b, Clock::time_point now) {
+		Bot &bot = bots[b];
+		bot.next_step += seconds(1.0f / ControlsRate);
+		if (bot.next_step < now) bot.next_step = now; //(fell behind; don't try to catch up with a burst)
+
+		//wander: change which direction keys are held now and then:
+		if (bot.mt() % 16 == 0) {
+			for (Button *button : {&bot.controls.left, &bot.controls.right, &bot.controls.up, &bot.controls.down, &bot.controls.jump}) {
+				bool pressed = (bot.mt() % 3 == 0);
+				if (pressed && !button->pressed) button->downs += 1;
+				button->pressed = pressed;
+			}
+		}
+		bot.controls.seq += 1;
+		size_t before = bot.client->connection.send_buffer.size();
+		if (bot.datagrams && bot.datagrams->ready()) {
+			bot.controls.send_controls_message(&bot.datagrams->outbox);
+			totals.messages_sent += 1;
+			totals.bytes_sent += bot.datagrams->outbox.send_buffer.size();
+			bot.datagrams->send_outbox();
+		} else {
+			bot.controls.send_controls_message(&bot.client->connection);
+			count_sent(bot, before);
+		}
+		bot.controls_sent.emplace_back(bot.controls.seq, now);
+		bot.controls.left.downs = bot.controls.right.downs = bot.controls.up.downs = bot.controls.down.downs = bot.controls.jump.downs = 0;
+
+		if (bot.game.needs_keyframe) {
+			before = bot.client->connection.send_buffer.size();
+			Game::send_keyframe_request_message(&bot.client->connection);
+			count_sent(bot, before);
+			totals.keyframe_requests += 1;
+			bot.game.needs_keyframe = false;
+		}
+
+		if (bot.game.phase == Game::Phase::Lobby && bot.game.self_index != 0 && bot.my_role() == 0
+		 && now >= bot.next_action && !bot.selected_role.waiting && !bot.login.waiting) {
+			//dither over the role selection for a bit, then log in with whatever is selected:
+			before = bot.client->connection.send_buffer.size();
+			if (bot.mt() % 3 != 0) {
+				uint8_t selected = bot.my_selected_role() ^ 1;
+				Game::send_selected_role_message(&bot.client->connection, selected);
+				bot.selected_role = Bot::Request{true, now, selected};
+			} else {
+				Role role = (bot.my_selected_role() == 0 ? Role::Communicator : Role::Operative);
+				Game::send_login_message(&bot.client->connection, role);
+				bot.login = Bot::Request{true, now, uint8_t(role)};
+			}
+			count_sent(bot, before);
+			bot.next_action = now + seconds(bot.uniform(ThinkMin, ThinkMax));
+		}
+
+		if (bot.game.phase == Game::Phase::Communication && bot.my_role() == uint8_t(Role::Communicator)) {
+			//type an instruction, one key at a time, then send it:
+			if (!bot.typing) {
+				bot.typing = true;
+				bot.typing_text = make_instruction(bot.mt);
+				bot.typed_at = now + seconds(bot.typing_text.size() * bot.uniform(KeyMin, KeyMax));
+			} else if (now >= bot.typed_at && !bot.instruction.waiting) {
+				before = bot.client->connection.send_buffer.size();
+				Game::send_instruction_message(&bot.client->connection, bot.typing_text);
+				count_sent(bot, before);
+				bot.instruction = Bot::Request{true, now, 0};
+				bot.typed_at = now + seconds(GiveUp); //(type it again if the server never moves on)
+			}
+		} else {
+			bot.typing = false;
+		}
+
+		check_give_up(bot, now);
+		poll(b); //(sends what was just queued)
+	};
+
+	std::cout << "Running " << bot_count << " bots against " << host << ":" << port << " for " << duration << " seconds";
+	if (udp) std::cout << ", controls/state as datagrams";
+	if (netsim.active()) std::cout << ", simulating " << netsim.outgoing.to_string() << " up and " << netsim.incoming.to_string() << " down";
+	std::cout << "." << std::endl;
+
+	//(--net) NetPipe::clock() time when a bot's pipes next let something through (infinity if never):
+	auto next_arrival = [&](Bot const &bot) {
+		double next = std::numeric_limits< double >::infinity();
+		if (auto const &pipes = bot.client->connection.netsim) {
+			next = std::min({next, pipes->outgoing.next_arrival(), pipes->incoming.next_arrival()});
+		}
+		if (bot.datagrams && bot.datagrams->ready()) next = std::min(next, bot.datagrams->socket->next_arrival());
+		return next;
+	};
+
+	auto end = start + seconds(duration);
+	auto next_report = start + seconds(5.0);
+	uint64_t reported_states = 0;
+	#ifdef __linux__
+	std::vector< epoll_event > events(1024);
+	#endif
+	while (true) {
+		Clock::time_point now = Clock::now();
+		if (now >= end) break;
+
+		//run every bot that is due:
+		Clock::time_point next_due = end;
+		for (uint32_t b = 0; b < bot_count; ++b) {
+			Bot &bot = bots[b];
+			if (!bot.client) {
+				if (now >= bot.reconnect_at) {
+					connect(b, now);
+					if (!bot.client) continue;
+				} else {
+					next_due = std::min(next_due, bot.reconnect_at);
+					continue;
+				}
+			}
+			if (now >= bot.session_end) {
+				disconnect(bot, now);
+			} else if (now >= bot.next_step) {
+				step(b, now);
+				if (!bot.client->connection) {
+					totals.dropped += 1;
+					disconnect(bot, now);
+				}
+			}
+			next_due = std::min(next_due, (bot.client ? bot.next_step : bot.reconnect_at));
+			//(simulated traffic is only let through when polled, so wake up for that, too)
+			if (bot.client && netsim.active()) {
+				double wait = next_arrival(bot) - NetPipe::clock();
+				if (wait <= 0.0) poll(b);
+				else if (wait < duration) next_due = std::min(next_due, now + seconds(wait));
+			}
+		}
+
+		//until then, read state messages as they arrive:
+		now = Clock::now();
+		int timeout_ms = (next_due > now ? int(std::ceil(ms_between(now, next_due))) : 0);
+		#ifdef __linux__
+		int count = epoll_wait(ready_fd, events.data(), int(events.size()), timeout_ms);
+		for (int i = 0; i < count; ++i) {
+			Bot &bot = bots[events[i].data.u32];
+			if (!bot.client) continue;
+			poll(events[i].data.u32);
+			if (!bot.client->connection) {
+				totals.dropped += 1;
+				disconnect(bot, Clock::now());
+			}
+		}
+		#else
+		std::this_thread::sleep_for(std::chrono::milliseconds(std::min(timeout_ms, 1)));
+		for (uint32_t b = 0; b < bot_count; ++b) {
+			Bot &bot = bots[b];
+			if (!bot.client) continue;
+			poll(b);
+			if (!bot.client->connection) {
+				totals.dropped += 1;
+				disconnect(bot, Clock::now());
+			}
+		}
+		#endif
+
+		if (Clock::now() >= next_report) {
+			uint32_t connected = 0;
+			for (auto const &bot : bots) connected += (bot.client ? 1 : 0);
+			std::cout << "  " << std::fixed << std::setprecision(0) << ms_between(start, next_report) / 1000.0f << "s: "
+				<< connected << " connected, " << (totals.states_received - reported_states) / 5 << " states/s" << std::defaultfloat << std::endl;
+			reported_states = totals.states_received;
+			next_report += seconds(5.0);
+		}
+	}
+
+	double elapsed = std::chrono::duration< double >(Clock::now() - start).count();
+	for (auto &bot : bots) {
+		if (bot.client) disconnect(bot, Clock::now()); //(to count their datagrams)
+	}
+
+	std::cout << "\nRound trip (ms), request sent -> first state reflecting it:\n";
+	std::cout << std::setw(16) << "request" << std::setw(10) << "count" << std::setw(10) << "p50" << std::setw(10) << "p90"
+		<< std::setw(10) << "p99" << std::setw(10) << "p99.9" << std::setw(10) << "max" << std::setw(12) << "unanswered" << "\n";
+	std::cout << std::fixed << std::setprecision(2);
+	print_samples("controls", totals.controls);
+	print_samples("selected role", totals.selected_role);
+	print_samples("login", totals.login);
+	print_samples("instruction", totals.instruction);
+	std::cout << "(controls are applied on the server's next tick, so expect up to " << 1000.0f * Game::Tick << " ms on top of the network)\n";
+
+	{ //tick jitter, as seen from the bots:
+		auto &intervals = totals.state_interval_ms;
+		double sum = 0.0, sum2 = 0.0;
+		for (float ms : intervals) {
+			sum += ms;
+			sum2 += double(ms) * ms;
+		}
+		double mean = (intervals.empty() ? 0.0 : sum / intervals.size());
+		double stddev = (intervals.empty() ? 0.0 : std::sqrt(std::max(0.0, sum2 / intervals.size() - mean * mean)));
+		uint64_t late = 0;
+		for (float ms : intervals) late += (ms > 1.5f * 1000.0f * Game::Tick ? 1 : 0);
+		std::cout << "\nState message interval (ms; server tick is " << 1000.0f * Game::Tick << "):\n";
+		std::cout << "  mean " << mean << ", stddev " << stddev
+			<< ", p1 " << percentile(intervals, 0.01f) << ", p50 " << percentile(intervals, 0.5f)
+			<< ", p99 " << percentile(intervals, 0.99f) << ", p99.9 " << percentile(intervals, 0.999f) << "\n";
+		std::cout << "  " << late << " of " << intervals.size() << " intervals over 1.5 ticks\n";
+	}
+
+	std::cout << "\nThroughput (over " << elapsed << " s):\n";
+	std::cout << "  sent:     " << totals.messages_sent / elapsed << " messages/s, " << totals.bytes_sent / elapsed / 1024.0 << " KiB/s\n";
+	std::cout << "  received: " << totals.states_received / elapsed << " states/s, " << totals.bytes_received / elapsed / 1024.0 << " KiB/s\n";
+	std::cout << std::defaultfloat;
+	std::cout << "  " << totals.sessions << " sessions, " << totals.connect_failures << " failed connects, "
+		<< totals.dropped << " dropped by server, " << totals.keyframe_requests << " keyframe requests" << std::endl;
+	if (udp) {
+		std::cout << "  datagrams: " << totals.datagrams.sent << " sent, " << totals.datagrams.received << " received ("
+			<< totals.stale_states << " stale states), " << totals.datagrams.errors << " errors" << std::endl;
+	}
+	if (netsim.active()) {
+		std::cout << "  simulated network: " << totals.stream_retransmits << " stream chunks held up by retransmission";
+		if (udp) std::cout << ", " << totals.datagrams_lost << " datagrams lost";
+		std::cout << std::endl;
+	}
+
+	return 0;
+}
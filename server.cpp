@@ -1,15 +1,21 @@
 
 #include "Connection.hpp"
 
-#include "hex_dump.hpp"
-
-#include "Game.hpp"
+#include "Log.hpp"
+#include "Metrics.hpp"
+#include "Rooms.hpp"
+#include "Shard.hpp"
 
 #include <chrono>
+#include <csignal>
+#include <filesystem>
+#include <fstream>
 #include <stdexcept>
 #include <iostream>
-#include <cassert>
-#include <unordered_map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
 
 #ifdef _WIN32
 extern "C"
@@ -17,6 +23,10 @@ extern "C"
 	uint32_t GetACP();
 }
 #endif
+
+// set (from a signal handler) to ask the main loop to have every shard print message stats:
+static volatile std::sig_atomic_t dump_stats_requested = 0;
+
 int main(int argc, char **argv)
 {
 #ifdef _WIN32
@@ -40,192 +50,176 @@ int main(int argc, char **argv)
 
 		//------------ argument parsing ------------
 
-		if (argc != 2)
+		// --udp offers clients a datagram channel for controls and state (see Datagram.hpp):
+		bool datagrams = false;
+		// --net, --net-up, and --net-down simulate network conditions on every client's traffic (see NetSim.hpp):
+		NetPath netsim; // (outgoing is down, server -> client)
+		// --record logs everything clients send (one file per worker), and --replay runs such a log again (see Capture.hpp):
+		std::string record, replay;
+		// --metrics serves Prometheus-format metrics over HTTP on that port, and --metrics-file rewrites them to a file every second (see Metrics.hpp):
+		std::string metrics_port, metrics_file;
+		std::vector<std::string> args;
+		try
+		{
+			for (int i = 1; i < argc; ++i)
+			{
+				std::string arg = argv[i];
+				if (arg == "--udp")
+					datagrams = true;
+				else if (arg.rfind("--net=", 0) == 0)
+					netsim.outgoing = netsim.incoming = NetConditions::parse(arg.substr(6));
+				else if (arg.rfind("--net-up=", 0) == 0)
+					netsim.incoming = NetConditions::parse(arg.substr(9));
+				else if (arg.rfind("--net-down=", 0) == 0)
+					netsim.outgoing = NetConditions::parse(arg.substr(11));
+				else if (arg.rfind("--record=", 0) == 0)
+					record = arg.substr(9);
+				else if (arg.rfind("--replay=", 0) == 0)
+					replay = arg.substr(9);
+				else if (arg.rfind("--metrics=", 0) == 0)
+					metrics_port = arg.substr(10);
+				else if (arg.rfind("--metrics-file=", 0) == 0)
+					metrics_file = arg.substr(15);
+				else
+					args.emplace_back(arg);
+			}
+		}
+		catch (std::exception const &e)
 		{
-			std::cerr << "Usage:\n\t./server <port>" << std::endl;
+			std::cerr << e.what() << std::endl;
+			args.clear();
+		}
+		if (!replay.empty() && args.empty())
+		{
+			// run a recorded session again, as fast as possible, and report how fast that was:
+			Shard shard(0, DefaultPollBackend, TickScheduler::Mode::Accelerated);
+			auto before = std::chrono::steady_clock::now();
+			Shard::ReplayStats stats = shard.replay(replay);
+			double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - before).count();
+			std::cout << "Replayed " << stats.ticks << " ticks (" << stats.ticks * Game::Tick << " s of play), " << stats.connections << " connections, "
+					  << stats.messages << " messages, and " << stats.datagrams << " datagrams in " << seconds << " s:\n"
+					  << "  " << stats.ticks / seconds << " ticks/s (" << stats.ticks * Game::Tick / seconds << "x real time), "
+					  << (stats.messages + stats.datagrams) / seconds << " messages/s, " << stats.state_bytes / seconds / 1024.0 << " KiB/s of state\n";
+			shard.dispatcher.dump_stats(std::cout);
+			return 0;
+		}
+		if (args.size() != 1 && args.size() != 2)
+		{
+			std::cerr << "Usage:\n\t./server <port> [workers] [--udp] [--net=<conditions>] [--net-up=<conditions>] [--net-down=<conditions>] [--record=<file>] [--metrics=<port>] [--metrics-file=<file>]\n"
+					  << "\t./server --replay=<file>" << std::endl;
 			return 1;
 		}
+		uint32_t workers = 1;
+		if (args.size() == 2)
+		{
+			workers = uint32_t(std::stoul(args[1]));
+			if (workers == 0)
+				throw std::runtime_error("Need at least one worker.");
+		}
 
 		//------------ initialization ------------
 
-		Server server(argv[1]);
+		// log lines are written by a background thread, so shards don't wait on the console mid-tick:
+		Log::start();
 
-		//------------ main loop ------------
+		// this (listener) thread accepts connections and hands them to worker threads ("shards"),
+		// each of which runs its own connections and rooms:
+		Server listener(args[0]);
+
+		std::vector<std::unique_ptr<Shard>> shards;
+		for (uint32_t i = 0; i < workers; ++i)
+		{
+			shards.emplace_back(std::make_unique<Shard>(i));
+			if (datagrams)
+				shards.back()->enable_datagrams();
+			if (netsim.active())
+				shards.back()->simulate(netsim);
+			if (!record.empty())
+				shards.back()->record(workers == 1 ? record : record + "." + std::to_string(i));
+			shards.back()->start();
+		}
+		if (netsim.active())
+		{
+			std::cout << "Simulating " << netsim.incoming.to_string() << " up and " << netsim.outgoing.to_string() << " down." << std::endl;
+		}
 
-		// keep track of which connection is controlling which player:
-		std::unordered_map<Connection *, Player *> connection_to_player;
-		// keep track of game state:
-		Game game;
+		Metrics::Counter &accepted = Metrics::registry().counter("server_connections_accepted_total", "Connections accepted by the listener thread.");
+		Metrics::Gauge &log_dropped = Metrics::registry().gauge("server_log_dropped_lines", "Log lines dropped because the log's ring buffer was full.");
+
+		listener.on_accept = [&](Socket socket)
+		{
+			accepted.add();
+			Shard::hand_off(shards, socket);
+		};
+
+		// metrics are served to anything that sends a request (e.g., an HTTP GET from a Prometheus scraper),
+		// and the connection is closed once the reply has been sent:
+		std::unique_ptr<Server> metrics_server;
+		if (!metrics_port.empty())
+		{
+			metrics_server = std::make_unique<Server>(metrics_port);
+			std::cout << "Serving metrics on port " << metrics_port << "." << std::endl;
+		}
+		auto on_metrics_event = [](Connection *c, Connection::Event evt)
+		{
+			if (evt != Connection::OnRecv || c->tag != 0)
+				return;
+			auto &request = c->recv_buffer;
+			std::string_view text(reinterpret_cast<char const *>(request.data()), request.size());
+			if (text.find("\r\n\r\n") == std::string_view::npos && text.find("\n\n") == std::string_view::npos)
+			{
+				if (request.size() > 8192)
+					c->close(); // (no end of request in sight)
+				return;
+			}
+			std::string body = Metrics::registry().text();
+			std::string reply = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+			c->send_raw(reply.data(), reply.size());
+			request.clear();
+			c->tag = 1; // (close once sent)
+		};
+		auto metrics_written = std::chrono::steady_clock::now();
+
+#ifndef _WIN32
+		// dump per-message stats on demand (kill -USR1 <pid>):
+		std::signal(SIGUSR1, [](int) { dump_stats_requested = 1; });
+#endif
+
+		//------------ main loop ------------
 
 		while (true)
 		{
-			static auto next_tick = std::chrono::steady_clock::now() + std::chrono::duration<double>(Game::Tick);
-			// process incoming data from clients until a tick has elapsed:
-			while (true)
+			listener.poll(nullptr, 0.1);
+
+			log_dropped.set(double(Log::dropped()));
+			if (metrics_server)
 			{
-				auto now = std::chrono::steady_clock::now();
-				double remain = std::chrono::duration<double>(next_tick - now).count();
-				if (remain < 0.0)
+				metrics_server->poll(on_metrics_event, 0.0);
+				for (auto &c : metrics_server->connections)
 				{
-					next_tick += std::chrono::duration<double>(Game::Tick);
-					break;
+					if (c.tag == 1 && !c.unsent())
+						c.close();
 				}
-
-				// helper used on client close (due to quit) and server close (due to error):
-				auto remove_connection = [&](Connection *c)
-				{
-					auto f = connection_to_player.find(c);
-					assert(f != connection_to_player.end());
-					game.remove_player(f->second);
-					connection_to_player.erase(f);
-				};
-
-				server.poll([&](Connection *c, Connection::Event evt)
-							{
-				if (evt == Connection::OnOpen) {
-					//client connected:
-
-					//create some player info for them:
-					connection_to_player.emplace(c, game.spawn_player());
-
-				} else if (evt == Connection::OnClose) {
-					//client disconnected:
-
-					remove_connection(c);
-
-				} else { assert(evt == Connection::OnRecv);
-					//got data from client:
-					//std::cout << "current buffer:\n" << hex_dump(c->recv_buffer); std::cout.flush(); //DEBUG
-
-					//look up in players list:
-					auto f = connection_to_player.find(c);
-					assert(f != connection_to_player.end());
-					Player &player = *f->second;
-
-					//handle messages from client:
-					try {
-						bool handled_message;
-						do {
-							handled_message = false;
-							if (player.controls.recv_controls_message(c)) handled_message = true;
-							//TODO: extend for more message types as needed
-
-							Role chosen;
-							uint8_t selected;
-							if (Game::recv_selected_role_message(c, &selected))
-							{
-								handled_message = true;
-
-								// who sent this?
-								int idx = (&player == &game.players.front()) ? 1 : 2;
-
-								if (idx == 1)
-									game.selected_role_1 = selected;
-								else
-									game.selected_role_2 = selected;
-
-								// NOTE: per your spec, we do NOT touch role_1/role_2 here.
-								// Conflict resolution stays in the login (Enter) path.
-							}
-
-							// Credit: helped by ChatGPT
-							if (Game::recv_login_message(c, &chosen))
-							{
-								handled_message = true;
-								player.role = chosen; // add `Role role = Role::Unknown;` to your Player
-								// Check role selection logic
-								
-								int cur_player_idx = (&player == &game.players.front()) ? 1 : 2;
-
-								auto set_selected_opposite = [](uint8_t &selected, Role chosen)
-								{
-									// chosen: 1=Communicator -> other should *select* Operative (1)
-									//         2=Operative    -> other should *select* Communicator (0)
-									selected = (chosen == Role::Communicator ? 1 : 0);
-									printf("chosen: %d, other player forced to select %s\n", uint8_t(chosen), (selected == 0 ? "Communicator" : "Operative"));
-								};
-
-								// write role_1/role_2 from the chosen enum value:
-								uint8_t my_selected_role = (chosen == Role::Communicator ? 0 : 1);
-								if (cur_player_idx == 1)
-								{
-									game.role_1 = uint8_t(chosen);
-									game.selected_role_1 = my_selected_role;
-								}
-								else
-								{
-									game.role_2 = uint8_t(chosen);
-									game.selected_role_2 = my_selected_role;
-								}
-
-								// figure out the other side:
-								uint8_t &other_role = (cur_player_idx == 1 ? game.role_2 : game.role_1);
-								uint8_t &other_selected = (cur_player_idx == 1 ? game.selected_role_2 : game.selected_role_1);
-								// printf("\nother_role = %d, other_selected = %d, chosen = %d, other_role == uint8_t(chosen)? %d\n", other_role, other_selected, uint8_t(chosen), other_role == uint8_t(chosen));
-
-								if (other_role == 0)
-								{
-									// unknown: wait for the other player
-									// (labels are derived client-side)
-								}
-								else if (other_role == uint8_t(chosen))
-								{
-									// same role: reset other to unknown, push their selection to the opposite:
-									other_role = 0;
-									set_selected_opposite(other_selected, chosen);
-								}
-								else
-								{
-									// complementary: both ready -> proceed to Communication
-									game.phase = Game::Phase::Communication;
-								}
-							}
-
-							std::string typed;
-							if (Game::recv_instruction_message(c, &typed))
-							{
-								handled_message = true;
-								// Move to Operation phase and store the message:
-								game.found_count = 0;
-								game.attempt_count = 25;
-								game.instruction_text = typed;
-
-								// corrupt instruction: replace 50% of non-space chars with '*'
-								std::string corrupted = typed;
-								std::vector<size_t> nonspace;
-								nonspace.reserve(corrupted.size());
-								for (size_t i = 0; i < corrupted.size(); ++i)
-								{
-									if (corrupted[i] != ' ')
-										nonspace.push_back(i);
-								}
-								size_t replace_n = nonspace.size() / 2; // 50%
-								std::mt19937 rng{std::random_device{}()};
-								std::shuffle(nonspace.begin(), nonspace.end(), rng);
-								for (size_t k = 0; k < replace_n; ++k)
-								{
-									corrupted[nonspace[k]] = '*';
-								}
-								game.corrupted_instruction = std::move(corrupted);
-
-								game.phase = Game::Phase::Operation;
-							}
-						} while (handled_message);
-					} catch (std::exception const &e) {
-						std::cout << "Disconnecting client:" << e.what() << std::endl;
-						c->close();
-						remove_connection(c);
-					}
-				} }, remain);
+			}
+			if (!metrics_file.empty() && std::chrono::steady_clock::now() - metrics_written >= std::chrono::seconds(1))
+			{
+				// (written next to the file, then renamed over it, so readers never see half of it)
+				metrics_written = std::chrono::steady_clock::now();
+				std::string temporary = metrics_file + ".tmp";
+				std::ofstream(temporary, std::ios::binary | std::ios::trunc) << Metrics::registry().text();
+				std::error_code error;
+				std::filesystem::rename(temporary, metrics_file, error);
+				if (error)
+					Log::warn("Failed to write metrics to '%s': %s", metrics_file.c_str(), error.message().c_str());
 			}
 
-			// update current game state
-			game.update(Game::Tick);
-
-			// send updated game state to all clients
-			for (auto &[c, player] : connection_to_player)
+			if (dump_stats_requested)
 			{
-				game.send_state_message(c, player);
+				dump_stats_requested = 0;
+				for (auto &shard : shards)
+				{
+					shard->dump_stats_requested = true;
+				}
 			}
 		}
 